@@ -0,0 +1,105 @@
+// Measures the CPU side of a frame (transform update, matrix maths for two
+// views, uniform packing and command recording) for different scene sizes and thread counts.
+// GL submission is left out so this runs without a context.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <memory>
+#include <vector>
+
+#include "CommandList.hpp"
+#include "ThreadPool.hpp"
+#include "TransformSystem.hpp"
+#include "UniformBlocks.hpp"
+
+using namespace glm;
+
+static const int kWarmupFrames = 10;
+static const int kMeasuredFrames = 100;
+
+static double MeasureFrameTime(size_t sceneSize, unsigned int numThreads) {
+    ThreadPool threadPool(numThreads - 1);
+
+    TransformSystem transforms;
+    std::vector<TransformSystem::Handle> handles;
+    for (size_t i = 0; i < sceneSize; ++i) {
+        handles.push_back(transforms.Add(translate(mat4(1.f), vec3((float)i, 0.f, 0.f))));
+    }
+
+    TransformSystem::View lightView, cameraView;
+
+    // Stands in for the mapped uniform ring buffer
+    std::vector<PerDrawUniforms> uniforms(sceneSize * 2);
+    std::vector<CommandList> commandLists(threadPool.GetNumThreads());
+    const auto chunkSize = (sceneSize + commandLists.size() - 1) / commandLists.size();
+
+    auto record = [&](const TransformSystem::View& view, size_t firstUniform) {
+        for (auto& commandList : commandLists) {
+            commandList.Reset();
+        }
+        threadPool.ParallelFor(sceneSize, chunkSize, [&](size_t begin, size_t end) {
+            auto& commandList = commandLists[begin / chunkSize];
+            for (auto i = begin; i < end; ++i) {
+                auto& perDraw = uniforms[firstUniform + i];
+                perDraw.model = transforms.GetModel(handles[i]);
+                perDraw.modelViewProjection = view.modelViewProjection[handles[i]];
+                const auto& modelInverseTranspose = transforms.GetModelInverseTranspose(handles[i]);
+                for (int column = 0; column < 3; ++column) {
+                    perDraw.modelInverseTranspose[column] = vec4(modelInverseTranspose[column], 0.f);
+                }
+
+                DrawCommand command;
+                command.numElements = 36;
+                command.perDrawOffset = (GLintptr)((firstUniform + i) * sizeof(PerDrawUniforms));
+                commandList.Record(command);
+            }
+        });
+    };
+
+    auto projection = perspective(radians(45.f), 16.f / 9.f, 0.1f, 100.f);
+    std::chrono::steady_clock::duration total(0);
+    for (int frame = 0; frame < kWarmupFrames + kMeasuredFrames; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+
+        // Move a tenth of the scene every frame
+        for (size_t i = frame % 10; i < sceneSize; i += 10) {
+            transforms.SetModel(handles[i], rotate(transforms.GetModel(handles[i]), 0.01f, vec3(0.f, 1.f, 0.f)));
+        }
+        transforms.Update(&threadPool);
+
+        auto view = lookAt(vec3(0.f, 5.f, -10.f), vec3(0.f), vec3(0.f, 1.f, 0.f));
+        transforms.ComputeView(lightView, view, projection, &threadPool);
+        transforms.ComputeView(cameraView, inverse(view), projection, &threadPool);
+        record(lightView, 0);
+        record(cameraView, sceneSize);
+
+        if (frame >= kWarmupFrames) {
+            total += std::chrono::steady_clock::now() - start;
+        }
+    }
+
+    return std::chrono::duration<double, std::milli>(total).count() / kMeasuredFrames;
+}
+
+int main() {
+    const size_t sceneSizes[] = { 1000, 10000, 100000 };
+    const unsigned int threadCounts[] = { 1, 2, 4, 8 };
+
+    printf("%12s", "objects");
+    for (auto numThreads : threadCounts) {
+        printf("%10u thr", numThreads);
+    }
+    printf("\n");
+
+    for (auto sceneSize : sceneSizes) {
+        printf("%12zu", sceneSize);
+        for (auto numThreads : threadCounts) {
+            printf("%11.3fms", MeasureFrameTime(sceneSize, numThreads));
+        }
+        printf("\n");
+    }
+
+    return EXIT_SUCCESS;
+}
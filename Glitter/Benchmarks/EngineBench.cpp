@@ -0,0 +1,549 @@
+// Microbenchmarks for the CPU hot paths of the engine, none of which need a
+// GL context: mesh and texture loading, camera and per-draw matrix maths and
+// shader uniform lookup, the last against a fake GL that only knows enough
+// about programs to link one and hand out uniform locations.
+//
+// Every benchmark is calibrated to samples of at least kMinSampleTime, and
+// samples outside Tukey's fences are dropped before the statistics. Heap
+// allocations are counted by replacing the global operator new.
+//
+// Usage: EngineBench [--filter TEXT] [--baseline FILE] [--save-baseline FILE] [--threshold PERCENT]
+//
+// With --baseline, medians are compared against a file written earlier with
+// --save-baseline, and the exit code is non-zero if any benchmark got slower
+// by more than the threshold (10% by default) and its confidence interval.
+#include <algorithm>
+#include <assimp/scene.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <map>
+#include <memory>
+#include <new>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ArcCamera.hpp"
+#include "Drawable.hpp"
+#include "FileMesh.hpp"
+#include "Scene.hpp"
+#include "Shader.hpp"
+#include "Texture2D.hpp"
+#include "ThreadPool.hpp"
+#include "TransformSystem.hpp"
+#include "UniformBlocks.hpp"
+
+using namespace glm;
+
+static const std::chrono::milliseconds kMinSampleTime(10);
+static const int kNumSamples = 30;
+static const int kMinSamples = 5;
+// Benchmarks whose single iteration is slow take fewer samples
+static const std::chrono::seconds kMaxBenchmarkTime(3);
+
+static std::atomic<uint64_t> numAllocations = 0;
+static std::atomic<uint64_t> numAllocatedBytes = 0;
+
+void* operator new(size_t size) {
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    numAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// Keeps the optimiser from dropping work whose result is unused
+template<typename T>
+static void DoNotOptimise(const T& value) {
+    static volatile const void* sink;
+    sink = &value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+struct Result {
+    std::string name;
+    // Per iteration
+    double medianNanoseconds = 0.;
+    double meanNanoseconds = 0.;
+    double stddevNanoseconds = 0.;
+    // Half width of the 95% confidence interval of the mean
+    double confidenceNanoseconds = 0.;
+    double allocations = 0.;
+    double allocatedBytes = 0.;
+    int numSamples = 0;
+    int numRejected = 0;
+    int iterationsPerSample = 0;
+};
+
+static double Percentile(const std::vector<double>& sorted, double p) {
+    const auto position = p * (sorted.size() - 1);
+    const auto below = static_cast<size_t>(position);
+    const auto above = std::min(below + 1, sorted.size() - 1);
+    return sorted[below] + (sorted[above] - sorted[below]) * (position - below);
+}
+
+static Result RunBenchmark(const std::string& name, const std::function<void()>& iteration) {
+    typedef std::chrono::steady_clock Clock;
+
+    // Also the warm-up
+    int iterationsPerSample = 1;
+    auto sampleTime = Clock::duration::zero();
+    while (true) {
+        const auto start = Clock::now();
+        for (int i = 0; i < iterationsPerSample; ++i) {
+            iteration();
+        }
+        sampleTime = Clock::now() - start;
+        if (sampleTime >= kMinSampleTime) {
+            break;
+        }
+        iterationsPerSample *= 2;
+    }
+    const auto numSamples = std::clamp(static_cast<int>(kMaxBenchmarkTime / std::max(sampleTime, Clock::duration(1))), kMinSamples, kNumSamples);
+
+    std::vector<double> samples;
+    const auto allocationsBefore = numAllocations.load();
+    const auto bytesBefore = numAllocatedBytes.load();
+    for (int sample = 0; sample < numSamples; ++sample) {
+        const auto start = Clock::now();
+        for (int i = 0; i < iterationsPerSample; ++i) {
+            iteration();
+        }
+        const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        samples.push_back(elapsed / iterationsPerSample);
+    }
+    const double numIterations = static_cast<double>(numSamples) * iterationsPerSample;
+
+    Result result;
+    result.name = name;
+    result.iterationsPerSample = iterationsPerSample;
+    result.allocations = (numAllocations.load() - allocationsBefore) / numIterations;
+    result.allocatedBytes = (numAllocatedBytes.load() - bytesBefore) / numIterations;
+
+    // Tukey's fences, as timings have a long tail from interrupts and the like
+    std::sort(samples.begin(), samples.end());
+    const auto q1 = Percentile(samples, 0.25);
+    const auto q3 = Percentile(samples, 0.75);
+    const auto low = q1 - 1.5 * (q3 - q1);
+    const auto high = q3 + 1.5 * (q3 - q1);
+    std::vector<double> kept;
+    for (auto sample : samples) {
+        if (sample >= low && sample <= high) {
+            kept.push_back(sample);
+        }
+    }
+    result.numSamples = static_cast<int>(kept.size());
+    result.numRejected = static_cast<int>(samples.size() - kept.size());
+
+    double sum = 0.;
+    for (auto sample : kept) {
+        sum += sample;
+    }
+    result.meanNanoseconds = sum / kept.size();
+    double squares = 0.;
+    for (auto sample : kept) {
+        squares += (sample - result.meanNanoseconds) * (sample - result.meanNanoseconds);
+    }
+    result.stddevNanoseconds = kept.size() > 1 ? std::sqrt(squares / (kept.size() - 1)) : 0.;
+    result.confidenceNanoseconds = 1.96 * result.stddevNanoseconds / std::sqrt(static_cast<double>(kept.size()));
+    result.medianNanoseconds = Percentile(kept, 0.5);
+    return result;
+}
+
+static std::string FormatTime(double nanoseconds) {
+    char text[32];
+    if (nanoseconds >= 1e6) {
+        snprintf(text, sizeof(text), "%.3f ms", nanoseconds / 1e6);
+    }
+    else if (nanoseconds >= 1e3) {
+        snprintf(text, sizeof(text), "%.3f us", nanoseconds / 1e3);
+    }
+    else {
+        snprintf(text, sizeof(text), "%.1f ns", nanoseconds);
+    }
+    return text;
+}
+
+// Baselines are JSON, one benchmark per line, as written by SaveBaseline
+static std::map<std::string, Result> LoadBaseline(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Could not read baseline \"%s\"\n", path.c_str());
+        exit(EXIT_FAILURE);
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const auto text = contents.str();
+
+    static const std::regex entry(
+        R"re("([^"]+)"\s*:\s*\{\s*"median_ns"\s*:\s*([-0-9.eE+]+)\s*,\s*"confidence_ns"\s*:\s*([-0-9.eE+]+)\s*,\s*"allocations"\s*:\s*([-0-9.eE+]+))re"
+    );
+    std::map<std::string, Result> baseline;
+    for (auto it = std::sregex_iterator(text.begin(), text.end(), entry); it != std::sregex_iterator(); ++it) {
+        Result result;
+        result.name = (*it)[1];
+        result.medianNanoseconds = std::stod((*it)[2]);
+        result.confidenceNanoseconds = std::stod((*it)[3]);
+        result.allocations = std::stod((*it)[4]);
+        baseline[result.name] = result;
+    }
+    return baseline;
+}
+
+static void SaveBaseline(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream file(path);
+    if (!file) {
+        fprintf(stderr, "Could not write baseline \"%s\"\n", path.c_str());
+        exit(EXIT_FAILURE);
+    }
+    file << "{\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        char line[256];
+        snprintf(
+            line,
+            sizeof(line),
+            "  \"%s\": {\"median_ns\": %.3f, \"confidence_ns\": %.3f, \"allocations\": %.3f}%s\n",
+            result.name.c_str(),
+            result.medianNanoseconds,
+            result.confidenceNanoseconds,
+            result.allocations,
+            i + 1 < results.size() ? "," : ""
+        );
+        file << line;
+    }
+    file << "}\n";
+}
+
+// Just enough of GL for Shader to link a program with the given uniforms and
+// set them, without a context
+namespace FakeGL {
+    static std::vector<std::string> uniforms;
+
+    static GLuint APIENTRY CreateProgram() {
+        return 1;
+    }
+
+    static void APIENTRY DeleteProgram(GLuint) {
+    }
+
+    static void APIENTRY LinkProgram(GLuint) {
+    }
+
+    static void APIENTRY UseProgram(GLuint) {
+    }
+
+    static void APIENTRY GetProgramiv(GLuint, GLenum name, GLint* value) {
+        switch (name) {
+        case GL_LINK_STATUS:
+            *value = GL_TRUE;
+            break;
+        case GL_ACTIVE_UNIFORMS:
+            *value = static_cast<GLint>(uniforms.size());
+            break;
+        case GL_ACTIVE_UNIFORM_MAX_LENGTH: {
+            size_t length = 0;
+            for (const auto& uniform : uniforms) {
+                length = std::max(length, uniform.size() + 1);
+            }
+            *value = static_cast<GLint>(length);
+            break;
+        }
+        default:
+            *value = 0;
+        }
+    }
+
+    static void APIENTRY GetActiveUniform(GLuint, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name) {
+        const auto& uniform = uniforms[index];
+        const auto copied = std::min(uniform.size(), static_cast<size_t>(bufSize - 1));
+        memcpy(name, uniform.c_str(), copied);
+        name[copied] = '\0';
+        *length = static_cast<GLsizei>(copied);
+        *size = 1;
+        *type = GL_FLOAT;
+    }
+
+    static GLint APIENTRY GetUniformLocation(GLuint, const GLchar* name) {
+        const auto it = std::find(uniforms.begin(), uniforms.end(), name);
+        return it == uniforms.end() ? -1 : static_cast<GLint>(it - uniforms.begin());
+    }
+
+    static GLuint APIENTRY GetUniformBlockIndex(GLuint, const GLchar*) {
+        return GL_INVALID_INDEX;
+    }
+
+    static void APIENTRY Uniform1i(GLint, GLint) {
+    }
+
+    static void APIENTRY Uniform1f(GLint, GLfloat) {
+    }
+
+    static void APIENTRY Uniform3fv(GLint, GLsizei, const GLfloat*) {
+    }
+
+    static void APIENTRY UniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat*) {
+    }
+
+    static void Install(const std::vector<std::string>& programUniforms) {
+        uniforms = programUniforms;
+        glad_glCreateProgram = CreateProgram;
+        glad_glDeleteProgram = DeleteProgram;
+        glad_glLinkProgram = LinkProgram;
+        glad_glUseProgram = UseProgram;
+        glad_glGetProgramiv = GetProgramiv;
+        glad_glGetActiveUniform = GetActiveUniform;
+        glad_glGetUniformLocation = GetUniformLocation;
+        glad_glGetUniformBlockIndex = GetUniformBlockIndex;
+        glad_glUniform1i = Uniform1i;
+        glad_glUniform1f = Uniform1f;
+        glad_glUniform3fv = Uniform3fv;
+        glad_glUniformMatrix4fv = UniformMatrix4fv;
+    }
+}
+
+// A grid of quads with everything FileMesh reads, built the way Assimp would
+static aiMesh* MakeGridMesh(unsigned int size) {
+    auto* mesh = new aiMesh();
+    mesh->mNumVertices = size * size;
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    mesh->mTangents = new aiVector3D[mesh->mNumVertices];
+    mesh->mBitangents = new aiVector3D[mesh->mNumVertices];
+    mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+    for (unsigned int y = 0; y < size; ++y) {
+        for (unsigned int x = 0; x < size; ++x) {
+            const auto i = y * size + x;
+            mesh->mVertices[i] = aiVector3D((float)x, 0.f, (float)y);
+            mesh->mNormals[i] = aiVector3D(0.f, 1.f, 0.f);
+            mesh->mTangents[i] = aiVector3D(1.f, 0.f, 0.f);
+            mesh->mBitangents[i] = aiVector3D(0.f, 0.f, 1.f);
+            mesh->mTextureCoords[0][i] = aiVector3D((float)x / size, (float)y / size, 0.f);
+        }
+    }
+
+    mesh->mNumFaces = (size - 1) * (size - 1) * 2;
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    unsigned int face = 0;
+    for (unsigned int y = 0; y + 1 < size; ++y) {
+        for (unsigned int x = 0; x + 1 < size; ++x) {
+            const auto i = y * size + x;
+            const unsigned int triangles[2][3] = {
+                { i, i + size, i + 1 },
+                { i + 1, i + size, i + size + 1 },
+            };
+            for (const auto& triangle : triangles) {
+                mesh->mFaces[face].mNumIndices = 3;
+                mesh->mFaces[face].mIndices = new unsigned int[3] { triangle[0], triangle[1], triangle[2] };
+                ++face;
+            }
+        }
+    }
+    return mesh;
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter, baselinePath, savePath;
+    double threshold = 10.;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save-baseline") == 0 && i + 1 < argc) {
+            savePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<std::pair<std::string, std::function<void()>>> benchmarks;
+
+    for (const char* model : { "suzanne.obj", "teapot.obj" }) {
+        const auto path = std::filesystem::path(PROJECT_SOURCE_DIR) / model;
+        benchmarks.emplace_back(std::string("LoadFileMesh/") + model, [path]() {
+            DoNotOptimise(LoadFileMesh(path));
+        });
+    }
+
+    std::shared_ptr<aiMesh> gridMesh(MakeGridMesh(128));
+    benchmarks.emplace_back("FileMesh/128x128 grid", [gridMesh]() {
+        DoNotOptimise(FileMesh(gridMesh.get()));
+    });
+
+    const auto texturePath = std::filesystem::path(PROJECT_SOURCE_DIR) / "metal.jpg";
+    benchmarks.emplace_back("LoadTexture/metal.jpg", [texturePath]() {
+        auto image = LoadTexture(texturePath, true);
+        DoNotOptimise(image->data);
+    });
+
+    ArcCamera camera(vec3(0.f, 1.4f, 0.f), 2.f, 0.2f, 0.2f);
+    benchmarks.emplace_back("ArcCamera::GetViewMatrix", [&camera]() {
+        camera.Yaw(0.001f);
+        DoNotOptimise(camera.GetViewMatrix());
+    });
+
+    // What every draw path works out for each draw, for 1000 drawables
+    const size_t numDrawables = 1000;
+    TransformSystem transforms;
+    std::vector<TransformSystem::Handle> handles;
+    for (size_t i = 0; i < numDrawables; ++i) {
+        handles.push_back(transforms.Add(translate(mat4(1.f), vec3((float)i, 0.f, 0.f))));
+    }
+    transforms.Update();
+    TransformSystem::View view;
+    const auto projection = perspective(radians(45.f), 16.f / 9.f, 0.1f, 100.f);
+    PassContext pass;
+    pass.transforms = &transforms;
+    pass.view = &view;
+    std::vector<PerDrawUniforms> perDraw(numDrawables);
+    benchmarks.emplace_back("Drawable::WritePerDrawUniforms/1000", [&]() {
+        transforms.ComputeView(view, camera.GetViewMatrix(), projection);
+        for (size_t i = 0; i < numDrawables; ++i) {
+            Drawable::WritePerDrawUniforms(perDraw[i], pass, handles[i]);
+        }
+        DoNotOptimise(perDraw);
+    });
+
+    // A scene of 100k nodes, ten children to a node, where a handful move
+    // every frame, and where the root moves and everything has to follow
+    Scene scene;
+    std::vector<Scene::NodeHandle> nodes;
+    nodes.push_back(scene.Add());
+    for (size_t i = 1; i < 100000; ++i) {
+        nodes.push_back(scene.Add(nodes[(i - 1) / 10], translate(mat4(1.f), vec3(1.f, 0.f, 0.f))));
+    }
+    scene.Update();
+    ThreadPool threadPool;
+    float angle = 0.f;
+    benchmarks.emplace_back("Scene::Update/100k, 8 leaves moved", [&]() {
+        angle += 0.01f;
+        for (size_t i = 0; i < 8; ++i) {
+            scene.SetLocal(nodes[nodes.size() - 1 - i * 997], rotate(mat4(1.f), angle, vec3(0.f, 1.f, 0.f)));
+        }
+        scene.Update();
+    });
+    benchmarks.emplace_back("Scene::Update/100k, root moved", [&]() {
+        angle += 0.01f;
+        scene.SetLocal(nodes[0], rotate(mat4(1.f), angle, vec3(0.f, 1.f, 0.f)));
+        scene.Update();
+    });
+    benchmarks.emplace_back("Scene::Update/100k, root moved, threaded", [&]() {
+        angle += 0.01f;
+        scene.SetLocal(nodes[0], rotate(mat4(1.f), angle, vec3(0.f, 1.f, 0.f)));
+        scene.Update(&threadPool);
+    });
+
+    // The uniforms of textured.frag and its vertex shader
+    FakeGL::Install({
+        "lightSpaceMatrix", "material.diffuse", "material.normal", "material.specular", "material.emission",
+        "material.shininess", "light.position", "light.direction", "light.cutOff", "light.outerCutOff",
+        "light.ambient", "light.diffuse", "light.specular", "light.constant", "light.linear",
+        "light.quadratic", "shadowMap", "penumbraSize", "shadowMoments", "prefilteredShadows",
+        "clusterGrid", "clusterLightIndices", "clusterLights", "clusterDims", "clusterScreenSize",
+        "clusterDepthRange", "clusterSliceScale",
+    });
+    auto shader = std::make_shared<Shader>();
+    shader->Link();
+    const vec3 colour(1.f, 0.5f, 0.25f);
+    benchmarks.emplace_back("Shader::SetUniform/found", [shader, colour]() {
+        shader->SetUniform("light.specular", colour);
+    });
+    benchmarks.emplace_back("Shader::SetUniform/missing", [shader]() {
+        shader->SetUniform("notAUniform", 1.f);
+    });
+
+    std::map<std::string, Result> baseline;
+    if (!baselinePath.empty()) {
+        baseline = LoadBaseline(baselinePath);
+    }
+
+    printf("%-32s %12s %12s %9s %10s %10s\n", "benchmark", "median", "+/- 95%", "rejected", "allocs", "bytes");
+    std::vector<Result> results;
+    bool regressed = false;
+    for (const auto& [name, iteration] : benchmarks) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        const auto result = RunBenchmark(name, iteration);
+        results.push_back(result);
+        printf(
+            "%-32s %12s %12s %5d/%-3d %10.1f %10.0f",
+            name.c_str(),
+            FormatTime(result.medianNanoseconds).c_str(),
+            FormatTime(result.confidenceNanoseconds).c_str(),
+            result.numRejected,
+            result.numSamples + result.numRejected,
+            result.allocations,
+            result.allocatedBytes
+        );
+
+        const auto it = baseline.find(name);
+        if (it != baseline.end()) {
+            const auto& before = it->second;
+            const auto change = 100. * (result.medianNanoseconds - before.medianNanoseconds) / before.medianNanoseconds;
+            // Only counts when the difference is larger than both runs' noise
+            const auto noise = result.confidenceNanoseconds + before.confidenceNanoseconds;
+            const auto significant = std::abs(result.medianNanoseconds - before.medianNanoseconds) > noise;
+            printf("  %+.1f%%", change);
+            if (significant && change > threshold) {
+                printf(" SLOWER");
+                regressed = true;
+            }
+            else if (significant && change < -threshold) {
+                printf(" faster");
+            }
+            if (result.allocations > before.allocations + 0.5) {
+                printf(" (%.1f more allocs)", result.allocations - before.allocations);
+            }
+        }
+        printf("\n");
+    }
+
+    if (!savePath.empty()) {
+        SaveBaseline(savePath, results);
+    }
+
+    return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
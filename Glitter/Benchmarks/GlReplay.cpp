@@ -0,0 +1,1013 @@
+// Plays back a GL trace recorded with Glitter --gl-trace, so a slow scene can
+// be looked at without the assets or setup it came from. Everything up to the
+// last frame is replayed once to create the resources, then the last frame
+// is replayed in a loop and timed, by default headless on Mesa's llvmpipe.
+//
+// Usage: GlReplay TRACE [--loops N] [--warmup N] [--hardware] [--strip-redundant]
+//
+// --strip-redundant drops the calls in the looped frame that set state to
+// what it already is, as a perfect state cache would, and reports how many.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "GlStats.hpp"
+#include "GlTrace.hpp"
+#include "HeadlessRenderer.hpp"
+
+struct Data {
+    const uint8_t* bytes = nullptr;
+    uint32_t size = 0;
+};
+
+// The arguments of one record, read in the order the recorder wrote them
+class Reader {
+public:
+    explicit Reader(Data args) : args(args) {}
+
+    template<typename T>
+    T Read() {
+        T value;
+        Take(&value, sizeof(T));
+        return value;
+    }
+
+    Data ReadData() {
+        Data data;
+        data.size = Read<uint32_t>();
+        data.bytes = args.bytes + position;
+        Take(nullptr, data.size);
+        return data;
+    }
+
+    std::vector<uint8_t> ReadRest() {
+        std::vector<uint8_t> rest(args.bytes + position, args.bytes + args.size);
+        position = args.size;
+        return rest;
+    }
+
+    std::string ReadString() {
+        const auto data = ReadData();
+        return std::string(reinterpret_cast<const char*>(data.bytes), data.size);
+    }
+
+private:
+    void Take(void* out, size_t size) {
+        if (position + size > args.size) {
+            throw std::runtime_error("Truncated record in trace");
+        }
+        if (out != nullptr) {
+            memcpy(out, args.bytes + position, size);
+        }
+        position += size;
+    }
+
+    Data args;
+    size_t position = 0;
+};
+
+struct Record {
+    GlTrace::Call call;
+    Data args;
+};
+
+struct Trace {
+    GlTrace::Header header;
+    std::vector<uint8_t> bytes;
+    std::vector<Record> records;
+    // Index of the first record after each frame
+    std::vector<size_t> frameEnds;
+};
+
+static Trace LoadTrace(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not read \"" + path + "\"");
+    }
+
+    Trace trace;
+    file.read(reinterpret_cast<char*>(&trace.header), sizeof(trace.header));
+    if (!file || trace.header.magic != GlTrace::kMagic) {
+        throw std::runtime_error("\"" + path + "\" isn't a GL trace");
+    }
+    if (trace.header.version != GlTrace::kVersion) {
+        throw std::runtime_error("Trace is version " + std::to_string(trace.header.version) + ", expected " + std::to_string(GlTrace::kVersion));
+    }
+    trace.bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    size_t position = 0;
+    while (position + sizeof(uint16_t) + sizeof(uint32_t) <= trace.bytes.size()) {
+        uint16_t call;
+        uint32_t size;
+        memcpy(&call, trace.bytes.data() + position, sizeof(call));
+        memcpy(&size, trace.bytes.data() + position + sizeof(call), sizeof(size));
+        position += sizeof(call) + sizeof(size);
+        if (position + size > trace.bytes.size() || call >= GlTrace::NumCalls) {
+            throw std::runtime_error("Corrupt trace");
+        }
+        trace.records.push_back({ static_cast<GlTrace::Call>(call), { trace.bytes.data() + position, size } });
+        position += size;
+        if (call == GlTrace::EndFrame) {
+            trace.frameEnds.push_back(trace.records.size());
+        }
+    }
+    if (trace.frameEnds.size() < 2) {
+        throw std::runtime_error("The trace needs at least two frames, the last is the one looped");
+    }
+    return trace;
+}
+
+// What GL state the calls of a trace leave behind, in terms of the recorded
+// object names, to tell which calls don't change anything. State that isn't
+// known yet, eg. after objects are deleted, never counts as unchanged.
+class StateModel {
+public:
+    // Whether replaying the record would leave the state as it is
+    bool IsRedundant(const Record& record) {
+        Reader args(record.args);
+        switch (record.call) {
+        case GlTrace::BindBuffer: {
+            const auto target = args.Read<GLenum>();
+            const auto buffer = args.Read<GLuint>();
+            if (target == GL_ELEMENT_ARRAY_BUFFER) {
+                return Set(ElementBinding, Get(VaoBinding), 0, buffer);
+            }
+            return Set(BufferBinding, target, 0, buffer);
+        }
+        case GlTrace::BindBufferRange: {
+            const auto target = args.Read<GLenum>();
+            const auto index = args.Read<GLuint>();
+            const auto buffer = args.Read<GLuint>();
+            const auto offset = args.Read<int64_t>();
+            const auto size = args.Read<int64_t>();
+            // Binds the generic target too
+            const bool generic = Set(BufferBinding, target, 0, buffer);
+            return Set(IndexedBinding, target, index, Pack(buffer, offset, size)) && generic;
+        }
+        case GlTrace::BindVertexArray:
+            return Set(VaoBinding, 0, 0, args.Read<GLuint>());
+        case GlTrace::UseProgram:
+            return Set(ProgramBinding, 0, 0, args.Read<GLuint>());
+        case GlTrace::ActiveTexture:
+            return Set(ActiveUnit, 0, 0, args.Read<GLenum>());
+        case GlTrace::BindTexture: {
+            const auto target = args.Read<GLenum>();
+            return Set(TextureBinding, Get(ActiveUnit), target, args.Read<GLuint>());
+        }
+        case GlTrace::BindFramebuffer: {
+            const auto target = args.Read<GLenum>();
+            const auto framebuffer = args.Read<GLuint>();
+            if (target == GL_FRAMEBUFFER) {
+                const bool read = Set(FramebufferBinding, GL_READ_FRAMEBUFFER, 0, framebuffer);
+                return Set(FramebufferBinding, GL_DRAW_FRAMEBUFFER, 0, framebuffer) && read;
+            }
+            return Set(FramebufferBinding, target, 0, framebuffer);
+        }
+        case GlTrace::BindRenderbuffer:
+            args.Read<GLenum>();
+            return Set(RenderbufferBinding, 0, 0, args.Read<GLuint>());
+        case GlTrace::Enable:
+            return Set(Capability, args.Read<GLenum>(), 0, true);
+        case GlTrace::Disable:
+            return Set(Capability, args.Read<GLenum>(), 0, false);
+        case GlTrace::DepthFunc:
+            return Set(DepthFunction, 0, 0, args.Read<GLenum>());
+        case GlTrace::Viewport:
+            return Set(ViewportRect, 0, 0, args.ReadRest());
+        case GlTrace::ClearColor:
+            return Set(ClearColour, 0, 0, args.ReadRest());
+        case GlTrace::PixelStorei: {
+            const auto pname = args.Read<GLenum>();
+            return Set(PixelStore, pname, 0, args.Read<GLint>());
+        }
+        case GlTrace::TexParameteri:
+        case GlTrace::TexParameterfv: {
+            const auto target = args.Read<GLenum>();
+            const auto pname = args.Read<GLenum>();
+            const auto texture = Get(TextureBinding, Get(ActiveUnit), target);
+            return Set(TextureParameter, texture, pname, args.ReadRest());
+        }
+        case GlTrace::Uniform1i:
+        case GlTrace::Uniform1f:
+        case GlTrace::Uniform2fv:
+        case GlTrace::Uniform3fv:
+        case GlTrace::Uniform4fv:
+        case GlTrace::UniformMatrix4fv: {
+            const auto location = args.Read<GLint>();
+            auto value = args.ReadRest();
+            value.push_back(static_cast<uint8_t>(record.call));
+            return Set(UniformValue, Get(ProgramBinding), static_cast<uint32_t>(location), value);
+        }
+        case GlTrace::UniformBlockBinding: {
+            const auto program = args.Read<GLuint>();
+            const auto index = args.Read<GLuint>();
+            return Set(BlockBinding, program, index, args.Read<GLuint>());
+        }
+
+        // Anything that makes what's known stale
+        case GlTrace::LinkProgram: {
+            const auto program = args.Read<GLuint>();
+            Forget(UniformValue, program);
+            Forget(BlockBinding, program);
+            return false;
+        }
+        case GlTrace::DeleteProgram:
+            Forget(ProgramBinding);
+            Forget(UniformValue, args.Read<GLuint>());
+            return false;
+        case GlTrace::GenBuffers:
+        case GlTrace::DeleteBuffers:
+            Forget(BufferBinding);
+            Forget(IndexedBinding);
+            Forget(ElementBinding);
+            return false;
+        case GlTrace::GenVertexArrays:
+        case GlTrace::DeleteVertexArrays:
+            Forget(VaoBinding);
+            Forget(ElementBinding);
+            return false;
+        case GlTrace::GenTextures:
+        case GlTrace::DeleteTextures:
+            Forget(TextureBinding);
+            Forget(TextureParameter);
+            return false;
+        case GlTrace::GenFramebuffers:
+        case GlTrace::DeleteFramebuffers:
+            Forget(FramebufferBinding);
+            return false;
+        case GlTrace::GenRenderbuffers:
+        case GlTrace::DeleteRenderbuffers:
+            Forget(RenderbufferBinding);
+            return false;
+        default:
+            return false;
+        }
+    }
+
+private:
+    enum Kind {
+        BufferBinding,
+        IndexedBinding,
+        ElementBinding,
+        VaoBinding,
+        ProgramBinding,
+        ActiveUnit,
+        TextureBinding,
+        FramebufferBinding,
+        RenderbufferBinding,
+        Capability,
+        DepthFunction,
+        ViewportRect,
+        ClearColour,
+        PixelStore,
+        TextureParameter,
+        UniformValue,
+        BlockBinding
+    };
+
+    typedef std::tuple<Kind, uint64_t, uint64_t> Key;
+
+    // Values back to back, without the padding a struct or tuple of them has,
+    // which would make equal values compare unequal
+    template<typename... T>
+    static std::vector<uint8_t> Pack(const T&... values) {
+        std::vector<uint8_t> bytes;
+        (bytes.insert(bytes.end(), (const uint8_t*)&values, (const uint8_t*)&values + sizeof(T)), ...);
+        return bytes;
+    }
+
+    template<typename T>
+    bool Set(Kind kind, uint64_t a, uint64_t b, const T& value) {
+        static_assert(std::has_unique_object_representations_v<T>, "Compared byte by byte, so use Pack for anything with padding");
+        return Set(kind, a, b, Pack(value));
+    }
+
+    bool Set(Kind kind, uint64_t a, uint64_t b, const std::vector<uint8_t>& value) {
+        auto& current = state[Key(kind, a, b)];
+        const bool unchanged = current == value;
+        current = value;
+        return unchanged;
+    }
+
+    // Unknown reads as an object that can't exist
+    uint64_t Get(Kind kind, uint64_t a = 0, uint64_t b = 0) const {
+        const auto it = state.find(Key(kind, a, b));
+        if (it == state.end()) {
+            return UINT64_MAX;
+        }
+        uint64_t value = 0;
+        memcpy(&value, it->second.data(), std::min(it->second.size(), sizeof(value)));
+        return value;
+    }
+
+    void Forget(Kind kind) {
+        state.erase(state.lower_bound(Key(kind, 0, 0)), state.upper_bound(Key(kind, UINT64_MAX, UINT64_MAX)));
+    }
+
+    void Forget(Kind kind, uint64_t a) {
+        state.erase(state.lower_bound(Key(kind, a, 0)), state.upper_bound(Key(kind, a, UINT64_MAX)));
+    }
+
+    // State with no entry is unknown, and set by whatever comes next
+    std::map<Key, std::vector<uint8_t>> state;
+};
+
+// Issues the recorded calls, translating the recorded object names,
+// locations and syncs into the ones this context gave out
+class Replayer {
+public:
+    explicit Replayer(const GlTrace::Header& header) {
+        // Stands in for framebuffer 0, whatever the trace was recorded into
+        glGenRenderbuffers(1, &colourBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, header.width, header.height);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, header.width, header.height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &backbuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, backbuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            throw std::runtime_error("Replay framebuffer is incomplete");
+        }
+        framebuffers[0] = backbuffer;
+    }
+
+    void Execute(const Record& record);
+
+private:
+    typedef std::unordered_map<GLuint, GLuint> Names;
+
+    static GLuint Translate(const Names& names, GLuint name) {
+        const auto it = names.find(name);
+        return it == names.end() ? name : it->second;
+    }
+
+    static void Generate(Names& names, Reader& args, void (APIENTRYP generate)(GLsizei, GLuint*)) {
+        const auto recorded = args.ReadData();
+        const auto n = static_cast<GLsizei>(recorded.size / sizeof(GLuint));
+        std::vector<GLuint> created(n);
+        generate(n, created.data());
+        for (GLsizei i = 0; i < n; ++i) {
+            GLuint name;
+            memcpy(&name, recorded.bytes + i * sizeof(GLuint), sizeof(name));
+            names[name] = created[i];
+        }
+    }
+
+    static void Delete(Names& names, Reader& args, void (APIENTRYP destroy)(GLsizei, const GLuint*)) {
+        const auto recorded = args.ReadData();
+        const auto n = static_cast<GLsizei>(recorded.size / sizeof(GLuint));
+        std::vector<GLuint> deleted(n);
+        for (GLsizei i = 0; i < n; ++i) {
+            GLuint name;
+            memcpy(&name, recorded.bytes + i * sizeof(GLuint), sizeof(name));
+            deleted[i] = Translate(names, name);
+            names.erase(name);
+        }
+        destroy(n, deleted.data());
+    }
+
+    GLint TranslateUniform(GLint location) const {
+        const auto it = uniformLocations.find({ program, location });
+        return it == uniformLocations.end() ? location : it->second;
+    }
+
+    GLuint TranslateAttrib(GLuint location) const {
+        const auto it = attribLocations.find(location);
+        return it == attribLocations.end() ? location : it->second;
+    }
+
+    // The stand-in framebuffer has no back buffer
+    static GLenum TranslateBuffer(GLenum buffer) {
+        return buffer == GL_BACK ? GL_COLOR_ATTACHMENT0 : buffer;
+    }
+
+    static const void* Pointer(int64_t offset) {
+        return reinterpret_cast<const void*>(static_cast<intptr_t>(offset));
+    }
+
+    GLuint backbuffer = 0, colourBuffer = 0, depthBuffer = 0;
+    Names buffers, textures, vertexArrays, framebuffers, renderbuffers, queries, shaders, programs;
+    std::unordered_map<uint64_t, GLsync> syncs;
+    std::map<std::pair<GLuint, GLint>, GLint> uniformLocations;
+    std::map<std::pair<GLuint, GLuint>, GLuint> blockIndices;
+    std::unordered_map<GLuint, GLuint> attribLocations;
+    std::unordered_map<GLenum, void*> mappings;
+    std::vector<uint8_t> readback;
+    // As recorded
+    GLuint program = 0;
+};
+
+void Replayer::Execute(const Record& record) {
+    Reader args(record.args);
+    switch (record.call) {
+    case GlTrace::EndFrame:
+    case GlTrace::NumCalls:
+        break;
+
+    case GlTrace::GenBuffers:
+        Generate(buffers, args, glGenBuffers);
+        break;
+    case GlTrace::DeleteBuffers:
+        Delete(buffers, args, glDeleteBuffers);
+        break;
+    case GlTrace::GenTextures:
+        Generate(textures, args, glGenTextures);
+        break;
+    case GlTrace::DeleteTextures:
+        Delete(textures, args, glDeleteTextures);
+        break;
+    case GlTrace::GenVertexArrays:
+        Generate(vertexArrays, args, glGenVertexArrays);
+        break;
+    case GlTrace::DeleteVertexArrays:
+        Delete(vertexArrays, args, glDeleteVertexArrays);
+        break;
+    case GlTrace::GenFramebuffers:
+        Generate(framebuffers, args, glGenFramebuffers);
+        break;
+    case GlTrace::DeleteFramebuffers:
+        Delete(framebuffers, args, glDeleteFramebuffers);
+        break;
+    case GlTrace::GenRenderbuffers:
+        Generate(renderbuffers, args, glGenRenderbuffers);
+        break;
+    case GlTrace::DeleteRenderbuffers:
+        Delete(renderbuffers, args, glDeleteRenderbuffers);
+        break;
+    case GlTrace::GenQueries:
+        Generate(queries, args, glGenQueries);
+        break;
+    case GlTrace::DeleteQueries:
+        Delete(queries, args, glDeleteQueries);
+        break;
+    case GlTrace::CreateShader: {
+        const auto type = args.Read<GLenum>();
+        shaders[args.Read<GLuint>()] = glCreateShader(type);
+        break;
+    }
+    case GlTrace::DeleteShader: {
+        const auto shader = args.Read<GLuint>();
+        glDeleteShader(Translate(shaders, shader));
+        shaders.erase(shader);
+        break;
+    }
+    case GlTrace::CreateProgram:
+        programs[args.Read<GLuint>()] = glCreateProgram();
+        break;
+    case GlTrace::DeleteProgram: {
+        const auto deleted = args.Read<GLuint>();
+        glDeleteProgram(Translate(programs, deleted));
+        programs.erase(deleted);
+        break;
+    }
+    case GlTrace::FenceSync: {
+        const auto condition = args.Read<GLenum>();
+        const auto flags = args.Read<GLbitfield>();
+        // Looping replays the fence without the later frame that deletes it
+        auto& sync = syncs[args.Read<uint64_t>()];
+        if (sync != nullptr) {
+            glDeleteSync(sync);
+        }
+        sync = glFenceSync(condition, flags);
+        break;
+    }
+    // Syncs deleted since, eg. by the previous time round the loop, are skipped
+    case GlTrace::DeleteSync: {
+        const auto it = syncs.find(args.Read<uint64_t>());
+        if (it != syncs.end()) {
+            glDeleteSync(it->second);
+            syncs.erase(it);
+        }
+        break;
+    }
+    case GlTrace::ClientWaitSync: {
+        const auto it = syncs.find(args.Read<uint64_t>());
+        const auto flags = args.Read<GLbitfield>();
+        const auto timeout = args.Read<GLuint64>();
+        if (it != syncs.end()) {
+            glClientWaitSync(it->second, flags, timeout);
+        }
+        break;
+    }
+
+    case GlTrace::ShaderSource: {
+        const auto shader = args.Read<GLuint>();
+        const auto source = args.ReadData();
+        const auto* string = reinterpret_cast<const GLchar*>(source.bytes);
+        const auto length = static_cast<GLint>(source.size);
+        glShaderSource(Translate(shaders, shader), 1, &string, &length);
+        break;
+    }
+    case GlTrace::CompileShader:
+        glCompileShader(Translate(shaders, args.Read<GLuint>()));
+        break;
+    case GlTrace::AttachShader: {
+        const auto attachedTo = args.Read<GLuint>();
+        glAttachShader(Translate(programs, attachedTo), Translate(shaders, args.Read<GLuint>()));
+        break;
+    }
+    case GlTrace::LinkProgram:
+        glLinkProgram(Translate(programs, args.Read<GLuint>()));
+        break;
+    case GlTrace::BindFragDataLocation: {
+        const auto bound = args.Read<GLuint>();
+        const auto color = args.Read<GLuint>();
+        glBindFragDataLocation(Translate(programs, bound), color, args.ReadString().c_str());
+        break;
+    }
+    case GlTrace::GetUniformLocation: {
+        const auto queried = args.Read<GLuint>();
+        const auto location = args.Read<GLint>();
+        uniformLocations[{ queried, location }] = glGetUniformLocation(Translate(programs, queried), args.ReadString().c_str());
+        break;
+    }
+    case GlTrace::GetUniformBlockIndex: {
+        const auto queried = args.Read<GLuint>();
+        const auto index = args.Read<GLuint>();
+        blockIndices[{ queried, index }] = glGetUniformBlockIndex(Translate(programs, queried), args.ReadString().c_str());
+        break;
+    }
+    // Attribute locations aren't per program in the calls that use them, so
+    // the latest lookup wins
+    case GlTrace::GetAttribLocation: {
+        const auto queried = args.Read<GLuint>();
+        const auto location = args.Read<GLint>();
+        const auto name = args.ReadString();
+        if (location >= 0) {
+            attribLocations[location] = glGetAttribLocation(Translate(programs, queried), name.c_str());
+        }
+        break;
+    }
+    case GlTrace::UniformBlockBinding: {
+        const auto bound = args.Read<GLuint>();
+        const auto index = args.Read<GLuint>();
+        const auto binding = args.Read<GLuint>();
+        const auto it = blockIndices.find({ bound, index });
+        glUniformBlockBinding(Translate(programs, bound), it == blockIndices.end() ? index : it->second, binding);
+        break;
+    }
+    case GlTrace::UseProgram:
+        program = args.Read<GLuint>();
+        glUseProgram(Translate(programs, program));
+        break;
+    case GlTrace::Uniform1i: {
+        const auto location = TranslateUniform(args.Read<GLint>());
+        glUniform1i(location, args.Read<GLint>());
+        break;
+    }
+    case GlTrace::Uniform1f: {
+        const auto location = TranslateUniform(args.Read<GLint>());
+        glUniform1f(location, args.Read<GLfloat>());
+        break;
+    }
+    case GlTrace::Uniform2fv: {
+        const auto location = TranslateUniform(args.Read<GLint>());
+        const auto value = args.ReadData();
+        glUniform2fv(location, value.size / (2 * sizeof(GLfloat)), reinterpret_cast<const GLfloat*>(value.bytes));
+        break;
+    }
+    case GlTrace::Uniform3fv: {
+        const auto location = TranslateUniform(args.Read<GLint>());
+        const auto value = args.ReadData();
+        glUniform3fv(location, value.size / (3 * sizeof(GLfloat)), reinterpret_cast<const GLfloat*>(value.bytes));
+        break;
+    }
+    case GlTrace::Uniform4fv: {
+        const auto location = TranslateUniform(args.Read<GLint>());
+        const auto value = args.ReadData();
+        glUniform4fv(location, value.size / (4 * sizeof(GLfloat)), reinterpret_cast<const GLfloat*>(value.bytes));
+        break;
+    }
+    case GlTrace::UniformMatrix4fv: {
+        const auto location = TranslateUniform(args.Read<GLint>());
+        const auto transpose = args.Read<GLboolean>();
+        const auto value = args.ReadData();
+        glUniformMatrix4fv(location, value.size / (16 * sizeof(GLfloat)), transpose, reinterpret_cast<const GLfloat*>(value.bytes));
+        break;
+    }
+
+    case GlTrace::BindBuffer: {
+        const auto target = args.Read<GLenum>();
+        glBindBuffer(target, Translate(buffers, args.Read<GLuint>()));
+        break;
+    }
+    case GlTrace::BindBufferRange: {
+        const auto target = args.Read<GLenum>();
+        const auto index = args.Read<GLuint>();
+        const auto buffer = Translate(buffers, args.Read<GLuint>());
+        const auto offset = args.Read<int64_t>();
+        glBindBufferRange(target, index, buffer, offset, args.Read<int64_t>());
+        break;
+    }
+    case GlTrace::BufferData: {
+        const auto target = args.Read<GLenum>();
+        const auto size = args.Read<int64_t>();
+        const auto usage = args.Read<GLenum>();
+        const auto hasData = args.Read<uint8_t>();
+        const auto data = args.ReadData();
+        glBufferData(target, size, hasData ? data.bytes : nullptr, usage);
+        break;
+    }
+    case GlTrace::BufferSubData: {
+        const auto target = args.Read<GLenum>();
+        const auto offset = args.Read<int64_t>();
+        const auto data = args.ReadData();
+        glBufferSubData(target, offset, data.size, data.bytes);
+        break;
+    }
+    case GlTrace::CopyBufferSubData: {
+        const auto readTarget = args.Read<GLenum>();
+        const auto writeTarget = args.Read<GLenum>();
+        const auto readOffset = args.Read<int64_t>();
+        const auto writeOffset = args.Read<int64_t>();
+        glCopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, args.Read<int64_t>());
+        break;
+    }
+    case GlTrace::MapBufferRange: {
+        const auto target = args.Read<GLenum>();
+        const auto offset = args.Read<int64_t>();
+        const auto length = args.Read<int64_t>();
+        mappings[target] = glMapBufferRange(target, offset, length, args.Read<GLbitfield>());
+        break;
+    }
+    case GlTrace::UnmapBuffer: {
+        const auto target = args.Read<GLenum>();
+        const auto written = args.ReadData();
+        auto* mapping = mappings[target];
+        if (mapping != nullptr && written.size > 0) {
+            memcpy(mapping, written.bytes, written.size);
+        }
+        mappings.erase(target);
+        glUnmapBuffer(target);
+        break;
+    }
+    case GlTrace::TexBuffer: {
+        const auto target = args.Read<GLenum>();
+        const auto internalFormat = args.Read<GLenum>();
+        glTexBuffer(target, internalFormat, Translate(buffers, args.Read<GLuint>()));
+        break;
+    }
+
+    case GlTrace::BindVertexArray:
+        glBindVertexArray(Translate(vertexArrays, args.Read<GLuint>()));
+        break;
+    case GlTrace::EnableVertexAttribArray:
+        glEnableVertexAttribArray(TranslateAttrib(args.Read<GLuint>()));
+        break;
+    case GlTrace::VertexAttribPointer: {
+        const auto index = TranslateAttrib(args.Read<GLuint>());
+        const auto size = args.Read<GLint>();
+        const auto type = args.Read<GLenum>();
+        const auto normalized = args.Read<GLboolean>();
+        const auto stride = args.Read<GLsizei>();
+        glVertexAttribPointer(index, size, type, normalized, stride, Pointer(args.Read<int64_t>()));
+        break;
+    }
+    case GlTrace::VertexAttribIPointer: {
+        const auto index = TranslateAttrib(args.Read<GLuint>());
+        const auto size = args.Read<GLint>();
+        const auto type = args.Read<GLenum>();
+        const auto stride = args.Read<GLsizei>();
+        glVertexAttribIPointer(index, size, type, stride, Pointer(args.Read<int64_t>()));
+        break;
+    }
+    case GlTrace::VertexAttribDivisor: {
+        const auto index = TranslateAttrib(args.Read<GLuint>());
+        glVertexAttribDivisor(index, args.Read<GLuint>());
+        break;
+    }
+
+    case GlTrace::ActiveTexture:
+        glActiveTexture(args.Read<GLenum>());
+        break;
+    case GlTrace::BindTexture: {
+        const auto target = args.Read<GLenum>();
+        glBindTexture(target, Translate(textures, args.Read<GLuint>()));
+        break;
+    }
+    case GlTrace::TexImage2D: {
+        const auto target = args.Read<GLenum>();
+        const auto level = args.Read<GLint>();
+        const auto internalFormat = args.Read<GLint>();
+        const auto width = args.Read<GLsizei>();
+        const auto height = args.Read<GLsizei>();
+        const auto border = args.Read<GLint>();
+        const auto format = args.Read<GLenum>();
+        const auto type = args.Read<GLenum>();
+        const auto hasPixels = args.Read<uint8_t>();
+        const auto pixels = args.ReadData();
+        glTexImage2D(target, level, internalFormat, width, height, border, format, type, hasPixels ? pixels.bytes : nullptr);
+        break;
+    }
+    case GlTrace::TexParameteri: {
+        const auto target = args.Read<GLenum>();
+        const auto pname = args.Read<GLenum>();
+        glTexParameteri(target, pname, args.Read<GLint>());
+        break;
+    }
+    case GlTrace::TexParameterfv: {
+        const auto target = args.Read<GLenum>();
+        const auto pname = args.Read<GLenum>();
+        glTexParameterfv(target, pname, reinterpret_cast<const GLfloat*>(args.ReadData().bytes));
+        break;
+    }
+    case GlTrace::PixelStorei: {
+        const auto pname = args.Read<GLenum>();
+        glPixelStorei(pname, args.Read<GLint>());
+        break;
+    }
+
+    case GlTrace::BindFramebuffer: {
+        const auto target = args.Read<GLenum>();
+        glBindFramebuffer(target, Translate(framebuffers, args.Read<GLuint>()));
+        break;
+    }
+    case GlTrace::FramebufferTexture2D: {
+        const auto target = args.Read<GLenum>();
+        const auto attachment = args.Read<GLenum>();
+        const auto textureTarget = args.Read<GLenum>();
+        const auto texture = Translate(textures, args.Read<GLuint>());
+        glFramebufferTexture2D(target, attachment, textureTarget, texture, args.Read<GLint>());
+        break;
+    }
+    case GlTrace::FramebufferRenderbuffer: {
+        const auto target = args.Read<GLenum>();
+        const auto attachment = args.Read<GLenum>();
+        const auto renderbufferTarget = args.Read<GLenum>();
+        glFramebufferRenderbuffer(target, attachment, renderbufferTarget, Translate(renderbuffers, args.Read<GLuint>()));
+        break;
+    }
+    case GlTrace::BindRenderbuffer: {
+        const auto target = args.Read<GLenum>();
+        glBindRenderbuffer(target, Translate(renderbuffers, args.Read<GLuint>()));
+        break;
+    }
+    case GlTrace::RenderbufferStorage: {
+        const auto target = args.Read<GLenum>();
+        const auto internalFormat = args.Read<GLenum>();
+        const auto width = args.Read<GLsizei>();
+        glRenderbufferStorage(target, internalFormat, width, args.Read<GLsizei>());
+        break;
+    }
+    case GlTrace::DrawBuffer:
+        glDrawBuffer(TranslateBuffer(args.Read<GLenum>()));
+        break;
+    case GlTrace::DrawBuffers: {
+        const auto recorded = args.ReadData();
+        std::vector<GLenum> drawBuffers(recorded.size / sizeof(GLenum));
+        memcpy(drawBuffers.data(), recorded.bytes, drawBuffers.size() * sizeof(GLenum));
+        std::transform(drawBuffers.begin(), drawBuffers.end(), drawBuffers.begin(), TranslateBuffer);
+        glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+        break;
+    }
+    case GlTrace::ReadBuffer:
+        glReadBuffer(TranslateBuffer(args.Read<GLenum>()));
+        break;
+    case GlTrace::BlitFramebuffer: {
+        GLint rect[8];
+        for (auto& coordinate : rect) {
+            coordinate = args.Read<GLint>();
+        }
+        const auto mask = args.Read<GLbitfield>();
+        glBlitFramebuffer(rect[0], rect[1], rect[2], rect[3], rect[4], rect[5], rect[6], rect[7], mask, args.Read<GLenum>());
+        break;
+    }
+    case GlTrace::ReadPixels: {
+        const auto x = args.Read<GLint>();
+        const auto y = args.Read<GLint>();
+        const auto width = args.Read<GLsizei>();
+        const auto height = args.Read<GLsizei>();
+        const auto format = args.Read<GLenum>();
+        const auto type = args.Read<GLenum>();
+        const auto intoBuffer = args.Read<uint8_t>();
+        const auto offset = args.Read<int64_t>();
+        if (intoBuffer) {
+            glReadPixels(x, y, width, height, format, type, const_cast<void*>(Pointer(offset)));
+        }
+        else {
+            // Enough for four floats a pixel
+            readback.resize(static_cast<size_t>(width) * height * 16);
+            glReadPixels(x, y, width, height, format, type, readback.data());
+        }
+        break;
+    }
+
+    case GlTrace::Enable:
+        glEnable(args.Read<GLenum>());
+        break;
+    case GlTrace::Disable:
+        glDisable(args.Read<GLenum>());
+        break;
+    case GlTrace::DepthFunc:
+        glDepthFunc(args.Read<GLenum>());
+        break;
+    case GlTrace::Viewport: {
+        const auto x = args.Read<GLint>();
+        const auto y = args.Read<GLint>();
+        const auto width = args.Read<GLsizei>();
+        glViewport(x, y, width, args.Read<GLsizei>());
+        break;
+    }
+    case GlTrace::ClearColor: {
+        const auto red = args.Read<GLfloat>();
+        const auto green = args.Read<GLfloat>();
+        const auto blue = args.Read<GLfloat>();
+        glClearColor(red, green, blue, args.Read<GLfloat>());
+        break;
+    }
+    case GlTrace::Clear:
+        glClear(args.Read<GLbitfield>());
+        break;
+
+    case GlTrace::DrawArrays: {
+        const auto mode = args.Read<GLenum>();
+        const auto first = args.Read<GLint>();
+        glDrawArrays(mode, first, args.Read<GLsizei>());
+        break;
+    }
+    case GlTrace::DrawElements: {
+        const auto mode = args.Read<GLenum>();
+        const auto count = args.Read<GLsizei>();
+        const auto type = args.Read<GLenum>();
+        glDrawElements(mode, count, type, Pointer(args.Read<int64_t>()));
+        break;
+    }
+    case GlTrace::MultiDrawElementsIndirect: {
+        const auto mode = args.Read<GLenum>();
+        const auto type = args.Read<GLenum>();
+        const auto indirect = Pointer(args.Read<int64_t>());
+        const auto drawCount = args.Read<GLsizei>();
+        glMultiDrawElementsIndirect(mode, type, indirect, drawCount, args.Read<GLsizei>());
+        break;
+    }
+
+    case GlTrace::QueryCounter: {
+        const auto id = Translate(queries, args.Read<GLuint>());
+        glQueryCounter(id, args.Read<GLenum>());
+        break;
+    }
+    case GlTrace::BeginQuery: {
+        const auto target = args.Read<GLenum>();
+        glBeginQuery(target, Translate(queries, args.Read<GLuint>()));
+        break;
+    }
+    case GlTrace::EndQuery:
+        glEndQuery(args.Read<GLenum>());
+        break;
+    case GlTrace::Finish:
+        glFinish();
+        break;
+    }
+}
+
+static void PrintPercentiles(const char* label, std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.;
+    for (auto sample : samples) {
+        sum += sample;
+    }
+    const auto percentile = [&](double p) {
+        return samples[std::min(static_cast<size_t>(p * samples.size()), samples.size() - 1)];
+    };
+    printf(
+        "%s: mean %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms\n",
+        label,
+        sum / samples.size(),
+        percentile(0.5),
+        percentile(0.95),
+        samples.back()
+    );
+}
+
+int main(int argc, char* argv[]) {
+    std::string tracePath;
+    int numLoops = 100;
+    int numWarmupLoops = 5;
+    bool softwareRendering = true;
+    bool stripRedundant = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+            numLoops = std::max(atoi(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            numWarmupLoops = std::max(atoi(argv[++i]), 0);
+        }
+        else if (strcmp(argv[i], "--hardware") == 0) {
+            softwareRendering = false;
+        }
+        else if (strcmp(argv[i], "--strip-redundant") == 0) {
+            stripRedundant = true;
+        }
+        else if (tracePath.empty() && argv[i][0] != '-') {
+            tracePath = argv[i];
+        }
+        else {
+            fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (tracePath.empty()) {
+        fprintf(stderr, "Usage: GlReplay TRACE [--loops N] [--warmup N] [--hardware] [--strip-redundant]\n");
+        return EXIT_FAILURE;
+    }
+
+    try {
+        const auto trace = LoadTrace(tracePath);
+        const auto& header = trace.header;
+        const auto loopBegin = trace.frameEnds[trace.frameEnds.size() - 2];
+        const auto loopEnd = trace.frameEnds.back();
+        printf(
+            "%u frames at %ux%u, %zu calls, %zu in the looped frame\n",
+            header.numFrames,
+            header.width,
+            header.height,
+            trace.records.size(),
+            loopEnd - loopBegin
+        );
+
+        // Worked out once up front so the timed loop pays nothing for it.
+        // The state going into every loop is what the looped frame left,
+        // so the model runs through it twice.
+        std::vector<bool> skip(loopEnd - loopBegin, false);
+        if (stripRedundant) {
+            StateModel model;
+            for (size_t i = 0; i < loopEnd; ++i) {
+                model.IsRedundant(trace.records[i]);
+            }
+            size_t numStripped = 0;
+            for (size_t i = loopBegin; i < loopEnd; ++i) {
+                skip[i - loopBegin] = model.IsRedundant(trace.records[i]);
+                numStripped += skip[i - loopBegin];
+            }
+            printf("Stripping %zu redundant calls from the looped frame\n", numStripped);
+        }
+
+        auto* window = HeadlessRenderer::CreateContext(header.width, header.height, softwareRendering);
+        {
+            Replayer replayer(header);
+            for (size_t i = 0; i < loopBegin; ++i) {
+                replayer.Execute(trace.records[i]);
+            }
+            glFinish();
+            if (const auto error = glGetError(); error != GL_NO_ERROR) {
+                fprintf(stderr, "GL error 0x%04x while setting up, the replay may not match the recording\n", error);
+            }
+
+            std::vector<double> submitTimes, frameTimes;
+            GlStats::Frame calls;
+            for (int loop = -numWarmupLoops; loop < numLoops; ++loop) {
+                GlStats::EndFrame();
+                const auto start = std::chrono::steady_clock::now();
+                for (size_t i = loopBegin; i < loopEnd; ++i) {
+                    if (!skip[i - loopBegin]) {
+                        replayer.Execute(trace.records[i]);
+                    }
+                }
+                const auto submitted = std::chrono::steady_clock::now();
+                glFinish();
+                const auto finished = std::chrono::steady_clock::now();
+                calls = GlStats::EndFrame();
+                if (loop >= 0) {
+                    submitTimes.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+                    frameTimes.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+                }
+            }
+
+            printf(
+                "%u draw calls, %u program, %u VAO, %u texture and %u framebuffer binds, %u uniform uploads per frame\n",
+                calls.numDrawCalls,
+                calls.numProgramBinds,
+                calls.numVaoBinds,
+                calls.numTextureBinds,
+                calls.numFramebufferBinds,
+                calls.numUniformUploads
+            );
+            PrintPercentiles("Submit", submitTimes);
+            PrintPercentiles("Frame", frameTimes);
+        }
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+    catch (const std::runtime_error& ex) {
+        fprintf(stderr, "%s\n", ex.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -17,6 +17,11 @@ public:
         pitch += delta;
     }
 
+    void SetAngles(float newYaw, float newPitch) {
+        yaw = newYaw;
+        pitch = newPitch;
+    }
+
 private:
     glm::vec3 centre;
     float distance, pitch, yaw;
@@ -0,0 +1,38 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "Graphics.hpp"
+
+// Renders a fixed sequence of frames the same way every run, to compare
+// performance between builds: simulated time advances by a fixed step, the
+// camera follows a path instead of the mouse and the GPU is waited for after
+// every frame so each one is measured on its own.
+class Benchmark {
+public:
+    // Angles in radians, time in simulated seconds from the first measured frame
+    struct CameraKey {
+        float time;
+        float yaw, pitch;
+    };
+
+    // Text with one key per line: seconds, then yaw and pitch in degrees.
+    // Blank lines and lines starting with # are skipped.
+    static std::vector<CameraKey> LoadCameraPath(const std::filesystem::path& path);
+    // An orbit of the scene, dipping the camera up and back down
+    static std::vector<CameraKey> DefaultCameraPath();
+
+    Benchmark(std::shared_ptr<Graphics> graphics, std::vector<CameraKey> cameraPath);
+
+    // Draws numWarmupFrames unmeasured frames at the start of the path, then
+    // numFrames measured ones, and writes a CSV row for each measured frame.
+    // Needs an initialised Graphics with its context current on this thread.
+    void Run(int numWarmupFrames, int numFrames, float timeStep, const std::filesystem::path& csvPath);
+
+private:
+    CameraKey Sample(float time) const;
+
+    std::shared_ptr<Graphics> graphics;
+    std::vector<CameraKey> cameraPath;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+
+#include "TransformSystem.hpp"
+
+class GpuRingBuffer;
+class Shader;
+
+// Everything needed to issue one draw call. Uniforms have already been written
+// to the ring buffer, so executing the command only binds ranges of it.
+struct DrawCommand {
+    Shader* shader = nullptr;
+    GLuint vao = 0;
+    GLsizei numElements = 0;
+    bool bindTextures = true;
+
+    GLuint uniformBuffer = 0;
+    GLintptr perDrawOffset = 0;
+    GLintptr perViewOffset = 0;
+};
+
+// What a pass records against: the matrices for its view, where to write
+// per-draw uniforms and optionally one shader to draw everything with.
+// Depth-only passes draw from the position stream and bind no textures, so
+// their override shader must read nothing but position.
+struct PassContext {
+    const TransformSystem* transforms = nullptr;
+    const TransformSystem::View* view = nullptr;
+    GpuRingBuffer* uniforms = nullptr;
+    GLintptr perViewOffset = 0;
+    Shader* overrideShader = nullptr;
+    bool depthOnly = false;
+};
+
+// A list of draw commands that can be recorded on any thread and then
+// executed on the thread that owns the GL context. Lists keep their storage
+// between frames, so once warmed up neither recording nor executing allocates.
+class CommandList {
+public:
+    void Reset() {
+        commands.clear();
+    }
+
+    void Reserve(size_t size) {
+        commands.reserve(size);
+    }
+
+    void Record(const DrawCommand& command) {
+        commands.push_back(command);
+    }
+
+    size_t GetSize() const {
+        return commands.size();
+    }
+
+    // Must be called from the GL thread, after the uniform ring buffer has been flushed.
+    void Execute() const;
+
+private:
+    std::vector<DrawCommand> commands;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#if defined(__x86_64__) || defined(_M_X64)
+#define GLITTER_PROFILE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Records when the scopes marked with PROFILE_SCOPE start and end, on every
+// thread, and writes them out as a Chrome trace that Perfetto and
+// chrome://tracing can load.
+//
+// Each thread appends to a buffer of its own without taking locks, into
+// blocks of events prepared when recording starts, and only allocates once
+// those are used up. Markers cost a relaxed load while not recording.
+// Building without GLITTER_PROFILING removes them altogether.
+class CpuProfiler {
+public:
+    static void Start();
+    static void Stop();
+
+    static bool IsRecording() {
+        return recording.load(std::memory_order_relaxed);
+    }
+
+    // Everything recorded so far. Safe to call while recording.
+    static void WriteChromeTrace(const std::filesystem::path& path);
+
+    // Names the calling thread in traces
+    static void SetThreadName(const std::string& name);
+
+    // A copy of name that lives as long as the program, for scope names that
+    // aren't literals. Takes a lock, so keep it out of hot paths.
+    static const char* Intern(const std::string& name);
+
+    // In ticks of the CPU's timestamp counter where there is one, which
+    // reads in a fraction of the time of the OS clock, and nanoseconds of
+    // steady_clock otherwise. Traces are converted to nanoseconds on export.
+    static uint64_t Now() {
+#ifdef GLITTER_PROFILE_TSC
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+#endif
+    }
+
+    // name must outlive the profiler, eg. a literal or from Intern. start
+    // and end come from Now.
+    static void Record(const char* name, uint64_t start, uint64_t end);
+
+private:
+    static inline std::atomic<bool> recording = false;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(name), start(CpuProfiler::IsRecording() ? CpuProfiler::Now() : 0) {
+    }
+
+    ~ProfileScope() {
+        if (start != 0) {
+            CpuProfiler::Record(name, start, CpuProfiler::Now());
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#ifdef GLITTER_PROFILING
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
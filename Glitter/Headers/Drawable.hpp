@@ -3,34 +3,85 @@
 #include <glm/glm.hpp>
 #include <memory>
 
+#include "CommandList.hpp"
+#include "TransformSystem.hpp"
+
+class Drawable;
 class Shader;
 class Mesh;
 class Timer;
+struct PerDrawUniforms;
+
+// One drawable placed in the scene.
+struct Renderable {
+    const Drawable* drawable;
+    TransformSystem::Handle transform;
+};
 
 class Drawable {
 public:
+    // Where depth-only shaders must read the position attribute from.
+    static const GLuint DepthPositionLocation = 0;
+
     Drawable(const Mesh& mesh, const std::shared_ptr<Shader> shader);
 
     virtual ~Drawable();
 
-    void Draw(
-        const glm::mat4& model, 
-        const glm::mat4& view, 
-        const glm::mat4& projection, 
-        std::shared_ptr<Shader> overrideShader = nullptr
+    // Writes this drawable's uniforms for the pass and records a command to
+    // draw it. Safe to call from any thread.
+    void Record(
+        CommandList& commandList,
+        const PassContext& pass,
+        TransformSystem::Handle transform
     ) const;
 
+    // The per-draw uniforms of a transform in the pass's view, as every draw
+    // path writes them.
+    static void WritePerDrawUniforms(
+        PerDrawUniforms& out,
+        const PassContext& pass,
+        TransformSystem::Handle transform
+    );
+
+    Shader* GetShader() const {
+        return shaderProgram.get();
+    }
+
+    GLuint GetVertexBuffer() const {
+        return vbo;
+    }
+
+    GLuint GetIndexBuffer() const {
+        return ebo;
+    }
+
+    GLsizeiptr GetVertexDataSize() const {
+        return vertexDataSize;
+    }
+
+    GLuint GetPositionBuffer() const {
+        return positionVbo;
+    }
+
+    GLsizeiptr GetPositionDataSize() const {
+        return positionDataSize;
+    }
+
+    unsigned int GetNumElements() const {
+        return numElements;
+    }
+
 private:
     std::shared_ptr<Shader> shaderProgram;
 
     // uniform locations
-    GLint modelLocation = 0;
-    GLint modelViewProjectionLocation = 0;
-    GLint modelInverseTransposeLocation = 0;
-    GLint worldSpaceCameraPosLocation = 0; 
     GLint reverseLightDirectionLocation = 0;
 
     GLuint vbo = 0, vao = 0, ebo = 0;
+    GLsizeiptr vertexDataSize = 0;
+
+    GLuint positionVbo = 0, depthVao = 0;
+    GLsizeiptr positionDataSize = 0;
 
     glm::vec3 color = glm::vec3(0.5f, 1.f, 0.5f);
 
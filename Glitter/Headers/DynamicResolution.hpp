@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Picks the fraction of the window the scene is rendered at, so that the GPU
+// frame time stays within a budget. The targets stay allocated at full size
+// and only the viewport shrinks, so changing the scale costs nothing.
+//
+// GPU time is roughly proportional to the number of pixels, ie. to the square
+// of the scale. Measurements arrive a few frames late, so the scale only moves
+// every few frames, in limited steps, and not at all while the frame time is
+// within a band below the budget.
+class DynamicResolution {
+public:
+    explicit DynamicResolution(float budgetMilliseconds = 1000.f / 60.f);
+
+    // Call once per frame with the smoothed GPU time of recent frames.
+    void Update(float gpuMilliseconds);
+
+    // The scale applied to size, in whole pixels.
+    glm::uvec2 GetRenderSize(const glm::uvec2& size) const;
+
+    float GetScale() const {
+        return scale;
+    }
+
+    // Only has an effect while disabled, otherwise the next Update overrides it.
+    void SetScale(float newScale);
+
+    void SetEnabled(bool enable) {
+        enabled = enable;
+    }
+
+    bool IsEnabled() const {
+        return enabled;
+    }
+
+    void SetBudget(float milliseconds) {
+        budget = milliseconds;
+    }
+
+    float GetBudget() const {
+        return budget;
+    }
+
+    void SetScaleRange(float minimum, float maximum);
+
+    float GetMinScale() const {
+        return minScale;
+    }
+
+    unsigned int GetNumChanges() const {
+        return numChanges;
+    }
+
+private:
+    bool enabled = true;
+    float budget;
+    float scale = 1.f;
+    float minScale = 0.5f, maxScale = 1.f;
+
+    unsigned int framesSinceChange = 0;
+    unsigned int numChanges = 0;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Records frames to disk as an image sequence without stalling rendering.
+//
+// Each frame is read into one of a few pixel pack buffers, which only queues
+// the copy on the GPU. A few frames later, once its fence has signalled, the
+// buffer is mapped and the pixels handed to worker threads that encode and
+// write them, so neither the GPU copy nor the encoding holds up the frame.
+class FrameCapture {
+public:
+    enum Format {
+        Png,
+        // Bottom-up RGBA8 rows straight from GL, no header
+        Raw
+    };
+
+    static const unsigned int kNumBuffers = 4;
+
+    struct Stats {
+        unsigned int numCaptured = 0;
+        unsigned int numWritten = 0;
+        // Frames skipped because the encoders had too much queued
+        unsigned int numDropped = 0;
+        // Frames that had to wait for the GPU to finish an earlier copy
+        unsigned int numStalls = 0;
+        unsigned int numQueued = 0;
+    };
+
+    explicit FrameCapture(unsigned int numEncoders = DefaultNumEncoders());
+    virtual ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Frames are written to directory as frame_00000.png and so on. When the
+    // encoders fall behind, frames are dropped, or with dropFrames false the
+    // frame waits for them.
+    void Start(const std::filesystem::path& directory, Format format, bool dropFrames = true);
+    // Reads back and writes every frame still in flight before returning.
+    void Stop();
+
+    bool IsRecording() const {
+        return recording;
+    }
+
+    // Call on the GL thread once a frame is drawn to framebuffer, before it
+    // is presented.
+    void Capture(GLuint framebuffer, const glm::uvec2& size);
+
+    Stats GetStats();
+
+    static unsigned int DefaultNumEncoders();
+
+private:
+    struct Readback {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        glm::uvec2 size = glm::uvec2(0);
+        unsigned int frame = 0;
+    };
+
+    struct Image {
+        std::vector<uint8_t> pixels;
+        glm::uvec2 size;
+        unsigned int frame;
+    };
+
+    // Hands the oldest readback to the encoders, waiting for it if needed.
+    void Retire(bool wait);
+    void EncoderLoop();
+    void Write(Image& image) const;
+
+    std::filesystem::path directory;
+    Format format = Png;
+    bool dropFrames = true;
+    bool recording = false;
+    unsigned int numEncoders;
+
+    std::array<Readback, kNumBuffers> readbacks;
+    // Readbacks in flight, oldest first
+    unsigned int oldest = 0, numPending = 0;
+    unsigned int nextFrame = 0;
+
+    std::vector<std::thread> encoders;
+    std::mutex mutex;
+    std::condition_variable wakeEncoders, imageWritten;
+    std::deque<Image> queue;
+    unsigned int numEncoding = 0;
+    bool quit = false;
+
+    Stats stats;
+};
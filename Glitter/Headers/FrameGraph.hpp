@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+class GpuProfiler;
+
+// Builds the frame out of passes that declare which render targets they read
+// and write, instead of wiring framebuffers together by hand.
+//
+// Passes are added every frame between Reset and Compile. Compile drops passes
+// whose results nothing uses, orders the rest so every read comes after the
+// writes it depends on, and gives transient targets GL objects from a pool,
+// sharing one object between targets whose lifetimes don't overlap.
+class FrameGraph {
+public:
+    typedef uint32_t Resource;
+
+    struct TextureDesc {
+        glm::uvec2 size = glm::uvec2(0);
+        GLenum internalFormat = GL_RGB8;
+        // For attachments that are never sampled
+        bool renderbuffer = false;
+
+        bool operator==(const TextureDesc& other) const {
+            return size == other.size && internalFormat == other.internalFormat && renderbuffer == other.renderbuffer;
+        }
+    };
+
+    class Builder {
+    public:
+        // A target that only lives for this frame, owned by the graph.
+        Resource Create(const std::string& name, const TextureDesc& desc);
+        void Read(Resource resource);
+        void Write(Resource resource);
+        // Keeps the pass even if nothing reads what it writes.
+        void SetSideEffect();
+
+    private:
+        friend class FrameGraph;
+        Builder(FrameGraph& graph, size_t pass) : graph(graph), pass(pass) {}
+
+        FrameGraph& graph;
+        size_t pass;
+    };
+
+    class Context {
+    public:
+        // Binds a framebuffer with everything the pass writes attached and
+        // sets the viewport to cover it.
+        void BindFramebuffer() const;
+
+        GLuint GetTexture(Resource resource) const;
+        glm::uvec2 GetSize(Resource resource) const;
+
+        // A framebuffer with only this resource attached, eg. to blit from.
+        GLuint GetFramebuffer(Resource resource) const;
+
+    private:
+        friend class FrameGraph;
+        Context(FrameGraph& graph, size_t pass) : graph(graph), pass(pass) {}
+
+        FrameGraph& graph;
+        size_t pass;
+    };
+
+    typedef std::function<void(Builder&)> SetupFunction;
+    typedef std::function<void(const Context&)> ExecuteFunction;
+
+    struct Stats {
+        unsigned int numPasses = 0;
+        unsigned int numCulled = 0;
+        unsigned int numTransients = 0;
+        unsigned int numAllocated = 0;
+        size_t requestedBytes = 0;
+        size_t allocatedBytes = 0;
+    };
+
+    FrameGraph() = default;
+    virtual ~FrameGraph();
+
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    void Reset();
+
+    // Textures that outlive the frame. format is the texture's internal format.
+    Resource Import(const std::string& name, GLuint texture, const glm::uvec2& size, GLenum format);
+    // The window's framebuffer, or one standing in for it when rendering offscreen.
+    Resource ImportBackbuffer(const glm::uvec2& size, GLuint framebuffer = 0);
+
+    // Passes that write an output, directly or through other passes, are kept.
+    void MarkOutput(Resource resource);
+
+    void AddPass(const std::string& name, const SetupFunction& setup, const ExecuteFunction& execute);
+
+    void Compile();
+    // With a profiler, every pass is timed in a scope of its own.
+    void Execute(GpuProfiler* profiler = nullptr);
+
+    const Stats& GetStats() const {
+        return stats;
+    }
+
+    // Names of the passes that will run, in order. Valid after Compile.
+    std::vector<std::string> GetSchedule() const;
+
+private:
+    struct ResourceNode {
+        std::string name;
+        TextureDesc desc;
+        bool imported = false;
+        // object is then a framebuffer
+        bool backbuffer = false;
+        bool output = false;
+        GLuint object = 0;
+        std::vector<size_t> writers;
+        // Lifetime in execution order, for transients
+        size_t firstUse = SIZE_MAX, lastUse = 0;
+    };
+
+    struct PassNode {
+        std::string name;
+        // name again, for the CPU profiler, if it was recording when the pass was added
+        const char* profileName = nullptr;
+        ExecuteFunction execute;
+        std::vector<Resource> reads, writes;
+        bool sideEffect = false;
+        bool kept = false;
+    };
+
+    struct Physical {
+        TextureDesc desc;
+        GLuint object = 0;
+        size_t availableFrom = 0;
+        bool used = false;
+    };
+
+    void AssignPhysical(ResourceNode& resource);
+    GLuint GetFramebuffer(const std::vector<Resource>& attachments);
+    void ReleasePool();
+
+    std::vector<ResourceNode> resources;
+    std::vector<PassNode> passes;
+    std::vector<size_t> order;
+
+    std::vector<Physical> pool;
+    std::map<std::vector<GLuint>, GLuint> framebuffers;
+
+    Stats stats;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <mutex>
+
+// Decides when each frame starts, and measures how evenly frames are
+// presented and how old the input they show is.
+//
+// With a frame cap, frames start on a fixed schedule. Waits sleep while there
+// is plenty of time left and spin for the last stretch, since sleeps can
+// overshoot by a millisecond or more.
+//
+// In low latency mode the wait moves to just before the next deadline, by
+// how long recent frames took to make plus a margin, so that input is read
+// as late as possible. The deadline is the frame cap's, or the next refresh
+// after the last present when only vsync paces frames.
+class FramePacer {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const size_t kHistorySize = 240;
+
+    struct Stats {
+        float intervalMilliseconds = 0.f;
+        // Standard deviation of the present-to-present interval
+        float jitterMilliseconds = 0.f;
+        float latencyMilliseconds = 0.f;
+        float maxLatencyMilliseconds = 0.f;
+        // Intervals more than half a period late
+        unsigned int numMissed = 0;
+        // Intervals the above are over, up to kHistorySize
+        unsigned int numSamples = 0;
+    };
+
+    // 0 for no cap
+    void SetFrameCap(float framesPerSecond) {
+        frameCap = framesPerSecond;
+    }
+
+    float GetFrameCap() const {
+        return frameCap;
+    }
+
+    // Of the display, for low latency mode without a cap
+    void SetRefreshRate(float hertz) {
+        refreshRate = hertz;
+    }
+
+    void SetLowLatency(bool enable) {
+        lowLatency = enable;
+    }
+
+    bool IsLowLatency() const {
+        return lowLatency;
+    }
+
+    // Call once per frame in this order. WaitForFrameStart blocks until the
+    // frame should start, OnInputSampled goes right after polling events and
+    // OnPresented right after swapping buffers, with the time OnInputSampled
+    // returned for that frame. OnPresented may be called on another thread.
+    void WaitForFrameStart();
+    Clock::time_point OnInputSampled();
+    void OnPresented(Clock::time_point inputTime);
+
+    // Over the last kHistorySize frames, or as many as there have been.
+    Stats GetStats() const;
+
+    // Present-to-present intervals in milliseconds, oldest first, for plotting.
+    std::array<float, kHistorySize> GetIntervalHistory() const;
+
+private:
+    static void WaitUntil(Clock::time_point deadline);
+    Clock::duration GetPeriod() const;
+
+    float frameCap = 0.f;
+    float refreshRate = 60.f;
+    bool lowLatency = false;
+
+    Clock::time_point nextDeadline;
+    bool started = false;
+
+    // Everything below is written by OnPresented
+    mutable std::mutex mutex;
+    Clock::time_point lastPresent;
+
+    // Smoothed time from input to present, ie. what a frame takes to make
+    float workMilliseconds = 0.f;
+
+    std::array<float, kHistorySize> intervals = {};
+    std::array<float, kHistorySize> latencies = {};
+    size_t next = 0, count = 0;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+
+// Counts the work every frame hands the driver, and keeps a running total of
+// the GPU memory the engine has allocated, by swapping glad's function
+// pointers for wrappers that count and then call through.
+//
+// Only sees calls made through glad, on the thread that owns the context, and
+// isn't synchronised, so read it from that thread too. Building without
+// GLITTER_PROFILING leaves the entry points alone and everything reads zero.
+class GlStats {
+public:
+    struct Frame {
+        unsigned int numDrawCalls = 0;
+        // Commands of indirect draws, whose triangles aren't known to the CPU
+        unsigned int numIndirectCommands = 0;
+        uint64_t numTriangles = 0;
+        unsigned int numProgramBinds = 0;
+        unsigned int numVaoBinds = 0;
+        unsigned int numTextureBinds = 0;
+        unsigned int numUniformUploads = 0;
+        unsigned int numFramebufferBinds = 0;
+        // Data passed to glBufferData and glBufferSubData plus ranges mapped
+        // for writing. Writes through persistent mappings aren't seen.
+        uint64_t bufferBytesUploaded = 0;
+        uint64_t textureBytesUploaded = 0;
+    };
+
+    enum Category {
+        Textures,
+        Meshes,
+        Framebuffers,
+        Other,
+        NumCategories
+    };
+
+    struct Memory {
+        size_t bytes[NumCategories] = {};
+
+        size_t GetTotal() const {
+            size_t total = 0;
+            for (auto categoryBytes : bytes) {
+                total += categoryBytes;
+            }
+            return total;
+        }
+    };
+
+    // Allocations made while one of these is alive count towards category.
+    // The outermost one wins, so a render target made of a Texture2D counts
+    // as a framebuffer.
+    class MemoryScope {
+    public:
+        explicit MemoryScope(Category category) : previous(current) {
+            if (current == Other) {
+                current = category;
+            }
+        }
+
+        ~MemoryScope() {
+            current = previous;
+        }
+
+        MemoryScope(const MemoryScope&) = delete;
+        MemoryScope& operator=(const MemoryScope&) = delete;
+
+    private:
+        Category previous;
+    };
+
+    // After gladLoadGL
+    static void Install();
+
+    // Returns what was counted since the last call and starts counting afresh
+    static Frame EndFrame();
+
+    static Memory GetMemory();
+
+    static const char* GetCategoryName(Category category);
+
+    // What the driver is likely to allocate for a pixel of internalFormat
+    static size_t GetBytesPerPixel(GLenum internalFormat);
+
+private:
+    // The wrappers, in GlStats.cpp
+    struct Hooks;
+    friend struct Hooks;
+
+    static inline Category current = Other;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+
+// Records every GL call the engine makes, with the data it uploads, from
+// context creation to the end of the last frame asked for, into a binary
+// trace that GlReplay plays back on another machine without the assets.
+//
+// Hooks glad's function pointers the same way GlStats does. While recording,
+// glBufferStorage is hidden so the uniform ring maps and unmaps its regions,
+// as writes through persistent mappings can't be seen.
+class GlTrace {
+public:
+    static const uint32_t kMagic = 0x52544c47; // "GLTR"
+    static const uint32_t kVersion = 1;
+
+    struct Header {
+        uint32_t magic = kMagic;
+        uint32_t version = kVersion;
+        // Of framebuffer 0, which the replay stands in for with one of its own
+        uint32_t width = 0, height = 0;
+        uint32_t numFrames = 0;
+    };
+
+    // Every record is the call, the size of its arguments in bytes and the
+    // arguments. Object names and locations are as the recording driver
+    // returned them, pointers into buffers as offsets, and data as a 32-bit
+    // size followed by the bytes.
+    enum Call : uint16_t {
+        EndFrame,
+
+        GenBuffers,
+        DeleteBuffers,
+        GenTextures,
+        DeleteTextures,
+        GenVertexArrays,
+        DeleteVertexArrays,
+        GenFramebuffers,
+        DeleteFramebuffers,
+        GenRenderbuffers,
+        DeleteRenderbuffers,
+        GenQueries,
+        DeleteQueries,
+        CreateShader,
+        DeleteShader,
+        CreateProgram,
+        DeleteProgram,
+        FenceSync,
+        DeleteSync,
+        ClientWaitSync,
+
+        ShaderSource,
+        CompileShader,
+        AttachShader,
+        LinkProgram,
+        BindFragDataLocation,
+        GetUniformLocation,
+        GetUniformBlockIndex,
+        GetAttribLocation,
+        UniformBlockBinding,
+        UseProgram,
+        Uniform1i,
+        Uniform1f,
+        Uniform2fv,
+        Uniform3fv,
+        Uniform4fv,
+        UniformMatrix4fv,
+
+        BindBuffer,
+        BindBufferRange,
+        BufferData,
+        BufferSubData,
+        CopyBufferSubData,
+        MapBufferRange,
+        UnmapBuffer,
+        TexBuffer,
+
+        BindVertexArray,
+        EnableVertexAttribArray,
+        VertexAttribPointer,
+        VertexAttribIPointer,
+        VertexAttribDivisor,
+
+        ActiveTexture,
+        BindTexture,
+        TexImage2D,
+        TexParameteri,
+        TexParameterfv,
+        PixelStorei,
+
+        BindFramebuffer,
+        FramebufferTexture2D,
+        FramebufferRenderbuffer,
+        BindRenderbuffer,
+        RenderbufferStorage,
+        DrawBuffer,
+        DrawBuffers,
+        ReadBuffer,
+        BlitFramebuffer,
+        ReadPixels,
+
+        Enable,
+        Disable,
+        DepthFunc,
+        Viewport,
+        ClearColor,
+        Clear,
+
+        DrawArrays,
+        DrawElements,
+        MultiDrawElementsIndirect,
+
+        QueryCounter,
+        BeginQuery,
+        EndQuery,
+        Finish,
+
+        NumCalls
+    };
+
+    // Before the context is created. Records until numFrames frames have
+    // ended, then writes the trace to path.
+    static void Open(const std::filesystem::path& path, int numFrames);
+
+    // After gladLoadGL. Does nothing unless Open was called first.
+    static void Install(const glm::uvec2& framebufferSize);
+
+    // Marks the end of a frame, on the thread that owns the context
+    static void MarkEndOfFrame();
+
+    // Writes out what was recorded if the last frame hasn't ended yet
+    static void Close();
+
+    static bool IsRecording();
+
+private:
+    // The wrappers, in GlTrace.cpp
+    struct Hooks;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class GpuTimer;
+
+// Times named stretches of GPU work, such as the passes of a frame, with
+// timestamp queries so they can nest. Like GpuTimer, results arrive a few
+// frames late and never stall. The last kHistorySize of them are kept for
+// each scope, for averages and graphs.
+class GpuProfiler {
+public:
+    static const size_t kHistorySize = 120;
+
+    struct Timing {
+        std::string label;
+        // How many scopes this one ran inside
+        int depth = 0;
+        // Over the history
+        float averageMilliseconds = 0.f;
+        float maxMilliseconds = 0.f;
+        // Oldest first
+        std::vector<float> history;
+    };
+
+    GpuProfiler();
+    virtual ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // Call once per frame, before its first scope.
+    void BeginFrame();
+
+    void Begin(const std::string& label);
+    void End();
+
+    // Scopes that ran last frame, in the order they began.
+    std::vector<Timing> GetTimings() const;
+
+private:
+    struct Scope {
+        std::unique_ptr<GpuTimer> timer;
+        unsigned int numResults = 0;
+        int depth = 0;
+        // Ring buffer once full
+        std::vector<float> history;
+        size_t next = 0;
+    };
+
+    std::map<std::string, Scope> scopes;
+    std::vector<const Scope*> stack;
+    std::vector<std::string> order, lastOrder;
+};
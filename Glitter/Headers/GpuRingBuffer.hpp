@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <glad/glad.h>
+
+// Streams per-frame data to the GPU through one big buffer split into three
+// regions, one per frame in flight. Each region is protected by a fence so the
+// CPU never writes over data the GPU may still be reading.
+//
+// Uses persistent mapping when the driver has buffer storage, otherwise maps
+// each region unsynchronized once per frame, and as a last resort orphans the
+// whole buffer every frame.
+class GpuRingBuffer {
+public:
+    enum Mode {
+        Persistent,
+        Unsynchronized,
+        Orphaning
+    };
+
+    static const unsigned int kNumRegions = 3;
+
+    struct Allocation {
+        void* data = nullptr;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+    };
+
+    // alignment is the minimum offset alignment of the binding type the
+    // allocations will be used with, eg. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+    GpuRingBuffer(GLenum target, GLsizeiptr regionSize, GLenum alignment);
+    virtual ~GpuRingBuffer();
+
+    GpuRingBuffer(const GpuRingBuffer&) = delete;
+    GpuRingBuffer& operator=(const GpuRingBuffer&) = delete;
+
+    // Waits for the oldest region to become free and makes it writable. Must be
+    // called on the GL thread before any allocations for the frame.
+    void BeginFrame();
+
+    // Hands out part of the current region. Safe to call from any thread
+    // between BeginFrame and Flush. Returns an empty allocation when the region
+    // is full, in which case the next BeginFrame grows the region to fit
+    // everything asked for since the last one.
+    // minAlignment is for allocations that are bound to a different target
+    // than the one the buffer was created for.
+    Allocation Allocate(GLsizeiptr size, GLsizeiptr minAlignment = 1);
+
+    // Makes everything written this frame visible to the GPU. Must be called on
+    // the GL thread after the last allocation and before anything that uses it
+    // is drawn. Returns false if an allocation didn't fit, in which case the
+    // frame's allocations must be made again after another BeginFrame.
+    bool Flush();
+
+    // Fences the current region once all the frame's draws have been submitted.
+    void EndFrame();
+
+    GLuint Get() const {
+        return buffer;
+    }
+
+    Mode GetMode() const {
+        return mode;
+    }
+
+    GLsizeiptr GetRegionSize() const {
+        return regionSize;
+    }
+
+    // Frames where the GPU was still using the region we wanted to write to.
+    unsigned int GetNumStalls() const {
+        return numStalls;
+    }
+
+private:
+    void CreateBuffer();
+    void DeleteBuffer();
+    void WaitForRegion(unsigned int index);
+
+    GLenum target;
+    GLuint buffer = 0;
+    Mode mode;
+
+    GLsizeiptr regionSize;
+    GLint alignment = 1;
+
+    unsigned int region = 0;
+    std::array<GLsync, kNumRegions> fences = {};
+    uint8_t* persistentData = nullptr;
+    uint8_t* regionData = nullptr;
+
+    std::atomic<GLsizeiptr> used = 0;
+    std::atomic<bool> overflowed = false;
+
+    unsigned int numStalls = 0;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <glad/glad.h>
+
+// Measures how long the GPU spends on the commands between Begin and End.
+// Results are read back a few frames later so the CPU never waits on them.
+// GL_TIME_ELAPSED queries can't nest, so only one timer may be running at a
+// time. Timestamp timers use a pair of GL_TIMESTAMP queries instead, and can
+// be wrapped around other timers.
+class GpuTimer {
+public:
+    static const unsigned int kNumQueries = 4;
+
+    enum Mode {
+        Elapsed,
+        Timestamps
+    };
+
+    explicit GpuTimer(Mode mode = Elapsed);
+    virtual ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void Begin();
+    void End();
+
+    // Smoothed over recent frames, 0 until the first result arrives or when
+    // timer queries aren't supported.
+    float GetMilliseconds() const {
+        return milliseconds;
+    }
+
+    // The most recent result, unsmoothed, and how many results have arrived.
+    float GetLastMilliseconds() const {
+        return lastMilliseconds;
+    }
+    unsigned int GetNumResults() const {
+        return numResults;
+    }
+
+private:
+    void ReadResults();
+
+    Mode mode;
+    std::array<GLuint, kNumQueries> queries = {};
+    // Only for timestamp timers
+    std::array<GLuint, kNumQueries> endQueries = {};
+    std::array<bool, kNumQueries> pending = {};
+    unsigned int current = 0;
+
+    float milliseconds = 0.f;
+    float lastMilliseconds = 0.f;
+    unsigned int numResults = 0;
+};
@@ -3,17 +3,91 @@
 #include <glm/glm.hpp>
 #include <memory>
 
+#include "GlStats.hpp"
+
+class GpuProfiler;
+
 class Graphics {
 public:
+    // Everything Render needs to draw a frame, built by Update. A copy of the
+    // scene's state rather than a reference to it, so the next Update can run
+    // while the last frame is still being drawn.
+    class Frame {
+    public:
+        Frame();
+        ~Frame();
+
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+
+    private:
+        friend class Graphics;
+        struct Data;
+        std::unique_ptr<Data> data;
+    };
+
+    // What the last Render did, for benchmarks
+    struct Counters {
+        // Of the frame graph, from the latest timer result, which lags a few
+        // frames behind unless the GPU is waited for after every frame
+        float gpuMilliseconds = 0.f;
+        // Changes whenever a new GPU timer result arrives
+        unsigned int numGpuResults = 0;
+        // Draw calls and objects of the shadow and scene passes
+        unsigned int numDrawCalls = 0;
+        unsigned int numObjects = 0;
+        unsigned int numPasses = 0;
+        // Everything Render sent to GL, plus anything since the last Render
+        GlStats::Frame api;
+        GlStats::Memory memory;
+    };
+
     Graphics(); 
     ~Graphics(); 
     void Init(glm::uvec2 framebufferSize, glm::dvec2 cursorPosition);
+
+    // Update then Render, on the thread that owns the GL context.
     void Draw();
 
+    // Steps the scene and builds the GUI into frame. Makes no GL calls, so it
+    // can run on another thread while Render draws the previous frame. Needs
+    // an ImGui frame unless the GUI is disabled.
+    void Update(Frame& frame);
+    // Draws a frame from Update. Only on the thread that owns the GL context.
+    void Render(const Frame& frame);
+
+    // Input goes to the Update side, so call these on the thread that runs it.
     void OnResize(glm::uvec2 framebufferSize);
     void OnCursorMoved(glm::dvec2 cursorPos);
     void OnMouseButton(int button, int action);
 
+    // For headless rendering, where there is no ImGui context and no window
+    void SetGUIEnabled(bool enabled);
+    // Draw into this framebuffer instead of the window's, 0 for the window
+    void SetTargetFramebuffer(unsigned int framebuffer);
+
+    // Fixed time steps, and nothing that adapts to measured timings such as
+    // dynamic resolution, so the same frames do the same work every run.
+    void SetDeterministic(float timeStep);
+    // Replaces mouse control of the camera, in radians. Update side.
+    void SetCameraAngles(float yaw, float pitch);
+    // Render side
+    Counters GetCounters() const;
+
+    // Times GPU work by scope, for drawing done on top of Render's, eg. the
+    // GUI. Only on the thread that owns the GL context, after Init.
+    GpuProfiler& GetGpuProfiler();
+
+    // Whether the next frame would differ from the last without any input:
+    // something in the scene or a post effect moves, frames are being recorded or
+    // a redraw was requested since the last call. On the Update side.
+    bool WantsRedraw();
+    // From any thread, eg. when something finishes loading in the background
+    void RequestRedraw();
+    // After waiting for a reason to redraw, so the wait isn't timed as a
+    // frame. On the Update side.
+    void ResumeAfterIdle();
+
 private:
     struct CheshireCat;
     const std::unique_ptr<CheshireCat> cc;
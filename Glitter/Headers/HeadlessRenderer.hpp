@@ -0,0 +1,63 @@
+#pragma once
+#include <filesystem>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <memory>
+
+#include "FrameCapture.hpp"
+#include "Graphics.hpp"
+
+// Runs Graphics without a display, eg. on CI machines with no GPU.
+//
+// The context comes from GLFW's null platform, created through EGL
+// (surfaceless) or failing that OSMesa, and with software rendering forced
+// it runs on Mesa's llvmpipe. Neither guarantees a usable default
+// framebuffer, so frames are drawn into one of our own and read back from it.
+class HeadlessRenderer
+{
+public:
+    HeadlessRenderer(std::shared_ptr<Graphics> graphics, int width, int height, bool softwareRendering = true);
+    virtual ~HeadlessRenderer();
+
+    HeadlessRenderer(const HeadlessRenderer&) = delete;
+    HeadlessRenderer& operator=(const HeadlessRenderer&) = delete;
+
+    // Draws numFrames frames, writing each as frame_00000.png and so on if
+    // outputDirectory isn't empty.
+    void RenderFrames(int numFrames, const std::filesystem::path& outputDirectory);
+
+    struct IdleStats {
+        unsigned int numFrames = 0;
+        double cpuSeconds = 0.;
+        double wallSeconds = 0.;
+    };
+
+    // Runs for seconds the way a window redrawing on demand does, with the
+    // same RedrawScheduler deciding when to draw and sleeping otherwise, and
+    // measures the CPU time the whole process used. Whatever is pending at the
+    // start is drawn before measuring.
+    IdleStats RunOnDemand(double seconds);
+
+    glm::ivec2 GetFramebufferSize() const {
+        return size;
+    }
+
+    glm::dvec2 GetCursorPosition() const {
+        return glm::dvec2(0.0);
+    }
+
+    // Initialises GLFW and makes a headless context current, with glad
+    // loaded, for tools that draw without Graphics. Throws if there is none.
+    static GLFWwindow* CreateContext(int width, int height, bool softwareRendering);
+
+private:
+    std::shared_ptr<Graphics> graphics;
+    GLFWwindow* window = nullptr;
+    glm::ivec2 size;
+
+    GLuint framebuffer = 0;
+    GLuint colourBuffer = 0, depthBuffer = 0;
+
+    std::unique_ptr<FrameCapture> capture;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <imgui.h>
+
+// A copy of ImGui's draw data that stays valid after the next ImGui::NewFrame,
+// so the GUI can be built on one thread and rendered on another.
+class ImGuiFrame {
+public:
+    ImGuiFrame() = default;
+    virtual ~ImGuiFrame();
+
+    ImGuiFrame(const ImGuiFrame&) = delete;
+    ImGuiFrame& operator=(const ImGuiFrame&) = delete;
+
+    // Call after ImGui::Render with ImGui::GetDrawData().
+    void CopyFrom(const ImDrawData* source);
+
+    // nullptr until the first copy.
+    ImDrawData* Get() {
+        return data.Valid ? &data : nullptr;
+    }
+
+private:
+    void Clear();
+
+    ImDrawData data = ImDrawData();
+};
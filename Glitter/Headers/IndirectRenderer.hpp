@@ -0,0 +1,91 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <unordered_map>
+#include <vector>
+
+#include "CommandList.hpp"
+#include "Drawable.hpp"
+#include "Mesh.hpp"
+
+class Shader;
+
+// Layout glMultiDrawElementsIndirect reads its commands in.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Draws using the Shader's indirect variant and one multi-draw per batch.
+struct IndirectBatch {
+    Shader* shader = nullptr;
+    GLsizei drawCount = 0;
+    GLintptr commandsOffset = 0;
+    GLintptr perDrawOffset = 0;
+    GLsizeiptr perDrawSize = 0;
+};
+
+struct IndirectPass {
+    std::vector<IndirectBatch> batches;
+    GLuint buffer = 0;
+    GLintptr perViewOffset = 0;
+    bool depthOnly = false;
+};
+
+// Alternative to command lists for GL 4.3 contexts. All meshes are copied into
+// one shared vertex and index buffer, so everything drawn with the same shader
+// can go out in a single glMultiDrawElementsIndirect call. Per-draw uniforms
+// are read from a shader storage buffer, indexed by a per-instance draw id
+// attribute that each command's baseInstance selects.
+class IndirectRenderer {
+public:
+    static bool IsSupported();
+
+    explicit IndirectRenderer(const VertexAttribInfoList& vertexAttribs);
+    virtual ~IndirectRenderer();
+
+    IndirectRenderer(const IndirectRenderer&) = delete;
+    IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+    // Register every drawable that will be drawn, then Upload once.
+    void Add(const Drawable& drawable);
+    void Upload(size_t maxDrawsPerBatch);
+
+    // Writes the commands and per-draw data for a pass into the pass's ring
+    // buffer. Renderables are grouped by shader, into as many batches of at most
+    // maxDrawsPerBatch as it takes. Those whose shader has no indirect variant,
+    // or whose drawable wasn't uploaded, go to notBatched for drawing some other way.
+    void Record(
+        IndirectPass& out,
+        const PassContext& pass,
+        const std::vector<Renderable>& renderables,
+        std::vector<Renderable>& notBatched
+    );
+
+    // Must be called from the GL thread, after the ring buffer has been flushed.
+    void Execute(const IndirectPass& pass) const;
+
+private:
+    struct MeshRange {
+        GLuint count;
+        GLuint firstIndex;
+        GLint baseVertex;
+    };
+
+    VertexAttribInfoList vertexAttribs;
+    GLsizei vertexStride = 0;
+    GLint storageAlignment = 1;
+
+    std::vector<const Drawable*> drawables;
+    std::unordered_map<const Drawable*, MeshRange> meshes;
+    size_t maxDrawsPerBatch = 0;
+
+    // Renderable indices grouped by shader, kept between frames to avoid allocating
+    std::vector<std::pair<Shader*, std::vector<size_t>>> groups;
+
+    GLuint vao = 0, vbo = 0, ebo = 0, drawIdBuffer = 0;
+    GLuint depthVao = 0, positionVbo = 0;
+};
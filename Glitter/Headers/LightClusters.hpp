@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+class Shader;
+class ThreadPool;
+
+// A light without a shadow map, shaded through LightClusters.
+struct ClusteredLight {
+    glm::vec3 position = glm::vec3(0.f);
+    // Distance at which the light has faded to nothing
+    float range = 1.f;
+    glm::vec3 colour = glm::vec3(1.f);
+
+    // Spot lights only. Point lights keep the cosines at -1.
+    glm::vec3 direction = glm::vec3(0.f, -1.f, 0.f);
+    float cosInner = -1.f, cosOuter = -1.f;
+};
+
+// Splits the camera frustum into a grid of clusters, screen space tiles that
+// are further split into depth slices growing exponentially with distance,
+// and works out which lights touch each cluster. The lit shaders then only
+// loop over the lights of the cluster a fragment is in.
+//
+// Lights are tested as bounding spheres against the clusters' view space
+// bounding boxes, four clusters at a time, with each depth slice handled by
+// one thread. The lists go to the GPU in three texture buffers.
+class LightClusters {
+public:
+    static const unsigned int kGridX = 16, kGridY = 9, kGridZ = 24;
+    static const unsigned int kNumClusters = kGridX * kGridY * kGridZ;
+
+    // Texture units the buffers are bound to, above the ones Shader::AddTexture hands out
+    static const GLint kGridTextureUnit = 13;
+    static const GLint kIndexTextureUnit = 14;
+    static const GLint kLightTextureUnit = 15;
+
+    struct Stats {
+        unsigned int numVisible = 0;
+        unsigned int numIndices = 0;
+        unsigned int maxPerCluster = 0;
+        float milliseconds = 0.f;
+    };
+
+    LightClusters();
+    virtual ~LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // Assigns lights to the clusters of a perspective camera and uploads the
+    // result. Call once per frame before drawing with it.
+    void Update(
+        const std::vector<ClusteredLight>& lights,
+        const glm::mat4& view,
+        const glm::mat4& projection,
+        ThreadPool* threadPool = nullptr
+    );
+
+    void Bind() const;
+
+    // screenSize is the size of the viewport the shader draws to.
+    void SetUniforms(Shader& shader, const glm::uvec2& screenSize) const;
+
+    const Stats& GetStats() const {
+        return stats;
+    }
+
+private:
+    struct Sphere {
+        glm::vec3 centre; // x, y and distance in front of the camera
+        float radius;
+        unsigned int firstSlice, lastSlice;
+    };
+
+    void BuildClusterBounds(const glm::mat4& projection);
+    void AssignSlice(unsigned int slice);
+    unsigned int GetSlice(float depth) const;
+
+    glm::mat4 projection = glm::mat4(0.f);
+    float nearPlane = 0.1f, farPlane = 100.f;
+    float sliceScale = 1.f;
+
+    // View space bounds of every cluster, slice by slice, with depth positive
+    // in front of the camera
+    std::array<std::vector<float>, 6> bounds;
+
+    std::vector<Sphere> spheres;
+    std::vector<std::vector<uint16_t>> clusterLights;
+
+    std::vector<glm::uvec2> grid;
+    std::vector<uint16_t> indices;
+    std::vector<glm::vec4> lightData;
+
+    std::array<GLuint, 3> buffers = {};
+    std::array<GLuint, 3> textures = {};
+
+    Stats stats;
+};
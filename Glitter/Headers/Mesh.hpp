@@ -19,6 +19,10 @@ public:
     virtual const void* GetVertexData() const = 0;
     virtual size_t GetVertexDataSize() const = 0;
 
+    // Tightly packed vec3 positions, for passes that read nothing else.
+    virtual const void* GetPositionData() const = 0;
+    virtual size_t GetPositionDataSize() const = 0;
+
     virtual const void* GetIndices() const = 0;
     virtual size_t GetIndicesSize() const = 0;
 
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "TransformSystem.hpp"
+
+class Mesh;
+class ThreadPool;
+
+// Hides drawables that are behind a few large occluders, entirely on the CPU.
+//
+// The occluders' triangles are rasterised into a small depth buffer, split
+// into tiles that are filled in parallel, four pixels at a time. A max-depth
+// mip chain of that buffer then lets each occludee's screen space bounding
+// rectangle be tested with at most four reads. Occludees outside the view
+// frustum are rejected too.
+//
+// Nothing here touches the GPU, and the results only depend on the inputs,
+// not on how the work was spread over threads.
+class OcclusionCuller {
+public:
+    static const int kWidth = 256, kHeight = 128;
+    static const int kTileWidth = 32, kTileHeight = 32;
+
+    struct Stats {
+        unsigned int numOccluderTriangles = 0;
+        unsigned int numTested = 0;
+        unsigned int numOccluded = 0;
+        unsigned int numOutside = 0;
+        float rasterMilliseconds = 0.f;
+        float testMilliseconds = 0.f;
+    };
+
+    // Occluders should be closed meshes, their back faces are skipped.
+    void AddOccluder(const Mesh& mesh, TransformSystem::Handle transform);
+
+    // Returns the index of the occludee in the results.
+    size_t AddOccludee(const Mesh& mesh, TransformSystem::Handle transform);
+
+    // Rasterises the occluders and tests every occludee, using the view's
+    // model-view-projection matrices.
+    void Cull(const TransformSystem::View& view, ThreadPool* threadPool = nullptr);
+
+    bool IsVisible(size_t occludee) const {
+        return visible[occludee] != 0;
+    }
+
+    const Stats& GetStats() const {
+        return stats;
+    }
+
+    // Depth of the last frame's occluders, row by row from the bottom, 1 where
+    // there are none.
+    const std::vector<float>& GetDepthBuffer() const {
+        return hiZ[0];
+    }
+
+private:
+    static const int kTilesX = kWidth / kTileWidth, kTilesY = kHeight / kTileHeight;
+    static const int kNumLevels = 8;
+
+    struct Occluder {
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        TransformSystem::Handle transform;
+    };
+
+    struct Occludee {
+        glm::vec3 lower, upper;
+        TransformSystem::Handle transform;
+    };
+
+    // Screen space vertices, with depth in 0..1
+    struct Triangle {
+        std::array<glm::vec3, 3> vertices;
+        glm::ivec2 lower, upper;
+    };
+
+    void Rasterize(const TransformSystem::View& view, ThreadPool* threadPool);
+    // Projects a triangle that is in front of the near plane, then bins it
+    // unless it faces away or is off screen
+    void AddTriangle(const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2);
+    void RasterizeTile(int tile);
+    void BuildHiZ();
+    bool TestOccludee(const Occludee& occludee, const TransformSystem::View& view, bool& outside) const;
+
+    std::vector<Occluder> occluders;
+    std::vector<Occludee> occludees;
+    std::vector<uint8_t> visible;
+
+    std::vector<Triangle> triangles;
+    std::array<std::vector<uint32_t>, kTilesX * kTilesY> bins;
+    std::array<std::vector<float>, kNumLevels> hiZ;
+
+    Stats stats;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <filesystem>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FrameGraph.hpp"
+
+class GpuTimer;
+class Shader;
+
+// Runs a configurable list of full screen effects between the scene's colour
+// buffer and the screen. Each pass is added to a frame graph with a transient
+// target of its own, and the graph ping-pongs them by aliasing.
+//
+// Runs of consecutive per-pixel effects are fused into one generated shader,
+// so they cost a single pass however many of them are enabled.
+class PostProcessStack {
+public:
+    enum EffectKind {
+        // A snippet defining <function>Warp(vec2 uv) to move where the pixel
+        // is read from and/or <function>Colour(vec3 colour, vec2 uv) to change it
+        PerPixel,
+        // Two pass Gaussian, optionally at half resolution
+        SeparableBlur,
+        // A complete fragment shader that gets a pass of its own
+        FullScreen
+    };
+
+    struct Parameter {
+        std::string uniform;
+        float value;
+        float min, max;
+    };
+
+    struct Effect {
+        std::string name;
+        EffectKind kind = PerPixel;
+        std::filesystem::path file;
+        std::string function;
+        bool hasWarp = false;
+        bool hasColour = false;
+        // Reads time, so it changes every frame even when nothing else does
+        bool animated = false;
+        std::vector<Parameter> parameters;
+
+        bool enabled = true;
+        bool halfResolution = true;
+        float blurRadius = 4.f; // in full resolution pixels
+    };
+
+    // Smoothed GPU time of each pass that ran last frame, in order.
+    struct Timing {
+        std::string label;
+        float milliseconds;
+    };
+
+    explicit PostProcessStack(GLuint quadVao);
+    virtual ~PostProcessStack();
+
+    PostProcessStack(const PostProcessStack&) = delete;
+    PostProcessStack& operator=(const PostProcessStack&) = delete;
+
+    void AddEffect(const Effect& effect);
+
+    // Call Invalidate after changing which effects are enabled, their order
+    // or their resolution. Parameters can be changed freely.
+    std::vector<Effect>& GetEffects() {
+        return effects;
+    }
+
+    void Invalidate() {
+        dirty = true;
+    }
+
+    bool HasEnabledEffects() const;
+
+    // Adds passes drawing input through every enabled effect into output,
+    // which must be size pixels like input. With nothing enabled input is
+    // simply copied.
+    void AddPasses(FrameGraph& graph, FrameGraph::Resource input, FrameGraph::Resource output, const glm::uvec2& size, float time);
+
+    std::vector<Timing> GetTimings() const;
+
+private:
+    struct Pass {
+        Shader* shader = nullptr;
+        bool halfResolution = false;
+        std::vector<const Effect*> effects;
+
+        // Only for blur passes
+        glm::vec2 tapDirection = glm::vec2(0.f);
+        const Effect* blur = nullptr;
+    };
+
+    // One or more passes timed together, eg. both directions of a blur.
+    struct Stage {
+        std::string label;
+        std::vector<Pass> passes;
+        GpuTimer* timer = nullptr;
+    };
+
+    void Build();
+    Shader* GetFusedShader(const std::vector<const Effect*>& group);
+    Shader* GetFileShader(const std::filesystem::path& fragmentShader);
+    GpuTimer* GetTimer(const std::string& label);
+    void Draw(const Pass& pass, const glm::uvec2& size, float time) const;
+
+    GLuint quadVao;
+
+    std::vector<Effect> effects;
+    std::vector<Stage> stages;
+    bool dirty = true;
+
+    // Generated shaders are kept, so toggling effects back and forth doesn't recompile
+    std::map<std::string, std::unique_ptr<Shader>> shaders;
+    std::map<std::string, std::unique_ptr<GpuTimer>> timers;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <functional>
+
+class Graphics;
+
+// Decides once per frame whether to draw one, for redrawing on demand: after
+// input, for a few frames while the GUI settles, and whenever Graphics wants
+// a redraw. Otherwise it waits, and input or a timeout ends the wait so that
+// redraws requested from other threads are picked up too.
+class RedrawScheduler {
+public:
+    // ImGui's hover and active states lag input by a frame or two
+    static const int kSettleFrames = 3;
+    // How long an idle wait lasts before checking for redraw requests from other threads
+    static constexpr double kIdleTimeoutSeconds = 0.25;
+
+    // Handles pending input, first waiting for some for up to the given
+    // number of seconds unless that is 0
+    typedef std::function<void(double)> ProcessEvents;
+
+    void SetOnDemand(bool enabled);
+
+    bool IsOnDemand() const {
+        return onDemand;
+    }
+
+    // The next kSettleFrames frames are drawn
+    void OnInput() {
+        pendingFrames = kSettleFrames;
+    }
+
+    // Processes events and returns whether to draw a frame. When on demand
+    // and nothing needs one, waits for events once, then asks again.
+    bool ShouldDraw(Graphics& graphics, const ProcessEvents& processEvents);
+
+    unsigned long long GetNumDrawnFrames() const {
+        return numDrawnFrames;
+    }
+
+    unsigned long long GetNumIdleWakeups() const {
+        return numIdleWakeups;
+    }
+
+    double GetIdleSeconds() const {
+        return idleWallSeconds;
+    }
+
+    // Process CPU time over wall time spent waiting
+    double GetIdleCpuFraction() const {
+        return idleWallSeconds > 0. ? idleCpuSeconds / idleWallSeconds : 0.;
+    }
+
+private:
+    bool onDemand = false;
+    // Frames still to draw after the last input
+    int pendingFrames = kSettleFrames;
+
+    unsigned long long numDrawnFrames = 0, numIdleWakeups = 0;
+    double idleCpuSeconds = 0., idleWallSeconds = 0.;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "Drawable.hpp"
+#include "TransformSystem.hpp"
+
+class ThreadPool;
+
+// Every object in the scene is a node with a transform relative to its parent.
+// Nodes are stored as structure of arrays sorted by depth, so parents always
+// come before their children and the world matrices can be worked out in one
+// pass, each level of the hierarchy split across threads. Only subtrees under
+// a node that moved are recomputed.
+//
+// The world matrices end up in the TransformSystem the scene owns, where a
+// node's handle is also its transform handle. Drawables are referenced by
+// handle and placed at nodes, which gives the renderables to draw.
+class Scene {
+public:
+    typedef TransformSystem::Handle NodeHandle;
+    typedef uint32_t DrawableHandle;
+
+    static constexpr NodeHandle kNoParent = UINT32_MAX;
+
+    NodeHandle Add(NodeHandle parent = kNoParent, const glm::mat4& local = glm::mat4(1.f));
+
+    // Keeps the local transform, so the node moves with its new parent.
+    // Throws if the node would become its own ancestor.
+    void SetParent(NodeHandle node, NodeHandle parent);
+
+    void SetLocal(NodeHandle node, const glm::mat4& local);
+
+    NodeHandle GetParent(NodeHandle node) const;
+
+    const glm::mat4& GetLocal(NodeHandle node) const {
+        return locals[indices[node]];
+    }
+
+    // As of the last Update
+    const glm::mat4& GetWorld(NodeHandle node) const {
+        return worlds[indices[node]];
+    }
+
+    size_t GetNodeCount() const {
+        return handles.size();
+    }
+
+    DrawableHandle AddDrawable(std::shared_ptr<Drawable> drawable);
+
+    const Drawable& GetDrawable(DrawableHandle drawable) const {
+        return *drawables[drawable];
+    }
+
+    // Draws the drawable with the node's world transform. Returns the index of
+    // the new renderable in GetRenderables.
+    size_t Place(DrawableHandle drawable, NodeHandle node);
+
+    const std::vector<Renderable>& GetRenderables() const {
+        return renderables;
+    }
+
+    // Recomputes the world matrices of every node whose local transform, or
+    // whose ancestor's, changed since the last call, then updates the
+    // transforms. Call once per frame, after the scene has been updated.
+    void Update(ThreadPool* threadPool = nullptr);
+
+    const TransformSystem& GetTransforms() const {
+        return transforms;
+    }
+
+private:
+    static const size_t kNodesPerChunk = 1024;
+
+    void MarkDirty(size_t index);
+    void Sort();
+    void UpdateRange(size_t begin, size_t end);
+
+    // Node handle to where the node is in the arrays below
+    std::vector<uint32_t> indices;
+
+    // Sorted by depth, levels[d] being the index of the first node d deep and
+    // levels.back() the number of nodes. Only sorted once Update is called.
+    std::vector<NodeHandle> handles;
+    std::vector<uint32_t> parents;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty;
+    std::vector<size_t> levels;
+    bool sorted = true;
+    // Nodes before this one aren't dirty
+    size_t firstDirty = 0;
+    size_t numDirty = 0;
+
+    TransformSystem transforms;
+
+    std::vector<std::shared_ptr<Drawable>> drawables;
+    std::vector<Renderable> renderables;
+};
@@ -27,6 +27,8 @@ public:
     }
 
     void AttachShader(const std::filesystem::path& path);
+    // For generated shaders. type is GL_VERTEX_SHADER or GL_FRAGMENT_SHADER.
+    void AttachShaderSource(GLenum type, const std::string& source);
     void Link();
     void Activate();
     void SetupVertexAttribs(const VertexAttribInfoList& vertexAttribs);
@@ -37,8 +39,19 @@ public:
         return program;
     }
 
+    // Program used in place of this one by the multi-draw indirect path. It
+    // gets the same uniforms and textures as this shader from then on.
+    void SetIndirectVariant(std::shared_ptr<Shader> variant) {
+        indirectVariant = variant;
+    }
+
+    Shader* GetIndirectVariant() const {
+        return indirectVariant.get();
+    }
+
     void SetUniform(const std::string& name, int value);
     void SetUniform(const std::string& name, float value);
+    void SetUniform(const std::string& name, const glm::vec2& value);
     void SetUniform(const std::string& name, const glm::vec3& value);
     void SetUniform(const std::string& name, const glm::vec4& value);
     void SetUniform(const std::string& name, const glm::mat4& value);
@@ -51,11 +64,14 @@ private:
     static void ReadShaderFile(GLuint shader, GLsizei count, const std::filesystem::path& path);
     static void CompileShader(GLuint shader);
     void FindUniforms();
+    void BindUniformBlocks();
 
     std::map<std::string, GLint> uniforms;
 
     std::vector <std::shared_ptr<Texture2D>> textures;
 
+    std::shared_ptr<Shader> indirectVariant;
+
     GLuint program;
 
     static GLuint activeProgram;
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Drawable.hpp"
+#include "TransformSystem.hpp"
+
+// Decides when a shadow map has to be rendered again. It only depends on the
+// light's view-projection and the transforms of the shadow casters, so as long
+// as none of those change the previous frame's map is still valid.
+class ShadowMapCache {
+public:
+    // Call once per frame before drawing the shadow map, skip drawing it when
+    // this returns false.
+    bool NeedsUpdate(
+        const glm::mat4& lightSpaceMatrix,
+        const TransformSystem& transforms,
+        const std::vector<Renderable>& casters
+    );
+
+    // Forces the next NeedsUpdate to return true, for changes the cache can't
+    // see such as the shadow map being recreated.
+    void Invalidate() {
+        valid = false;
+    }
+
+    // Lights that keep moving would otherwise re-render every frame. With an
+    // interval of N, changes are picked up at most once every N frames.
+    void SetUpdateInterval(unsigned int frames) {
+        updateInterval = frames < 1 ? 1 : frames;
+    }
+
+    unsigned int GetUpdateInterval() const {
+        return updateInterval;
+    }
+
+    unsigned int GetNumUpdates() const {
+        return numUpdates;
+    }
+
+    unsigned int GetNumSkipped() const {
+        return numSkipped;
+    }
+
+private:
+    bool valid = false;
+    bool dirty = true;
+
+    glm::mat4 lightSpaceMatrix = glm::mat4(1.f);
+    std::vector<TransformSystem::Handle> casterTransforms;
+    std::vector<uint32_t> casterVersions;
+
+    unsigned int updateInterval = 1;
+    unsigned int framesSinceUpdate = 0;
+
+    unsigned int numUpdates = 0;
+    unsigned int numSkipped = 0;
+};
@@ -78,6 +78,14 @@ public:
         }
     }
 
+    // For 2D textures not owned by a Texture2D, keeping Bind's cache in step.
+    static void BindTexture(GLuint texture) {
+        if (boundTexture != texture) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            boundTexture = texture;
+        }
+    }
+
 
 private:
     GLenum target;
@@ -111,7 +119,7 @@ private:
                 break;
             case RGBA:
                 if (colorSpace == LinearSpace) {
-                    return GL_RGBA;
+                    return type == Float ? GL_RGBA32F : GL_RGBA;
                 }
                 else if (colorSpace == sRGB) {
                     return GL_SRGB_ALPHA;
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for fork-join style data parallel work. The
+// calling thread always takes part, so a pool with zero workers just runs
+// everything inline.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int numWorkers = DefaultNumWorkers());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads that work on a ParallelFor, including the caller.
+    unsigned int GetNumThreads() const {
+        return (unsigned int)workers.size() + 1;
+    }
+
+    // Splits [0, count) into ranges of at most chunkSize and calls fn(begin, end)
+    // for each of them. Blocks until every range has been processed.
+    void ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& fn);
+
+    static unsigned int DefaultNumWorkers();
+
+private:
+    void WorkerLoop();
+    void RunChunks();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeWorkers, jobDone;
+    bool quit = false;
+    unsigned int generation = 0;
+    unsigned int busyWorkers = 0;
+
+    // current job
+    const std::function<void(size_t, size_t)>* job = nullptr;
+    size_t jobCount = 0, jobChunkSize = 0;
+    std::atomic<size_t> nextChunk = 0;
+};
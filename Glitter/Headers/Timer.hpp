@@ -1,15 +1,48 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
 
+// Keeps time for the frame loop, and statistics on how long frames take:
+// exact percentiles over the last kHistorySize frames, and a histogram of
+// every frame since Start that gives estimates for the whole run. Frames
+// longer than the budget count as stutters.
 class Timer {
 public:
+    static const size_t kHistorySize = 512;
+    // Log spaced, so long hitches are told apart as well as short frames: the
+    // first bin holds everything under kFirstBinMilliseconds, each bin after
+    // is about 11% wider than the one before, and the last holds everything
+    // from kLastBinMilliseconds up.
+    static const size_t kNumBins = 100;
+    static constexpr float kFirstBinMilliseconds = 0.25f;
+    static constexpr float kLastBinMilliseconds = 10000.f;
+
+    struct Stats {
+        unsigned int numFrames = 0;
+        float meanMilliseconds = 0.f;
+        float p50Milliseconds = 0.f;
+        float p95Milliseconds = 0.f;
+        float p99Milliseconds = 0.f;
+        float maxMilliseconds = 0.f;
+    };
+
     void Start() {
         startTime = lastFrameTime = now = std::chrono::steady_clock::now();
     }
-    void Update() {
-        lastFrameTime = now;
-        now = std::chrono::steady_clock::now();
+    void Update();
+
+    // After waiting rather than drawing, eg. redrawing on demand: restarts the
+    // interval, and the next Update measures nothing, so only frames drawn
+    // back to back are counted. Does nothing with a fixed step.
+    void Resume();
+
+    // Each Update then advances time by exactly this much instead of reading
+    // the clock, for reproducible runs. 0 goes back to real time.
+    void SetFixedStep(float seconds) {
+        fixedStep = seconds;
     }
 
     float GetTime() {
@@ -19,7 +52,47 @@ public:
         return std::chrono::duration<float>(now - lastFrameTime).count();
     }
 
+    void SetBudget(float milliseconds) {
+        budgetMilliseconds = milliseconds;
+    }
+    float GetBudget() const {
+        return budgetMilliseconds;
+    }
+
+    // Over the last kHistorySize frames
+    Stats GetRecentStats() const;
+    // Since Start, percentiles estimated from the histogram
+    Stats GetRunStats() const;
+
+    unsigned int GetNumStutters() const {
+        return numStutters;
+    }
+
+    // Frames per bin since Start
+    const std::array<uint64_t, kNumBins>& GetHistogram() const {
+        return histogram;
+    }
+
+    // Where bin starts, the end being where the next one starts
+    static float GetBinStart(size_t bin);
+    static size_t GetBin(float milliseconds);
+
+    void PrintSummary(FILE* file) const;
+
 private:
     std::chrono::steady_clock::time_point startTime, lastFrameTime, now;
 
+    float fixedStep = 0.f;
+    bool resumed = false;
+    float budgetMilliseconds = 1000.f / 60.f;
+
+    // Ring buffer once full
+    std::array<float, kHistorySize> history = {};
+    size_t numHistory = 0, nextHistory = 0;
+
+    std::array<uint64_t, kNumBins> histogram = {};
+    uint64_t numFrames = 0;
+    double totalMilliseconds = 0.;
+    float maxMilliseconds = 0.f;
+    unsigned int numStutters = 0;
 };
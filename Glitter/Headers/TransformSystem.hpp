@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+class ThreadPool;
+
+// Owns the model matrices of everything in the scene, stored as structure of
+// arrays so that the matrix products needed for drawing can be done for all
+// objects at once, four at a time, instead of one by one inside each draw call.
+class TransformSystem {
+public:
+    typedef uint32_t Handle;
+
+    // Per-view results, indexed by transform handle.
+    struct View {
+        glm::mat4 view = glm::mat4(1.f);
+        glm::mat4 projection = glm::mat4(1.f);
+        glm::mat4 viewProjection = glm::mat4(1.f);
+        glm::vec3 worldSpaceCameraPos = glm::vec3(0.f);
+        std::vector<glm::mat4> modelViewProjection;
+    };
+
+    Handle Add(const glm::mat4& model = glm::mat4(1.f));
+    void SetModel(Handle handle, const glm::mat4& model);
+
+    size_t GetCount() const {
+        return count;
+    }
+
+    const glm::mat4& GetModel(Handle handle) const {
+        return models[handle];
+    }
+
+    const glm::mat3& GetModelInverseTranspose(Handle handle) const {
+        return modelInverseTransposes[handle];
+    }
+
+    // Changes every time SetModel is given a different matrix, so callers
+    // caching anything derived from a transform can tell when it's stale.
+    uint32_t GetVersion(Handle handle) const {
+        return versions[handle];
+    }
+
+    // Recomputes the normal matrices of every transform that changed since the
+    // last call. Call once per frame, after the scene has been updated.
+    void Update(ThreadPool* threadPool = nullptr);
+
+    // Fills in the model-view-projection matrices of every transform for one view.
+    void ComputeView(
+        View& out,
+        const glm::mat4& view,
+        const glm::mat4& projection,
+        ThreadPool* threadPool = nullptr
+    ) const;
+
+private:
+    static const size_t kLanes = 4;
+    static const size_t kBlocksPerChunk = 64;
+
+    size_t GetNumBlocks() const {
+        return (count + kLanes - 1) / kLanes;
+    }
+
+    void UpdateBlock(size_t block);
+
+    size_t count = 0;
+
+    // Model matrix elements, soa[column * 4 + row][handle]. Padded with identity
+    // matrices up to a whole number of blocks.
+    std::array<std::vector<float>, 16> soa;
+    std::vector<uint8_t> dirtyBlocks;
+    std::vector<uint32_t> versions;
+
+    // Array of structures copies for uploading to uniforms, also padded.
+    std::vector<glm::mat4> models;
+    std::vector<glm::mat3> modelInverseTransposes;
+};
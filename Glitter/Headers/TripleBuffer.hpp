@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from one producer thread to one consumer thread
+// without locks. Each side owns one of three slots and the third sits in
+// between; publishing and acquiring swap a side's slot with the middle one in
+// a single atomic exchange, so neither ever waits on the other to copy.
+//
+// A value published before the last one was acquired replaces it.
+template<typename T>
+class TripleBuffer {
+public:
+    // Producer side. The slot returned stays the same until Publish.
+    T& GetWrite() {
+        return slots[write];
+    }
+
+    void Publish() {
+        write = Swap(write | kFresh);
+        middle.notify_all();
+    }
+
+    // Blocks until the value published last has been acquired, or Close.
+    void WaitUntilAcquired() {
+        auto state = middle.load();
+        while ((state & kFresh) != 0 && (state & kClosed) == 0) {
+            middle.wait(state);
+            state = middle.load();
+        }
+    }
+
+    // Consumer side. Makes the latest published value readable, returns false
+    // if nothing was published since the last call.
+    bool Acquire() {
+        if ((middle.load() & kFresh) == 0) {
+            return false;
+        }
+        read = Swap(read);
+        middle.notify_all();
+        return true;
+    }
+
+    // Blocks until there is something to acquire. Returns false once closed.
+    bool WaitForPublish() {
+        auto state = middle.load();
+        while ((state & kFresh) == 0) {
+            if ((state & kClosed) != 0) {
+                return false;
+            }
+            middle.wait(state);
+            state = middle.load();
+        }
+        return true;
+    }
+
+    // The slot returned stays the same until Acquire.
+    T& GetRead() {
+        return slots[read];
+    }
+
+    // Wakes both sides for good, eg. to shut a consumer thread down.
+    void Close() {
+        middle.fetch_or(kClosed);
+        middle.notify_all();
+    }
+
+private:
+    static const uint8_t kIndexMask = 3;
+    static const uint8_t kFresh = 4;
+    static const uint8_t kClosed = 8;
+
+    // Puts slot in the middle and returns the index that was there, keeping
+    // the closed flag.
+    uint8_t Swap(uint8_t slot) {
+        auto state = middle.load();
+        while (!middle.compare_exchange_weak(state, (uint8_t)(slot | (state & kClosed)))) {
+        }
+        return state & kIndexMask;
+    }
+
+    std::array<T, 3> slots;
+    uint8_t write = 0, read = 2;
+    std::atomic<uint8_t> middle = 1;
+};
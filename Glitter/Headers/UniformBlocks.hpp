@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Binding points of the uniform blocks shared between shaders. Shader::Link
+// assigns these to any block it finds with a matching name.
+enum UniformBlockBinding : GLuint {
+    PerDrawBlockBinding = 0,
+    PerViewBlockBinding = 1,
+};
+
+// std140 layout of the PerDraw block in drawing.vert and depth.vert.
+struct PerDrawUniforms {
+    glm::mat4 model;
+    glm::mat4 modelViewProjection;
+    glm::vec4 modelInverseTranspose[3]; // std140 pads mat3 columns to vec4
+};
+
+// std140 layout of the PerView block in the lit fragment shaders.
+struct PerViewUniforms {
+    glm::vec4 worldSpaceCameraPos;
+};
+
+// Binding points of the shader storage blocks used by the multi-draw indirect
+// shaders. These are set with layout qualifiers in the shaders themselves.
+enum StorageBlockBinding : GLuint {
+    PerDrawStorageBinding = 0,
+};
@@ -14,6 +14,13 @@ public:
         return sizeof(float) * vertices.size() * componentsPerVertex;
     }
 
+    const void* GetPositionData() const {
+        return positions.data();
+    }
+    size_t GetPositionDataSize() const {
+        return sizeof(float) * positions.size() * 3;
+    }
+
     const void* GetIndices() const {
         return indices.data();
     }
@@ -29,7 +36,11 @@ protected:
     static const size_t componentsPerVertex = 14;
     static const VertexAttribInfoList VertexAttribs;
 
+    // Fills positions from vertices, call once vertices are final.
+    void CopyPositions();
+
     std::vector<std::array<float, componentsPerVertex>> vertices;
+    std::vector<std::array<float, 3>> positions;
     std::vector<unsigned int> indices;
 
 };
@@ -2,16 +2,28 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <memory>
+#include <thread>
 
+#include "FramePacer.hpp"
 #include "Graphics.hpp"
+#include "ImGuiFrame.hpp"
+#include "RedrawScheduler.hpp"
+#include "TripleBuffer.hpp"
 
 class Window
 {
 public:
-    Window(std::shared_ptr<Graphics> graphics, int width, int height, const char* title);
+    // Threaded windows handle input, update the scene and build the GUI on
+    // the calling thread while a render thread of their own draws the
+    // previous frame. Otherwise everything happens in turn on one thread.
+    Window(std::shared_ptr<Graphics> graphics, int width, int height, const char* title, bool threaded = true);
     
     void LoopUntilDone();
 
+    // Only draws when input arrives or the scene wants a new frame, and
+    // sleeps in between instead of drawing the same frame over and over.
+    void SetRedrawOnDemand(bool enabled);
+
     glm::ivec2 GetFramebufferSize() const;
     glm::dvec2 GetCursorPosition() const;
     
@@ -19,9 +31,47 @@ private:
     static void OnResize(GLFWwindow* window, int width, int height);
     static void OnCursorMoved(GLFWwindow* window, double xpos, double ypos);
     static void OnMouseButton(GLFWwindow* window, int button, int action, int mods);
+    static void OnInput();
+
+    enum SwapMode {
+        VsyncOff,
+        VsyncOn,
+        // Swaps late frames immediately instead of waiting a whole refresh
+        VsyncAdaptive
+    };
+
+    // What the update thread hands the render thread every frame
+    struct Snapshot {
+        Graphics::Frame frame;
+        ImGuiFrame gui;
+        FramePacer::Clock::time_point inputTime;
+        SwapMode swapMode = VsyncOn;
+    };
 
+    static void ApplySwapMode(SwapMode mode);
+    // Returns whether to draw a frame
+    static bool PollEvents();
+
+    // Single threaded
     static void Draw();
+    static void RenderFrame();
+
+    // Threaded
+    static void Update();
+    static void RenderLoop(SwapMode appliedSwapMode);
+
+    static void DrawPacingGUI();
 
     static GLFWwindow* window;
     static std::shared_ptr<Graphics> graphics;
+
+    static bool threaded;
+    static TripleBuffer<Snapshot> snapshots;
+    static std::thread renderThread;
+
+    static FramePacer pacer;
+    static SwapMode swapMode;
+    static bool adaptiveSupported;
+
+    static RedrawScheduler redraw;
 };
@@ -0,0 +1,12 @@
+// Per-pixel effect, fused into a generated shader by PostProcessStack
+
+uniform float gradeExposure = 1.0;
+uniform float gradeContrast = 1.0;
+uniform float gradeSaturation = 1.0;
+
+vec3 ColourGradeColour(vec3 colour, vec2 uv) {
+    colour *= gradeExposure;
+    colour = (colour - 0.5) * gradeContrast + 0.5;
+    float luminance = dot(colour, vec3(0.2126, 0.7152, 0.0722));
+    return max(mix(vec3(luminance), colour, gradeSaturation), 0.0);
+}
@@ -0,0 +1,19 @@
+#version 430 core
+
+layout (location = 0) in vec3 position;
+layout (location = 5) in uint drawId;
+
+struct PerDraw {
+    mat4 model;
+    mat4 modelViewProjection;
+    mat3 modelInverseTranspose;
+};
+
+layout (std430, binding = 0) readonly buffer PerDrawBuffer {
+    PerDraw draws[];
+};
+
+void main()
+{
+    gl_Position = draws[drawId].modelViewProjection * vec4(position, 1.0);
+}
@@ -2,7 +2,11 @@
 
 layout (location = 0) in vec3 position;
 
-uniform mat4 modelViewProjection;
+layout (std140) uniform PerDraw {
+    mat4 model;
+    mat4 modelViewProjection;
+    mat3 modelInverseTranspose;
+};
 
 void main()
 {
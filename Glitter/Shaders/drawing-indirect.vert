@@ -0,0 +1,48 @@
+#version 430 core
+
+// Same as drawing.vert, but for the multi-draw indirect path, where per-draw
+// uniforms come from a storage buffer
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec3 tangent;
+layout (location = 3) in vec3 bitangent;
+layout (location = 4) in vec2 texcoord;
+layout (location = 5) in uint drawId;
+
+out VS_OUT {
+    vec3 FragPos;
+    vec2 Texcoord;
+    mat3 TBN;
+    vec4 FragPosLightSpace;
+} vs_out;
+
+struct PerDraw {
+    mat4 model;
+    mat4 modelViewProjection;
+    mat3 modelInverseTranspose;
+};
+
+layout (std430, binding = 0) readonly buffer PerDrawBuffer {
+    PerDraw draws[];
+};
+
+uniform mat4 lightSpaceMatrix;
+
+void main()
+{
+    PerDraw draw = draws[drawId];
+
+    vs_out.FragPos = (draw.model * vec4(position, 1.0)).xyz;
+
+    vs_out.Texcoord = texcoord;
+
+    vec3 T = normalize(draw.modelInverseTranspose * tangent);
+    vec3 B = normalize(draw.modelInverseTranspose * bitangent);
+    vec3 N = normalize(draw.modelInverseTranspose * normal);
+    vs_out.TBN = mat3(T, B, N);
+
+    vs_out.FragPosLightSpace = lightSpaceMatrix * vec4(vs_out.FragPos, 1.0); 
+
+    gl_Position = draw.modelViewProjection * vec4(position, 1.0);
+}
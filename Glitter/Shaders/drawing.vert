@@ -13,9 +13,12 @@ out VS_OUT {
     vec4 FragPosLightSpace;
 } vs_out;
 
-uniform mat4 model;
-uniform mat4 modelViewProjection;
-uniform mat3 modelInverseTranspose;
+layout (std140) uniform PerDraw {
+    mat4 model;
+    mat4 modelViewProjection;
+    mat3 modelInverseTranspose;
+};
+
 uniform mat4 lightSpaceMatrix;
 
 void main()
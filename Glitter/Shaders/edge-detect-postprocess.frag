@@ -9,14 +9,13 @@ in VS_OUT {
 uniform sampler2D screenTexture;
 uniform float time;
 
-const float offset = 1.0 / 400.0;
-
 void main() {
+    vec2 offset = 1.0 / vec2(textureSize(screenTexture, 0));
     const int samples = 9;
     vec2 offsets[samples] = vec2[](
-        vec2(-offset, offset), vec2(0.0f, offset), vec2(offset, offset),
-        vec2(-offset, 0.0f), vec2(0.0f, 0.0f), vec2(offset, 0.0f),
-        vec2(-offset, -offset), vec2(0.0f, -offset), vec2(offset, -offset)
+        vec2(-offset.x, offset.y), vec2(0.0f, offset.y), vec2(offset.x, offset.y),
+        vec2(-offset.x, 0.0f), vec2(0.0f, 0.0f), vec2(offset.x, 0.0f),
+        vec2(-offset.x, -offset.y), vec2(0.0f, -offset.y), vec2(offset.x, -offset.y)
     );
 
     float kernel[samples] = float[](
@@ -0,0 +1,13 @@
+#version 330 core
+
+// Exponential variance shadow map moments, see textured.frag for the lookup
+const vec2 evsmExponents = vec2(40.0, 5.0);
+
+out vec4 outMoments;
+
+void main() {
+    float depth = gl_FragCoord.z * 2.0 - 1.0;
+    float positive = exp(evsmExponents.x * depth);
+    float negative = -exp(-evsmExponents.y * depth);
+    outMoments = vec4(positive, positive * positive, negative, negative * negative);
+}
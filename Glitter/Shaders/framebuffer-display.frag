@@ -9,7 +9,29 @@ in VS_OUT {
 uniform sampler2D screenTexture;
 uniform float time;
 
+// Part of screenTexture that was rendered to, when upscaling a scene drawn
+// at reduced resolution
+uniform vec2 uvScale = vec2(1.0);
+// 0 for plain bilinear filtering
+uniform float sharpness = 0.0;
+
 void main() {
-    vec4 debugColor = vec4(fs_in.TexCoords.x, fs_in.TexCoords.y, 1, 1);
-    FragColor = mix(texture(screenTexture, fs_in.TexCoords), debugColor, 0);
+    vec2 texel = 1.0 / vec2(textureSize(screenTexture, 0));
+    // Don't let bilinear filtering pull in texels outside the rendered region
+    vec2 uv = min(fs_in.TexCoords * uvScale, uvScale - 0.5 * texel);
+
+    vec3 colour = texture(screenTexture, uv).rgb;
+    if (sharpness > 0.0) {
+        // Unsharp mask over the cross of source texels, clamped to their range
+        // so edges don't ring
+        vec3 left = texture(screenTexture, uv - vec2(texel.x, 0.0)).rgb;
+        vec3 right = texture(screenTexture, min(uv + vec2(texel.x, 0.0), uvScale - 0.5 * texel)).rgb;
+        vec3 down = texture(screenTexture, uv - vec2(0.0, texel.y)).rgb;
+        vec3 up = texture(screenTexture, min(uv + vec2(0.0, texel.y), uvScale - 0.5 * texel)).rgb;
+        vec3 lowest = min(colour, min(min(left, right), min(down, up)));
+        vec3 highest = max(colour, max(max(left, right), max(down, up)));
+        vec3 sharpened = colour + sharpness * (4.0 * colour - left - right - down - up);
+        colour = clamp(sharpened, lowest, highest);
+    }
+    FragColor = vec4(colour, 1.0);
 }
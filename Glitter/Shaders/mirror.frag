@@ -13,7 +13,9 @@ in VS_OUT {
 
 out vec4 FragColor;
 
-uniform vec3 worldSpaceCameraPos;
+layout (std140) uniform PerView {
+    vec3 worldSpaceCameraPos;
+};
 uniform samplerCube cubemap;
 
 uniform Material material;
@@ -0,0 +1,34 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in VS_OUT {
+    vec2 TexCoords;
+} fs_in;
+
+uniform sampler2D screenTexture;
+
+// One direction of a separable Gaussian, numTaps either side of the centre,
+// tapStep apart in texture coordinates
+uniform vec2 tapStep;
+uniform int numTaps = 1;
+uniform float sigma = 1.0;
+
+const int maxTaps = 16;
+
+void main() {
+    vec4 sum = texture(screenTexture, fs_in.TexCoords);
+    float totalWeight = 1.0;
+    for (int i = 1; i <= maxTaps; ++i) {
+        if (i > numTaps) {
+            break;
+        }
+        float weight = exp(-float(i * i) / (2.0 * sigma * sigma));
+        sum += weight * (
+            texture(screenTexture, fs_in.TexCoords + tapStep * float(i)) +
+            texture(screenTexture, fs_in.TexCoords - tapStep * float(i))
+        );
+        totalWeight += 2.0 * weight;
+    }
+    FragColor = sum / totalWeight;
+}
@@ -35,8 +35,60 @@ out vec4 outColor;
 uniform Material material;
 uniform Light light;
 
-uniform vec3 worldSpaceCameraPos;
+layout (std140) uniform PerView {
+    vec3 worldSpaceCameraPos;
+};
 
+// Lights without shadows, listed per cluster of the view frustum by
+// LightClusters. Each light is three texels: position and range, colour and
+// outer cone cosine, direction and inner cone cosine.
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform samplerBuffer clusterLights;
+uniform vec3 clusterDims;
+uniform vec2 clusterScreenSize;
+uniform vec2 clusterDepthRange;
+uniform float clusterSliceScale;
+
+vec3 ClusteredLighting(vec3 normal, vec3 viewDirection, vec3 diffuseColour, vec3 specularColour, float shininess) {
+    float nearPlane = clusterDepthRange.x;
+    float farPlane = clusterDepthRange.y;
+    float viewDepth = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - (gl_FragCoord.z * 2.0 - 1.0) * (farPlane - nearPlane));
+
+    ivec3 dims = ivec3(clusterDims);
+    vec2 tile = gl_FragCoord.xy / clusterScreenSize * clusterDims.xy;
+    ivec3 cell = clamp(ivec3(int(tile.x), int(tile.y), int(log(viewDepth / nearPlane) * clusterSliceScale)), ivec3(0), dims - 1);
+    uvec2 range = texelFetch(clusterGrid, (cell.z * dims.y + cell.y) * dims.x + cell.x).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i) {
+        int light = int(texelFetch(clusterLightIndices, int(range.x + i)).r) * 3;
+        vec4 positionRange = texelFetch(clusterLights, light);
+        vec4 colourCosOuter = texelFetch(clusterLights, light + 1);
+        vec4 directionCosInner = texelFetch(clusterLights, light + 2);
+
+        vec3 toLight = positionRange.xyz - fs_in.FragPos;
+        float distanceSquared = dot(toLight, toLight);
+        float rangeSquared = positionRange.w * positionRange.w;
+        if (distanceSquared >= rangeSquared) {
+            continue;
+        }
+        vec3 lightDir = toLight * inversesqrt(distanceSquared);
+
+        // Inverse square, windowed so it reaches zero at the range
+        float window = 1.0 - (distanceSquared * distanceSquared) / (rangeSquared * rangeSquared);
+        float attenuation = window * window / (distanceSquared + 1.0);
+        if (colourCosOuter.w > -1.0) {
+            float theta = dot(-lightDir, directionCosInner.xyz);
+            attenuation *= clamp((theta - colourCosOuter.w) / max(directionCosInner.w - colourCosOuter.w, 0.0001), 0.0, 1.0);
+        }
+
+        float diff = max(dot(normal, lightDir), 0.0);
+        float spec = pow(max(dot(viewDirection, reflect(-lightDir, normal)), 0.0), shininess);
+        result += colourCosOuter.rgb * attenuation * (diff * diffuseColour + spec * specularColour);
+    }
+    return result;
+}
 
 void main() {
     vec3 normal = normalize(fs_in.TBN * vec3(0,0,1));
@@ -70,5 +122,6 @@ void main() {
     vec3 result = ambient * attenuation + 
         diffuse * attenuation * intensity + 
         specular * attenuation * intensity;
+    result += ClusteredLighting(normal, viewDirection, material.diffuse, material.specular, material.shininess);
     outColor = vec4(result, 1);
 }
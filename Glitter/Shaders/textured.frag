@@ -38,17 +38,107 @@ uniform Light light;
 uniform sampler2DShadow shadowMap;
 uniform float penumbraSize = 100;
 
-uniform vec3 worldSpaceCameraPos;
+// Blurred moments written by evsm-moments.frag, used instead of shadowMap
+uniform sampler2D shadowMoments;
+uniform bool prefilteredShadows = false;
+
+layout (std140) uniform PerView {
+    vec3 worldSpaceCameraPos;
+};
+
+// Lights without shadows, listed per cluster of the view frustum by
+// LightClusters. Each light is three texels: position and range, colour and
+// outer cone cosine, direction and inner cone cosine.
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform samplerBuffer clusterLights;
+uniform vec3 clusterDims;
+uniform vec2 clusterScreenSize;
+uniform vec2 clusterDepthRange;
+uniform float clusterSliceScale;
+
+vec3 ClusteredLighting(vec3 normal, vec3 viewDirection, vec3 diffuseColour, vec3 specularColour, float shininess) {
+    float nearPlane = clusterDepthRange.x;
+    float farPlane = clusterDepthRange.y;
+    float viewDepth = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - (gl_FragCoord.z * 2.0 - 1.0) * (farPlane - nearPlane));
+
+    ivec3 dims = ivec3(clusterDims);
+    vec2 tile = gl_FragCoord.xy / clusterScreenSize * clusterDims.xy;
+    ivec3 cell = clamp(ivec3(int(tile.x), int(tile.y), int(log(viewDepth / nearPlane) * clusterSliceScale)), ivec3(0), dims - 1);
+    uvec2 range = texelFetch(clusterGrid, (cell.z * dims.y + cell.y) * dims.x + cell.x).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i) {
+        int light = int(texelFetch(clusterLightIndices, int(range.x + i)).r) * 3;
+        vec4 positionRange = texelFetch(clusterLights, light);
+        vec4 colourCosOuter = texelFetch(clusterLights, light + 1);
+        vec4 directionCosInner = texelFetch(clusterLights, light + 2);
+
+        vec3 toLight = positionRange.xyz - fs_in.FragPos;
+        float distanceSquared = dot(toLight, toLight);
+        float rangeSquared = positionRange.w * positionRange.w;
+        if (distanceSquared >= rangeSquared) {
+            continue;
+        }
+        vec3 lightDir = toLight * inversesqrt(distanceSquared);
+
+        // Inverse square, windowed so it reaches zero at the range
+        float window = 1.0 - (distanceSquared * distanceSquared) / (rangeSquared * rangeSquared);
+        float attenuation = window * window / (distanceSquared + 1.0);
+        if (colourCosOuter.w > -1.0) {
+            float theta = dot(-lightDir, directionCosInner.xyz);
+            attenuation *= clamp((theta - colourCosOuter.w) / max(directionCosInner.w - colourCosOuter.w, 0.0001), 0.0, 1.0);
+        }
+
+        float diff = max(dot(normal, lightDir), 0.0);
+        float spec = pow(max(dot(viewDirection, reflect(-lightDir, normal)), 0.0), shininess);
+        result += colourCosOuter.rgb * attenuation * (diff * diffuseColour + spec * specularColour);
+    }
+    return result;
+}
 
 const float minShadowBias = 0.003;
 const float maxShadowBias = 0.03;
 
+const vec2 evsmExponents = vec2(40.0, 5.0);
+const float evsmVarianceBias = 0.0001;
+const float lightBleedReduction = 0.3;
+
+// Upper bound on the fraction of the filter region that is lit
+float Chebyshev(vec2 moments, float depth, float minVariance) {
+    if (depth <= moments.x) {
+        return 1.0;
+    }
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = depth - moments.x;
+    float pMax = variance / (variance + d * d);
+    return clamp((pMax - lightBleedReduction) / (1.0 - lightBleedReduction), 0.0, 1.0);
+}
+
+// A single filtered fetch, however wide the penumbra
+float PrefilteredShadowCalculation(vec3 projCoords) {
+    vec4 moments = texture(shadowMoments, projCoords.xy);
+
+    float depth = projCoords.z * 2.0 - 1.0;
+    vec2 warpedDepth = vec2(exp(evsmExponents.x * depth), -exp(-evsmExponents.y * depth));
+    vec2 depthScale = evsmVarianceBias * evsmExponents * warpedDepth;
+    vec2 minVariance = depthScale * depthScale;
+
+    float positive = Chebyshev(moments.xy, warpedDepth.x, minVariance.x);
+    float negative = Chebyshev(moments.zw, warpedDepth.y, minVariance.y);
+    return 1.0 - min(positive, negative);
+}
+
 float ShadowCalculation(vec4 fragPosLightSpace, float normalToLightAngle) {
     // perform perspective divide
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     // transform NDC (-1..1) coords to 0..1
     projCoords = projCoords * 0.5 + 0.5;
 
+    if (prefilteredShadows) {
+        return PrefilteredShadowCalculation(projCoords);
+    }
+
     float bias = max(maxShadowBias * (1.0 - normalToLightAngle), minShadowBias);
 
     float currentDepth = projCoords.z;
@@ -89,18 +179,21 @@ void main() {
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0, 1);
 
+    vec3 diffuseColour = texture(material.diffuse, fs_in.Texcoord).rgb;
+    vec3 specularColour = texture(material.specular, fs_in.Texcoord).rgb;
+
     // ambient
-    vec3 ambient = light.ambient * texture(material.diffuse, fs_in.Texcoord).rgb;
+    vec3 ambient = light.ambient * diffuseColour;
 
     // diffuse colour
     float diff = max(dot(normal, lightDir), 0);
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, fs_in.Texcoord).rgb;
+    vec3 diffuse = light.diffuse * diff * diffuseColour;
 
     // specular
     vec3 viewDirection = normalize(worldSpaceCameraPos - fs_in.FragPos);
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDirection, reflectDir), 0), material.shininess);
-    vec3 specular =  light.specular * spec * texture(material.specular, fs_in.Texcoord).rgb;
+    vec3 specular =  light.specular * spec * specularColour;
 
     // Emission
     vec3 emission = texture(material.emission, fs_in.Texcoord).rgb;
@@ -112,5 +205,6 @@ void main() {
         ((1.0 - shadow) *
             (diffuse * attenuation * intensity + specular * attenuation * intensity)
         );// + emission;
+    result += ClusteredLighting(normal, viewDirection, diffuseColour, specularColour, material.shininess);
     outColor = vec4(result, 1);
 }
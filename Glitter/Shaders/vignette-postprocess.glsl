@@ -0,0 +1,8 @@
+// Per-pixel effect, fused into a generated shader by PostProcessStack
+
+uniform float vignetteStrength = 0.5;
+
+vec3 VignetteColour(vec3 colour, vec2 uv) {
+    vec2 fromCentre = uv - 0.5;
+    return colour * (1.0 - vignetteStrength * dot(fromCentre, fromCentre) * 2.0);
+}
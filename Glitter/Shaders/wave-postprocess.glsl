@@ -0,0 +1,9 @@
+// Per-pixel effect, fused into a generated shader by PostProcessStack
+
+uniform float waveAmplitude = 0.01;
+uniform float waveFrequency = 80.0;
+
+vec2 WaveWarp(vec2 uv) {
+    float displacement = sin(uv.x * waveFrequency + time) * waveAmplitude;
+    return vec2(uv.x, uv.y + displacement);
+}
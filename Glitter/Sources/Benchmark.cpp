@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <sstream>
+#include <stdexcept>
+
+#include "Benchmark.hpp"
+
+using namespace glm;
+
+struct FrameRecord {
+    float time = 0.f;
+    float cpuMilliseconds = 0.f;
+    // Negative until the timer result arrives, and for good without timer queries
+    float gpuMilliseconds = -1.f;
+    Graphics::Counters counters;
+};
+
+static void PrintPercentiles(const char* label, std::vector<float> samples) {
+    samples.erase(std::remove_if(samples.begin(), samples.end(), [](float sample) { return sample < 0.f; }), samples.end());
+    if (samples.empty()) {
+        fprintf(stderr, "%s: no results\n", label);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    float sum = 0.f;
+    for (auto sample : samples) {
+        sum += sample;
+    }
+    const auto percentile = [&](float p) {
+        return samples[std::min(static_cast<size_t>(p * samples.size()), samples.size() - 1)];
+    };
+    fprintf(
+        stderr,
+        "%s: mean %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+        label,
+        sum / samples.size(),
+        percentile(0.5f),
+        percentile(0.95f),
+        percentile(0.99f),
+        samples.back()
+    );
+}
+
+std::vector<Benchmark::CameraKey> Benchmark::LoadCameraPath(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not read camera path \"" + path.string() + "\"");
+    }
+
+    std::vector<CameraKey> keys;
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        const auto start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        CameraKey key;
+        if (!(fields >> key.time >> key.yaw >> key.pitch)) {
+            throw std::runtime_error(path.string() + ":" + std::to_string(lineNumber) + ": expected seconds, yaw and pitch");
+        }
+        if (!keys.empty() && key.time < keys.back().time) {
+            throw std::runtime_error(path.string() + ":" + std::to_string(lineNumber) + ": keys must be in time order");
+        }
+        key.yaw = radians(key.yaw);
+        key.pitch = radians(key.pitch);
+        keys.push_back(key);
+    }
+
+    if (keys.empty()) {
+        throw std::runtime_error("No keys in camera path \"" + path.string() + "\"");
+    }
+    return keys;
+}
+
+std::vector<Benchmark::CameraKey> Benchmark::DefaultCameraPath() {
+    return {
+        { 0.f, 0.2f, 0.2f },
+        { 2.5f, 0.2f + radians(90.f), 0.6f },
+        { 5.f, 0.2f + radians(180.f), 0.9f },
+        { 7.5f, 0.2f + radians(270.f), 0.6f },
+        { 10.f, 0.2f + radians(360.f), 0.2f },
+    };
+}
+
+Benchmark::Benchmark(std::shared_ptr<Graphics> graphics, std::vector<CameraKey> cameraPath)
+    : graphics(graphics), cameraPath(std::move(cameraPath)) {
+    if (this->cameraPath.empty()) {
+        throw std::runtime_error("Empty camera path");
+    }
+}
+
+Benchmark::CameraKey Benchmark::Sample(float time) const {
+    if (time <= cameraPath.front().time) {
+        return cameraPath.front();
+    }
+    for (size_t i = 1; i < cameraPath.size(); ++i) {
+        const auto& next = cameraPath[i];
+        if (time < next.time) {
+            const auto& previous = cameraPath[i - 1];
+            const auto t = (time - previous.time) / (next.time - previous.time);
+            return { time, mix(previous.yaw, next.yaw, t), mix(previous.pitch, next.pitch, t) };
+        }
+    }
+    return cameraPath.back();
+}
+
+void Benchmark::Run(int numWarmupFrames, int numFrames, float timeStep, const std::filesystem::path& csvPath) {
+    std::ofstream csv(csvPath);
+    if (!csv) {
+        throw std::runtime_error("Could not write \"" + csvPath.string() + "\"");
+    }
+
+    graphics->SetDeterministic(timeStep);
+
+    // Timer results only arrive when the next frame starts, so they are
+    // matched to frames by counting results, and one extra frame at the end
+    // collects the last
+    std::vector<FrameRecord> frames(numFrames);
+    unsigned int numGpuResults = graphics->GetCounters().numGpuResults;
+    for (int i = -numWarmupFrames; i <= numFrames; ++i) {
+        const auto time = std::max(i, 0) * timeStep;
+        const auto key = Sample(time);
+        graphics->SetCameraAngles(key.yaw, key.pitch);
+
+        const auto start = std::chrono::steady_clock::now();
+        graphics->Draw();
+        const auto end = std::chrono::steady_clock::now();
+        glFinish();
+
+        const auto counters = graphics->GetCounters();
+        if (i > 0 && counters.numGpuResults != numGpuResults) {
+            frames[i - 1].gpuMilliseconds = counters.gpuMilliseconds;
+        }
+        numGpuResults = counters.numGpuResults;
+
+        if (i >= 0 && i < numFrames) {
+            auto& frame = frames[i];
+            frame.time = time;
+            frame.cpuMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+            frame.counters = counters;
+        }
+    }
+
+    csv << "frame,time,cpu_ms,gpu_ms,draw_calls,objects,passes,"
+        "gl_draw_calls,gl_indirect_commands,triangles,program_binds,vao_binds,texture_binds,"
+        "uniform_uploads,framebuffer_binds,buffer_bytes_uploaded,texture_bytes_uploaded,gpu_memory_bytes\n";
+    for (int i = 0; i < numFrames; ++i) {
+        const auto& frame = frames[i];
+        const auto& api = frame.counters.api;
+        char row[320];
+        snprintf(
+            row,
+            sizeof(row),
+            "%d,%.4f,%.4f,%.4f,%u,%u,%u,%u,%u,%llu,%u,%u,%u,%u,%u,%llu,%llu,%llu\n",
+            i,
+            frame.time,
+            frame.cpuMilliseconds,
+            frame.gpuMilliseconds,
+            frame.counters.numDrawCalls,
+            frame.counters.numObjects,
+            frame.counters.numPasses,
+            api.numDrawCalls,
+            api.numIndirectCommands,
+            (unsigned long long)api.numTriangles,
+            api.numProgramBinds,
+            api.numVaoBinds,
+            api.numTextureBinds,
+            api.numUniformUploads,
+            api.numFramebufferBinds,
+            (unsigned long long)api.bufferBytesUploaded,
+            (unsigned long long)api.textureBytesUploaded,
+            (unsigned long long)frame.counters.memory.GetTotal()
+        );
+        csv << row;
+    }
+
+    std::vector<float> cpu, gpu;
+    for (const auto& frame : frames) {
+        cpu.push_back(frame.cpuMilliseconds);
+        gpu.push_back(frame.gpuMilliseconds);
+    }
+    fprintf(stderr, "Benchmark of %d frames after %d warm-up frames\n", numFrames, numWarmupFrames);
+    PrintPercentiles("CPU", cpu);
+    PrintPercentiles("GPU", gpu);
+}
@@ -0,0 +1,36 @@
+#include "CommandList.hpp"
+#include "Shader.hpp"
+#include "UniformBlocks.hpp"
+
+void CommandList::Execute() const {
+    GLintptr boundPerView = -1;
+    for (const auto& command : commands) {
+        if (command.perViewOffset != boundPerView) {
+            glBindBufferRange(
+                GL_UNIFORM_BUFFER,
+                PerViewBlockBinding,
+                command.uniformBuffer,
+                command.perViewOffset,
+                sizeof(PerViewUniforms)
+            );
+            boundPerView = command.perViewOffset;
+        }
+
+        command.shader->Activate();
+        if (command.bindTextures) {
+            command.shader->BindTextures();
+        }
+
+        glBindVertexArray(command.vao);
+
+        glBindBufferRange(
+            GL_UNIFORM_BUFFER,
+            PerDrawBlockBinding,
+            command.uniformBuffer,
+            command.perDrawOffset,
+            sizeof(PerDrawUniforms)
+        );
+
+        glDrawElements(GL_TRIANGLES, command.numElements, GL_UNSIGNED_INT, 0);
+    }
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+#include "CpuProfiler.hpp"
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t start, end;
+};
+
+const size_t kBlockSize = 16 * 1024;
+// Events past this many blocks on a thread are dropped
+const size_t kMaxBlocks = 1024;
+// Blocks every thread has ready when recording starts, so the first events
+// don't pay for allocating and faulting in their memory
+const size_t kPreparedBlocks = 4;
+
+// Written only by its own thread. Readers see events up to numEvents, which
+// is published after the event itself. Blocks can be allocated by any thread.
+struct ThreadBuffer {
+    ~ThreadBuffer() {
+        for (auto& block : blocks) {
+            delete[] block.load();
+        }
+    }
+
+    std::array<std::atomic<Event*>, kMaxBlocks> blocks = {};
+    std::atomic<size_t> numEvents = 0;
+    // Where the next event goes, only used by its own thread
+    Event* next = nullptr;
+    Event* blockEnd = nullptr;
+    unsigned int id = 0;
+    // Guarded by the registry's mutex
+    std::string name;
+};
+
+Event* GetBlock(ThreadBuffer& buffer, size_t block) {
+    auto* events = buffer.blocks[block].load(std::memory_order_acquire);
+    if (events == nullptr) {
+        // Value initialised, which touches every page up front
+        auto* allocated = new Event[kBlockSize]();
+        if (buffer.blocks[block].compare_exchange_strong(events, allocated, std::memory_order_acq_rel)) {
+            events = allocated;
+        }
+        else {
+            delete[] allocated;
+        }
+    }
+    return events;
+}
+
+void PrepareBlocks(ThreadBuffer& buffer) {
+    const auto first = buffer.numEvents.load(std::memory_order_relaxed) / kBlockSize;
+    for (auto block = first; block < std::min(first + kPreparedBlocks, kMaxBlocks); ++block) {
+        GetBlock(buffer, block);
+    }
+}
+
+struct Registry {
+    std::mutex mutex;
+    // Kept after their threads exit, so the events still get written
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+    std::unordered_set<std::string> names;
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+ThreadBuffer& GetThreadBuffer() {
+    if (threadBuffer == nullptr) {
+        auto& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.push_back(std::make_unique<ThreadBuffer>());
+        threadBuffer = registry.threads.back().get();
+        threadBuffer->id = static_cast<unsigned int>(registry.threads.size());
+        if (CpuProfiler::IsRecording()) {
+            PrepareBlocks(*threadBuffer);
+        }
+    }
+    return *threadBuffer;
+}
+
+void WriteString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (auto c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << (static_cast<unsigned char>(c) < 0x20 ? ' ' : c);
+    }
+    out << '"';
+}
+
+uint64_t ClockNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+// A point in time read from both clocks, to find how fast Now ticks
+struct ClockPair {
+    ClockPair() : ticks(CpuProfiler::Now()), nanoseconds(ClockNanoseconds()) {
+    }
+
+    uint64_t ticks, nanoseconds;
+};
+
+const ClockPair startClocks;
+
+// Chrome traces count in microseconds
+void WriteMicroseconds(std::ostream& out, uint64_t nanoseconds) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%llu.%03u", (unsigned long long)(nanoseconds / 1000), (unsigned int)(nanoseconds % 1000));
+    out << text;
+}
+
+}
+
+void CpuProfiler::Start() {
+    {
+        auto& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& thread : registry.threads) {
+            PrepareBlocks(*thread);
+        }
+    }
+    recording = true;
+}
+
+void CpuProfiler::Stop() {
+    recording = false;
+}
+
+void CpuProfiler::SetThreadName(const std::string& name) {
+    auto& buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    buffer.name = name;
+}
+
+const char* CpuProfiler::Intern(const std::string& name) {
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.names.insert(name).first->c_str();
+}
+
+void CpuProfiler::Record(const char* name, uint64_t start, uint64_t end) {
+    // A new thread and a full block take the same, rarely taken, branch
+    auto* buffer = threadBuffer;
+    if (buffer == nullptr || buffer->next == buffer->blockEnd) {
+        buffer = &GetThreadBuffer();
+        const auto index = buffer->numEvents.load(std::memory_order_relaxed);
+        const auto block = index / kBlockSize;
+        if (block >= kMaxBlocks) {
+            return;
+        }
+        auto* events = GetBlock(*buffer, block);
+        buffer->next = events + index % kBlockSize;
+        buffer->blockEnd = events + kBlockSize;
+    }
+
+    *buffer->next++ = { name, start, end };
+    buffer->numEvents.store(buffer->numEvents.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void CpuProfiler::WriteChromeTrace(const std::filesystem::path& path) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Could not write trace \"" + path.string() + "\"");
+    }
+
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // Timestamps start from the earliest event, they'd be huge otherwise
+    auto origin = UINT64_MAX;
+    for (const auto& thread : registry.threads) {
+        const auto numEvents = thread->numEvents.load(std::memory_order_acquire);
+        for (size_t i = 0; i < numEvents; ++i) {
+            origin = std::min(origin, thread->blocks[i / kBlockSize].load()[i % kBlockSize].start);
+        }
+    }
+
+#ifdef GLITTER_PROFILE_TSC
+    const ClockPair now;
+    const auto nanosecondsPerTick = static_cast<double>(now.nanoseconds - startClocks.nanoseconds) / static_cast<double>(now.ticks - startClocks.ticks);
+#else
+    const auto nanosecondsPerTick = 1.;
+#endif
+    const auto toNanoseconds = [nanosecondsPerTick](uint64_t ticks) {
+        return static_cast<uint64_t>(ticks * nanosecondsPerTick + 0.5);
+    };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& thread : registry.threads) {
+        const auto numEvents = thread->numEvents.load(std::memory_order_acquire);
+        if (numEvents == 0) {
+            continue;
+        }
+
+        out << (first ? "" : ",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread->id << ",\"args\":{\"name\":";
+        WriteString(out, thread->name.empty() ? "Thread " + std::to_string(thread->id) : thread->name);
+        out << "}}";
+        first = false;
+
+        for (size_t i = 0; i < numEvents; ++i) {
+            const auto& event = thread->blocks[i / kBlockSize].load()[i % kBlockSize];
+            out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id << ",\"name\":";
+            WriteString(out, event.name);
+            out << ",\"ts\":";
+            WriteMicroseconds(out, toNanoseconds(event.start - origin));
+            out << ",\"dur\":";
+            WriteMicroseconds(out, toNanoseconds(event.end - event.start));
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+}
@@ -48,4 +48,6 @@ CubePrimitiveMesh::CubePrimitiveMesh(float size) {
         16, 17, 18, 18, 19, 16,
         20, 21, 22, 22, 23, 20,
     };
+
+    CopyPositions();
 }
@@ -3,18 +3,23 @@
 #include <imgui.h>
 
 #include "Drawable.hpp"
+#include "GlStats.hpp"
+#include "GpuRingBuffer.hpp"
 #include "Mesh.hpp"
 #include "Shader.hpp"
 #include "Timer.hpp"
+#include "UniformBlocks.hpp"
 
 
 using namespace glm;
 
 Drawable::Drawable(const Mesh& mesh, const std::shared_ptr<Shader> shader) 
     : shaderProgram(shader) {
+    GlStats::MemoryScope memoryScope(GlStats::Meshes);
     glBindFragDataLocation(shaderProgram->Get(), 0, "outColor");
 
     numElements = mesh.GetNumElements();
+    vertexDataSize = mesh.GetVertexDataSize();
 
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
@@ -31,14 +36,21 @@ Drawable::Drawable(const Mesh& mesh, const std::shared_ptr<Shader> shader)
 
     shaderProgram->SetupVertexAttribs(mesh.GetVertexAttribs());
 
-    modelLocation =
-        glGetUniformLocation(shaderProgram->Get(), "model");
-    modelViewProjectionLocation =
-        glGetUniformLocation(shaderProgram->Get(), "modelViewProjection");
-    modelInverseTransposeLocation = 
-        glGetUniformLocation(shaderProgram->Get(), "modelInverseTranspose");
-    worldSpaceCameraPosLocation =
-        glGetUniformLocation(shaderProgram->Get(), "worldSpaceCameraPos");
+    // Depth-only passes read positions alone, from a stream of their own
+    positionDataSize = mesh.GetPositionDataSize();
+
+    glGenVertexArrays(1, &depthVao);
+    glBindVertexArray(depthVao);
+
+    glGenBuffers(1, &positionVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, positionVbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh.GetPositionDataSize(), mesh.GetPositionData(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(DepthPositionLocation);
+    glVertexAttribPointer(DepthPositionLocation, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBindVertexArray(vao);
+
     reverseLightDirectionLocation = 
         glGetUniformLocation(shaderProgram->Get(), "reverseLightDirection");
 
@@ -55,35 +67,53 @@ Drawable::~Drawable() {
         glDeleteVertexArrays(1, &vao);
         vao = 0;
     }
+    if (positionVbo != 0) {
+        glDeleteBuffers(1, &positionVbo);
+        positionVbo = 0;
+    }
+    if (depthVao != 0) {
+        glDeleteVertexArrays(1, &depthVao);
+        depthVao = 0;
+    }
     if (ebo != 0) {
         glDeleteBuffers(1, &ebo);
         ebo = 0;
     }
 }
 
-void Drawable::Draw(
-    const mat4& model, 
-    const mat4& view, 
-    const mat4& projection,
-    std::shared_ptr<Shader> overrideShader 
-) const {
-    auto shader = overrideShader == nullptr ? shaderProgram : overrideShader;
-    shader->Activate();
-    shader->BindTextures();
-
-    glBindVertexArray(vao);
-
-    auto mvp = projection * view * model;
-    glUniformMatrix4fv(modelLocation, 1, GL_FALSE, value_ptr(model));
-    
-    glUniformMatrix4fv(glGetUniformLocation(shader->Get(), "modelViewProjection"), 1, GL_FALSE, value_ptr(mvp));
-
-    auto modelInverseTranspose = mat3(transpose(inverse(model)));
-    glUniformMatrix3fv(modelInverseTransposeLocation, 1, GL_FALSE, value_ptr(modelInverseTranspose));
-
-    auto worldSpaceCameraPos = vec3(inverse(view)[3]);
-    glUniform3fv(worldSpaceCameraPosLocation, 1, value_ptr(worldSpaceCameraPos));
+void Drawable::WritePerDrawUniforms(
+    PerDrawUniforms& out,
+    const PassContext& pass,
+    TransformSystem::Handle transform
+) {
+    out.model = pass.transforms->GetModel(transform);
+    out.modelViewProjection = pass.view->modelViewProjection[transform];
+    const auto& modelInverseTranspose = pass.transforms->GetModelInverseTranspose(transform);
+    for (int i = 0; i < 3; ++i) {
+        out.modelInverseTranspose[i] = vec4(modelInverseTranspose[i], 0.f);
+    }
+}
 
+void Drawable::Record(
+    CommandList& commandList,
+    const PassContext& pass,
+    TransformSystem::Handle transform
+) const {
+    // When the ring is full the whole frame is recorded again into a bigger one
+    auto allocation = pass.uniforms->Allocate(sizeof(PerDrawUniforms));
+    if (allocation.data == nullptr) {
+        return;
+    }
 
-    glDrawElements(GL_TRIANGLES, numElements, GL_UNSIGNED_INT, 0);
+    WritePerDrawUniforms(*(PerDrawUniforms*)allocation.data, pass, transform);
+
+    DrawCommand command;
+    command.shader = pass.overrideShader == nullptr ? shaderProgram.get() : pass.overrideShader;
+    command.vao = pass.depthOnly ? depthVao : vao;
+    command.bindTextures = !pass.depthOnly;
+    command.numElements = numElements;
+    command.uniformBuffer = pass.uniforms->Get();
+    command.perDrawOffset = allocation.offset;
+    command.perViewOffset = pass.perViewOffset;
+    commandList.Record(command);
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include <cmath>
+
+#include "DynamicResolution.hpp"
+
+using namespace glm;
+
+// Aim a little below the budget, and leave the scale alone between these
+static const float kTargetFraction = 0.9f;
+static const float kIncreaseBelowFraction = 0.75f;
+
+// GpuTimer results lag by up to four frames and are smoothed on top
+static const unsigned int kFramesBetweenChanges = 8;
+
+// Dropping fast avoids long runs of missed frames, rising slowly avoids
+// bouncing straight back over the budget
+static const float kMaxStepDown = 0.1f;
+static const float kMaxStepUp = 0.02f;
+
+// Scales are kept to multiples of this so the render size doesn't jitter
+static const float kScaleGranularity = 1.f / 64.f;
+
+DynamicResolution::DynamicResolution(float budgetMilliseconds)
+    : budget(budgetMilliseconds) {
+}
+
+void DynamicResolution::Update(float gpuMilliseconds) {
+    ++framesSinceChange;
+    if (!enabled || gpuMilliseconds <= 0.f || framesSinceChange < kFramesBetweenChanges) {
+        return;
+    }
+    if (gpuMilliseconds <= budget && gpuMilliseconds >= budget * kIncreaseBelowFraction) {
+        return;
+    }
+
+    const auto desired = scale * std::sqrt(budget * kTargetFraction / gpuMilliseconds);
+    auto next = scale + clamp(desired - scale, -kMaxStepDown, kMaxStepUp);
+    next = clamp(std::round(next / kScaleGranularity) * kScaleGranularity, minScale, maxScale);
+    if (next != scale) {
+        scale = next;
+        framesSinceChange = 0;
+        ++numChanges;
+    }
+}
+
+uvec2 DynamicResolution::GetRenderSize(const uvec2& size) const {
+    return clamp(uvec2(vec2(size) * scale + 0.5f), uvec2(1), size);
+}
+
+void DynamicResolution::SetScale(float newScale) {
+    scale = clamp(newScale, minScale, maxScale);
+}
+
+void DynamicResolution::SetScaleRange(float minimum, float maximum) {
+    minScale = clamp(minimum, 0.1f, 1.f);
+    maxScale = clamp(maximum, minScale, 1.f);
+    scale = clamp(scale, minScale, maxScale);
+}
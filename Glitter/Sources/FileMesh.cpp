@@ -2,13 +2,12 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <array>
-#include <chrono>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
-#include <iostream>
 #include <sstream>
 #include <stdexcept>
 
+#include "CpuProfiler.hpp"
 #include "FileMesh.hpp"
 #include "VectorMesh.hpp"
 
@@ -21,15 +20,18 @@ static void staticCopyToVector(const aiVector3t<float>& vert, std::array<float,
 }
 
 std::vector<FileMesh> LoadFileMesh(const std::filesystem::path& path) {
+    PROFILE_SCOPE("LoadFileMesh");
     Assimp::Importer importer;
 
-    auto t1 = std::chrono::high_resolution_clock::now();
-    const auto* scene = importer.ReadFile(path.string(),
-        aiProcess_CalcTangentSpace |
-        aiProcess_Triangulate |
-        aiProcess_JoinIdenticalVertices |
-        aiProcess_SortByPType);
-    auto t2 = std::chrono::high_resolution_clock::now();
+    const aiScene* scene = nullptr;
+    {
+        PROFILE_SCOPE("Assimp::ReadFile");
+        scene = importer.ReadFile(path.string(),
+            aiProcess_CalcTangentSpace |
+            aiProcess_Triangulate |
+            aiProcess_JoinIdenticalVertices |
+            aiProcess_SortByPType);
+    }
 
     if (scene == nullptr) {
         std::ostringstream s;
@@ -42,19 +44,11 @@ std::vector<FileMesh> LoadFileMesh(const std::filesystem::path& path) {
         throw std::runtime_error(s.str());
     }
 
+    PROFILE_SCOPE("Process meshes");
     std::vector<FileMesh> meshes;
     for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
         meshes.push_back(FileMesh(scene->mMeshes[i]));
     }
-    auto t3 = std::chrono::high_resolution_clock::now();
-
-    auto assimpLoadTime = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
-    auto processingTime = std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2);
-    auto totalTime = std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t1);
-
-    std::cout << "Assimp load time: " << assimpLoadTime.count() << "ms" << std::endl;
-    std::cout << "processing time: " << processingTime.count() << "ms" << std::endl;
-    std::cout << "total time: " << totalTime.count() << "ms" << std::endl;
     return meshes;
 }
 
@@ -78,4 +72,6 @@ FileMesh::FileMesh(const aiMesh* mesh) {
     }
 
     numElements = mesh->mNumFaces * 3;
+
+    CopyPositions();
 }
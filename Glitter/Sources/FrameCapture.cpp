@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "CpuProfiler.hpp"
+#include "FrameCapture.hpp"
+
+using namespace glm;
+
+static const GLuint64 kFenceTimeout = 1000000000; // 1s in nanoseconds
+
+// Beyond this many frames per encoder waiting to be written, frames are
+// dropped rather than let memory grow without bound
+static const size_t kMaxQueuedPerEncoder = 4;
+
+static bool IsSignalled(GLsync fence) {
+    const auto result = glClientWaitSync(fence, 0, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+unsigned int FrameCapture::DefaultNumEncoders() {
+    // Leave a core for rendering
+    return std::max(1u, std::thread::hardware_concurrency() / 2);
+}
+
+FrameCapture::FrameCapture(unsigned int numEncoders) : numEncoders(std::max(1u, numEncoders)) {
+}
+
+FrameCapture::~FrameCapture() {
+    if (recording) {
+        Stop();
+    }
+    for (auto& readback : readbacks) {
+        if (readback.buffer != 0) {
+            glDeleteBuffers(1, &readback.buffer);
+        }
+    }
+}
+
+void FrameCapture::Start(const std::filesystem::path& directory, Format format, bool dropFrames) {
+    if (recording) {
+        Stop();
+    }
+    std::filesystem::create_directories(directory);
+    this->directory = directory;
+    this->format = format;
+    this->dropFrames = dropFrames;
+
+    // GL's rows start at the bottom. Set once here, before any encoder
+    // runs, since stb keeps it in a global.
+    stbi_flip_vertically_on_write(1);
+
+    stats = Stats();
+    nextFrame = 0;
+    quit = false;
+    for (unsigned int i = 0; i < numEncoders; ++i) {
+        encoders.emplace_back(&FrameCapture::EncoderLoop, this);
+    }
+    recording = true;
+}
+
+void FrameCapture::Stop() {
+    if (!recording) {
+        return;
+    }
+    while (numPending > 0) {
+        Retire(true);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        imageWritten.wait(lock, [this] { return queue.empty() && numEncoding == 0; });
+        quit = true;
+    }
+    wakeEncoders.notify_all();
+    for (auto& encoder : encoders) {
+        encoder.join();
+    }
+    encoders.clear();
+    recording = false;
+}
+
+void FrameCapture::Capture(GLuint framebuffer, const uvec2& size) {
+    if (!recording) {
+        return;
+    }
+
+    while (numPending > 0 && IsSignalled(readbacks[oldest].fence)) {
+        Retire(false);
+    }
+    if (numPending == kNumBuffers) {
+        Retire(true);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        const auto maxQueued = numEncoders * kMaxQueuedPerEncoder;
+        if (!dropFrames) {
+            imageWritten.wait(lock, [this, maxQueued] { return queue.size() < maxQueued; });
+        }
+        if (queue.size() >= maxQueued) {
+            // Still numbered, so the gap shows in the sequence
+            ++nextFrame;
+            ++stats.numDropped;
+            return;
+        }
+    }
+
+    auto& readback = readbacks[(oldest + numPending) % kNumBuffers];
+    if (readback.buffer == 0) {
+        glGenBuffers(1, &readback.buffer);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    if (readback.size != size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size.x * size.y * 4, nullptr, GL_STREAM_READ);
+        readback.size = size;
+    }
+
+    // Into the bound pack buffer, so this returns without waiting for the frame
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.frame = nextFrame++;
+    ++numPending;
+    ++stats.numCaptured;
+}
+
+void FrameCapture::Retire(bool wait) {
+    auto& readback = readbacks[oldest];
+    if (wait && !IsSignalled(readback.fence)) {
+        ++stats.numStalls;
+        while (glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeout) == GL_TIMEOUT_EXPIRED) {
+        }
+    }
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    Image image;
+    image.size = readback.size;
+    image.frame = readback.frame;
+    image.pixels.resize((size_t)readback.size.x * readback.size.y * 4);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const auto* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image.pixels.size(), GL_MAP_READ_BIT);
+    if (data != nullptr) {
+        memcpy(image.pixels.data(), data, image.pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    oldest = (oldest + 1) % kNumBuffers;
+    --numPending;
+
+    if (data == nullptr) {
+        ++stats.numDropped;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(image));
+    }
+    wakeEncoders.notify_one();
+}
+
+void FrameCapture::EncoderLoop() {
+    CpuProfiler::SetThreadName("Capture encoder");
+    while (true) {
+        Image image;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeEncoders.wait(lock, [this] { return quit || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            image = std::move(queue.front());
+            queue.pop_front();
+            ++numEncoding;
+        }
+
+        Write(image);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --numEncoding;
+            ++stats.numWritten;
+        }
+        imageWritten.notify_all();
+    }
+}
+
+void FrameCapture::Write(Image& image) const {
+    char name[32];
+    snprintf(name, sizeof(name), format == Png ? "frame_%05u.png" : "frame_%05u.rgba", image.frame);
+    const auto file = (directory / name).string();
+
+    if (format == Png) {
+        // The back buffer's alpha is whatever the last pass wrote
+        for (size_t i = 3; i < image.pixels.size(); i += 4) {
+            image.pixels[i] = 255;
+        }
+        if (!stbi_write_png(file.c_str(), image.size.x, image.size.y, 4, image.pixels.data(), image.size.x * 4)) {
+            fprintf(stderr, "Failed to write %s\n", file.c_str());
+        }
+    }
+    else {
+        std::ofstream stream(file, std::ios::binary);
+        stream.write((const char*)image.pixels.data(), image.pixels.size());
+        if (!stream) {
+            fprintf(stderr, "Failed to write %s\n", file.c_str());
+        }
+    }
+}
+
+FrameCapture::Stats FrameCapture::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto result = stats;
+    result.numQueued = (unsigned int)queue.size() + numEncoding + numPending;
+    return result;
+}
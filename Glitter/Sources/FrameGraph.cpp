@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+
+#include "CpuProfiler.hpp"
+#include "FrameGraph.hpp"
+#include "GlStats.hpp"
+#include "GpuProfiler.hpp"
+#include "Texture2D.hpp"
+
+using namespace glm;
+
+static bool IsDepthFormat(GLenum format) {
+    switch (format) {
+    case GL_DEPTH_COMPONENT:
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+    case GL_DEPTH32F_STENCIL8:
+        return true;
+    }
+    return false;
+}
+
+static bool HasStencil(GLenum format) {
+    return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+// Format and type for glTexImage2D to go with an internal format
+static void GetUploadFormat(GLenum internalFormat, GLenum& format, GLenum& type) {
+    if (HasStencil(internalFormat)) {
+        format = GL_DEPTH_STENCIL;
+        type = GL_UNSIGNED_INT_24_8;
+    }
+    else if (IsDepthFormat(internalFormat)) {
+        format = GL_DEPTH_COMPONENT;
+        type = GL_FLOAT;
+    }
+    else if (internalFormat == GL_RGB8) {
+        format = GL_RGB;
+        type = GL_UNSIGNED_BYTE;
+    }
+    else if (internalFormat == GL_RGBA16F || internalFormat == GL_RGBA32F) {
+        format = GL_RGBA;
+        type = GL_FLOAT;
+    }
+    else {
+        format = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+    }
+}
+
+FrameGraph::Resource FrameGraph::Builder::Create(const std::string& name, const TextureDesc& desc) {
+    ResourceNode resource;
+    resource.name = name;
+    resource.desc = desc;
+    graph.resources.push_back(resource);
+    return (Resource)(graph.resources.size() - 1);
+}
+
+void FrameGraph::Builder::Read(Resource resource) {
+    graph.passes[pass].reads.push_back(resource);
+}
+
+void FrameGraph::Builder::Write(Resource resource) {
+    graph.passes[pass].writes.push_back(resource);
+    graph.resources[resource].writers.push_back(pass);
+}
+
+void FrameGraph::Builder::SetSideEffect() {
+    graph.passes[pass].sideEffect = true;
+}
+
+void FrameGraph::Context::BindFramebuffer() const {
+    const auto& writes = graph.passes[pass].writes;
+    if (writes.empty()) {
+        return;
+    }
+    const auto& first = graph.resources[writes[0]];
+    if (first.backbuffer) {
+        glBindFramebuffer(GL_FRAMEBUFFER, first.object);
+    }
+    else {
+        glBindFramebuffer(GL_FRAMEBUFFER, graph.GetFramebuffer(writes));
+    }
+    glViewport(0, 0, first.desc.size.x, first.desc.size.y);
+}
+
+GLuint FrameGraph::Context::GetTexture(Resource resource) const {
+    return graph.resources[resource].object;
+}
+
+uvec2 FrameGraph::Context::GetSize(Resource resource) const {
+    return graph.resources[resource].desc.size;
+}
+
+GLuint FrameGraph::Context::GetFramebuffer(Resource resource) const {
+    if (graph.resources[resource].backbuffer) {
+        return graph.resources[resource].object;
+    }
+    return graph.GetFramebuffer({ resource });
+}
+
+FrameGraph::~FrameGraph() {
+    for (auto& physical : pool) {
+        physical.used = false;
+    }
+    ReleasePool();
+    for (auto& [key, framebuffer] : framebuffers) {
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+}
+
+void FrameGraph::Reset() {
+    resources.clear();
+    passes.clear();
+    order.clear();
+}
+
+FrameGraph::Resource FrameGraph::Import(const std::string& name, GLuint texture, const uvec2& size, GLenum format) {
+    ResourceNode resource;
+    resource.name = name;
+    resource.desc.size = size;
+    resource.desc.internalFormat = format;
+    resource.imported = true;
+    resource.object = texture;
+    resources.push_back(resource);
+    return (Resource)(resources.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::ImportBackbuffer(const uvec2& size, GLuint framebuffer) {
+    auto resource = Import("Backbuffer", framebuffer, size, GL_RGBA8);
+    resources[resource].backbuffer = true;
+    resources[resource].output = true;
+    return resource;
+}
+
+void FrameGraph::MarkOutput(Resource resource) {
+    resources[resource].output = true;
+}
+
+void FrameGraph::AddPass(const std::string& name, const SetupFunction& setup, const ExecuteFunction& execute) {
+    PassNode pass;
+    pass.name = name;
+#ifdef GLITTER_PROFILING
+    // Interning takes a lock, so only while there is a trace to name
+    if (CpuProfiler::IsRecording()) {
+        pass.profileName = CpuProfiler::Intern(name);
+    }
+#endif
+    pass.execute = execute;
+    passes.push_back(pass);
+
+    Builder builder(*this, passes.size() - 1);
+    setup(builder);
+}
+
+void FrameGraph::Compile() {
+    PROFILE_SCOPE("FrameGraph::Compile");
+    stats = Stats();
+    stats.numPasses = (unsigned int)passes.size();
+
+    // A pass depends on the passes that wrote what it reads. Several writers
+    // of one resource run in the order they were added, and a pass that reads
+    // and writes the same resource only waits for the writers added before it.
+    std::vector<std::vector<size_t>> dependencies(passes.size());
+    for (size_t p = 0; p < passes.size(); ++p) {
+        const auto& writes = passes[p].writes;
+        for (auto r : passes[p].reads) {
+            const bool alsoWrites = std::find(writes.begin(), writes.end(), r) != writes.end();
+            for (auto writer : resources[r].writers) {
+                if (writer != p && (writer < p || !alsoWrites)) {
+                    dependencies[p].push_back(writer);
+                }
+            }
+        }
+    }
+    for (const auto& resource : resources) {
+        for (size_t i = 1; i < resource.writers.size(); ++i) {
+            dependencies[resource.writers[i]].push_back(resource.writers[i - 1]);
+        }
+    }
+
+    // Keep whatever leads to an output
+    std::vector<size_t> stack;
+    for (size_t p = 0; p < passes.size(); ++p) {
+        auto& pass = passes[p];
+        pass.kept = pass.sideEffect;
+        for (auto r : pass.writes) {
+            pass.kept = pass.kept || resources[r].output;
+        }
+        if (pass.kept) {
+            stack.push_back(p);
+        }
+    }
+    while (!stack.empty()) {
+        auto p = stack.back();
+        stack.pop_back();
+        for (auto dependency : dependencies[p]) {
+            if (!passes[dependency].kept) {
+                passes[dependency].kept = true;
+                stack.push_back(dependency);
+            }
+        }
+    }
+
+    // Topological sort, preferring the order passes were added in
+    std::vector<unsigned int> numWaiting(passes.size(), 0);
+    std::vector<std::vector<size_t>> dependents(passes.size());
+    for (size_t p = 0; p < passes.size(); ++p) {
+        if (!passes[p].kept) {
+            ++stats.numCulled;
+            continue;
+        }
+        for (auto dependency : dependencies[p]) {
+            ++numWaiting[p];
+            dependents[dependency].push_back(p);
+        }
+    }
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+    for (size_t p = 0; p < passes.size(); ++p) {
+        if (passes[p].kept && numWaiting[p] == 0) {
+            ready.push(p);
+        }
+    }
+    order.clear();
+    while (!ready.empty()) {
+        auto p = ready.top();
+        ready.pop();
+        order.push_back(p);
+        for (auto dependent : dependents[p]) {
+            if (--numWaiting[dependent] == 0) {
+                ready.push(dependent);
+            }
+        }
+    }
+    if (order.size() != passes.size() - stats.numCulled) {
+        throw std::runtime_error("Frame graph has a cycle");
+    }
+
+    // Lifetimes of transient resources, then GL objects for them
+    for (size_t i = 0; i < order.size(); ++i) {
+        const auto& pass = passes[order[i]];
+        for (const auto* list : { &pass.reads, &pass.writes }) {
+            for (auto r : *list) {
+                auto& resource = resources[r];
+                resource.firstUse = std::min(resource.firstUse, i);
+                resource.lastUse = std::max(resource.lastUse, i);
+            }
+        }
+    }
+
+    for (auto& physical : pool) {
+        physical.used = false;
+        physical.availableFrom = 0;
+    }
+
+    std::vector<ResourceNode*> transients;
+    for (auto& resource : resources) {
+        if (!resource.imported && resource.firstUse != SIZE_MAX) {
+            transients.push_back(&resource);
+        }
+    }
+    std::stable_sort(transients.begin(), transients.end(), [](const ResourceNode* a, const ResourceNode* b) {
+        return a->firstUse < b->firstUse;
+    });
+    for (auto* resource : transients) {
+        AssignPhysical(*resource);
+        ++stats.numTransients;
+        stats.requestedBytes += GlStats::GetBytesPerPixel(resource->desc.internalFormat) * resource->desc.size.x * resource->desc.size.y;
+    }
+
+    ReleasePool();
+    for (const auto& physical : pool) {
+        ++stats.numAllocated;
+        stats.allocatedBytes += GlStats::GetBytesPerPixel(physical.desc.internalFormat) * physical.desc.size.x * physical.desc.size.y;
+    }
+}
+
+void FrameGraph::AssignPhysical(ResourceNode& resource) {
+    Physical* match = nullptr;
+    for (auto& physical : pool) {
+        if (physical.desc == resource.desc && (!physical.used || physical.availableFrom <= resource.firstUse)) {
+            match = &physical;
+            break;
+        }
+    }
+
+    if (match == nullptr) {
+        GlStats::MemoryScope memoryScope(GlStats::Framebuffers);
+        Physical physical;
+        physical.desc = resource.desc;
+        const auto& size = resource.desc.size;
+        if (resource.desc.renderbuffer) {
+            glGenRenderbuffers(1, &physical.object);
+            glBindRenderbuffer(GL_RENDERBUFFER, physical.object);
+            glRenderbufferStorage(GL_RENDERBUFFER, resource.desc.internalFormat, size.x, size.y);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        }
+        else {
+            GLenum format, type;
+            GetUploadFormat(resource.desc.internalFormat, format, type);
+            glGenTextures(1, &physical.object);
+            Texture2D::BindTexture(physical.object);
+            glTexImage2D(GL_TEXTURE_2D, 0, resource.desc.internalFormat, size.x, size.y, 0, format, type, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        pool.push_back(physical);
+        match = &pool.back();
+    }
+
+    match->used = true;
+    match->availableFrom = resource.lastUse + 1;
+    resource.object = match->object;
+}
+
+void FrameGraph::ReleasePool() {
+    bool released = false;
+    for (auto& physical : pool) {
+        if (physical.used) {
+            continue;
+        }
+        if (physical.desc.renderbuffer) {
+            glDeleteRenderbuffers(1, &physical.object);
+        }
+        else {
+            glDeleteTextures(1, &physical.object);
+        }
+        released = true;
+    }
+    pool.erase(
+        std::remove_if(pool.begin(), pool.end(), [](const Physical& physical) { return !physical.used; }),
+        pool.end()
+    );
+
+    // Names of deleted objects get reused, so cached framebuffers can't be trusted
+    if (released) {
+        for (auto& [key, framebuffer] : framebuffers) {
+            glDeleteFramebuffers(1, &framebuffer);
+        }
+        framebuffers.clear();
+    }
+}
+
+GLuint FrameGraph::GetFramebuffer(const std::vector<Resource>& attachments) {
+    std::vector<GLuint> key;
+    for (auto r : attachments) {
+        key.push_back(resources[r].object);
+        key.push_back(resources[r].desc.renderbuffer);
+    }
+    auto found = framebuffers.find(key);
+    if (found != framebuffers.end()) {
+        return found->second;
+    }
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    std::vector<GLenum> drawBuffers;
+    for (auto r : attachments) {
+        const auto& resource = resources[r];
+        const auto format = resource.desc.internalFormat;
+        GLenum attachment;
+        if (HasStencil(format)) {
+            attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+        }
+        else if (IsDepthFormat(format)) {
+            attachment = GL_DEPTH_ATTACHMENT;
+        }
+        else {
+            attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+            drawBuffers.push_back(attachment);
+        }
+
+        if (resource.desc.renderbuffer) {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, resource.object);
+        }
+        else {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, resource.object, 0);
+        }
+    }
+
+    if (drawBuffers.empty()) {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    else {
+        glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+        glReadBuffer(drawBuffers[0]);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Frame graph framebuffer is not ready!");
+    }
+
+    framebuffers[key] = framebuffer;
+    return framebuffer;
+}
+
+void FrameGraph::Execute(GpuProfiler* profiler) {
+    for (auto p : order) {
+        PROFILE_SCOPE(passes[p].profileName != nullptr ? passes[p].profileName : "Frame graph pass");
+        Context context(*this, p);
+        if (profiler != nullptr) {
+            profiler->Begin(passes[p].name);
+        }
+        passes[p].execute(context);
+        if (profiler != nullptr) {
+            profiler->End();
+        }
+    }
+}
+
+std::vector<std::string> FrameGraph::GetSchedule() const {
+    std::vector<std::string> names;
+    for (auto p : order) {
+        names.push_back(passes[p].name);
+    }
+    return names;
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "FramePacer.hpp"
+
+using namespace std::chrono;
+
+// Sleeps are only trusted to this far ahead of the deadline, then we spin
+static const auto kSpinThreshold = microseconds(1500);
+
+// Added to the predicted frame time in low latency mode to absorb variation
+static const float kLowLatencyMarginMilliseconds = 1.5f;
+static const float kWorkSmoothing = 0.1f;
+
+void FramePacer::WaitUntil(Clock::time_point deadline) {
+    while (true) {
+        const auto remaining = deadline - Clock::now();
+        if (remaining <= Clock::duration::zero()) {
+            return;
+        }
+        if (remaining > kSpinThreshold) {
+            std::this_thread::sleep_for(remaining - kSpinThreshold);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+FramePacer::Clock::duration FramePacer::GetPeriod() const {
+    const auto rate = frameCap > 0.f ? frameCap : refreshRate;
+    return duration_cast<Clock::duration>(duration<double>(1.0 / std::max(rate, 1.f)));
+}
+
+void FramePacer::WaitForFrameStart() {
+    const auto now = Clock::now();
+    if (!started) {
+        started = true;
+        nextDeadline = now + GetPeriod();
+        return;
+    }
+    if (frameCap <= 0.f && !lowLatency) {
+        return;
+    }
+
+    Clock::time_point presented;
+    float work;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        presented = lastPresent;
+        work = workMilliseconds;
+    }
+
+    if (frameCap <= 0.f) {
+        // Only vsync paces frames, so expect the next refresh one period
+        // after the last present returned
+        nextDeadline = presented + GetPeriod();
+    }
+
+    auto start = nextDeadline - GetPeriod();
+    if (lowLatency) {
+        const auto lead = duration<float, std::milli>(work + kLowLatencyMarginMilliseconds);
+        start = std::max(start, nextDeadline - duration_cast<Clock::duration>(lead));
+    }
+    WaitUntil(start);
+
+    if (frameCap > 0.f) {
+        // Catch up without bursts after a slow frame
+        nextDeadline += GetPeriod();
+        if (nextDeadline < Clock::now()) {
+            nextDeadline = Clock::now() + GetPeriod();
+        }
+    }
+}
+
+FramePacer::Clock::time_point FramePacer::OnInputSampled() {
+    return Clock::now();
+}
+
+void FramePacer::OnPresented(Clock::time_point inputTime) {
+    const auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto latency = duration<float, std::milli>(now - inputTime).count();
+    workMilliseconds = workMilliseconds == 0.f ? latency : workMilliseconds + (latency - workMilliseconds) * kWorkSmoothing;
+
+    if (lastPresent != Clock::time_point()) {
+        intervals[next] = duration<float, std::milli>(now - lastPresent).count();
+        latencies[next] = latency;
+        next = (next + 1) % kHistorySize;
+        count = std::min(count + 1, kHistorySize);
+    }
+    lastPresent = now;
+}
+
+FramePacer::Stats FramePacer::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats stats;
+    stats.numSamples = static_cast<unsigned int>(count);
+    if (count == 0) {
+        return stats;
+    }
+
+    const auto period = duration<float, std::milli>(GetPeriod()).count();
+    const bool paced = frameCap > 0.f || lowLatency;
+    for (size_t i = 0; i < count; ++i) {
+        stats.intervalMilliseconds += intervals[i];
+        stats.latencyMilliseconds += latencies[i];
+        stats.maxLatencyMilliseconds = std::max(stats.maxLatencyMilliseconds, latencies[i]);
+        if (paced && intervals[i] > period * 1.5f) {
+            ++stats.numMissed;
+        }
+    }
+    stats.intervalMilliseconds /= count;
+    stats.latencyMilliseconds /= count;
+
+    float variance = 0.f;
+    for (size_t i = 0; i < count; ++i) {
+        const auto deviation = intervals[i] - stats.intervalMilliseconds;
+        variance += deviation * deviation;
+    }
+    stats.jitterMilliseconds = std::sqrt(variance / count);
+    return stats;
+}
+
+std::array<float, FramePacer::kHistorySize> FramePacer::GetIntervalHistory() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::array<float, kHistorySize> history = {};
+    for (size_t i = 0; i < count; ++i) {
+        history[kHistorySize - count + i] = intervals[(next + kHistorySize - count + i) % kHistorySize];
+    }
+    return history;
+}
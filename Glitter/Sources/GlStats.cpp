@@ -0,0 +1,417 @@
+#include <array>
+#include <unordered_map>
+
+#include "GlStats.hpp"
+
+static GlStats::Frame frame;
+static GlStats::Memory memory;
+
+#ifdef GLITTER_PROFILING
+namespace {
+    struct Allocation {
+        GlStats::Category category = GlStats::Other;
+        size_t bytes = 0;
+    };
+
+    struct TextureAllocation {
+        GlStats::Category category = GlStats::Other;
+        // Level 0 of each cube map face, other textures only use the first.
+        // The engine doesn't allocate further mip levels.
+        std::array<size_t, 6> faces = {};
+    };
+}
+
+// Bindings, to know which object an allocation is for
+static std::unordered_map<GLenum, GLuint> boundBuffers;
+// The element array binding is part of the vertex array's state
+static std::unordered_map<GLuint, GLuint> vaoElementBuffers;
+static GLuint boundVao = 0;
+static GLenum activeTexture = GL_TEXTURE0;
+static std::unordered_map<uint64_t, GLuint> boundTextures;
+static GLuint boundRenderbuffer = 0;
+
+static std::unordered_map<GLuint, Allocation> buffers, renderbuffers;
+static std::unordered_map<GLuint, TextureAllocation> textures;
+
+static decltype(glad_glDrawArrays) realDrawArrays;
+static decltype(glad_glDrawElements) realDrawElements;
+static decltype(glad_glMultiDrawElementsIndirect) realMultiDrawElementsIndirect;
+static decltype(glad_glUseProgram) realUseProgram;
+static decltype(glad_glBindVertexArray) realBindVertexArray;
+static decltype(glad_glDeleteVertexArrays) realDeleteVertexArrays;
+static decltype(glad_glActiveTexture) realActiveTexture;
+static decltype(glad_glBindTexture) realBindTexture;
+static decltype(glad_glTexImage2D) realTexImage2D;
+static decltype(glad_glDeleteTextures) realDeleteTextures;
+static decltype(glad_glUniform1i) realUniform1i;
+static decltype(glad_glUniform1f) realUniform1f;
+static decltype(glad_glUniform2fv) realUniform2fv;
+static decltype(glad_glUniform3fv) realUniform3fv;
+static decltype(glad_glUniform4fv) realUniform4fv;
+static decltype(glad_glUniformMatrix4fv) realUniformMatrix4fv;
+static decltype(glad_glBindBuffer) realBindBuffer;
+static decltype(glad_glBindBufferRange) realBindBufferRange;
+static decltype(glad_glBufferData) realBufferData;
+static decltype(glad_glBufferStorage) realBufferStorage;
+static decltype(glad_glBufferSubData) realBufferSubData;
+static decltype(glad_glMapBufferRange) realMapBufferRange;
+static decltype(glad_glDeleteBuffers) realDeleteBuffers;
+static decltype(glad_glBindRenderbuffer) realBindRenderbuffer;
+static decltype(glad_glRenderbufferStorage) realRenderbufferStorage;
+static decltype(glad_glDeleteRenderbuffers) realDeleteRenderbuffers;
+static decltype(glad_glBindFramebuffer) realBindFramebuffer;
+
+static uint64_t CountTriangles(GLenum mode, GLsizei count) {
+    switch (mode) {
+    case GL_TRIANGLES:
+        return count / 3;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+        return count > 2 ? count - 2 : 0;
+    }
+    return 0;
+}
+
+static uint64_t TextureKey(GLenum target) {
+    return (static_cast<uint64_t>(activeTexture) << 32) | target;
+}
+
+static GLuint GetBoundBuffer(GLenum target) {
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        const auto it = vaoElementBuffers.find(boundVao);
+        return it == vaoElementBuffers.end() ? 0 : it->second;
+    }
+    const auto it = boundBuffers.find(target);
+    return it == boundBuffers.end() ? 0 : it->second;
+}
+
+static void SetSize(Allocation& allocation, size_t bytes) {
+    memory.bytes[allocation.category] -= allocation.bytes;
+    allocation.bytes = bytes;
+    memory.bytes[allocation.category] += bytes;
+}
+
+struct GlStats::Hooks {
+    // Objects keep the category they were first allocated under, eg. when a
+    // streaming buffer is orphaned every frame
+    static Allocation& GetAllocation(std::unordered_map<GLuint, Allocation>& allocations, GLuint object) {
+        const auto [it, inserted] = allocations.try_emplace(object);
+        if (inserted) {
+            it->second.category = current;
+        }
+        return it->second;
+    }
+
+    static void APIENTRY DrawArrays(GLenum mode, GLint first, GLsizei count) {
+        ++frame.numDrawCalls;
+        frame.numTriangles += CountTriangles(mode, count);
+        realDrawArrays(mode, first, count);
+    }
+
+    static void APIENTRY DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+        ++frame.numDrawCalls;
+        frame.numTriangles += CountTriangles(mode, count);
+        realDrawElements(mode, count, type, indices);
+    }
+
+    static void APIENTRY MultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride) {
+        ++frame.numDrawCalls;
+        frame.numIndirectCommands += drawcount;
+        realMultiDrawElementsIndirect(mode, type, indirect, drawcount, stride);
+    }
+
+    static void APIENTRY UseProgram(GLuint program) {
+        ++frame.numProgramBinds;
+        realUseProgram(program);
+    }
+
+    static void APIENTRY BindVertexArray(GLuint array) {
+        ++frame.numVaoBinds;
+        boundVao = array;
+        realBindVertexArray(array);
+    }
+
+    static void APIENTRY DeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+        for (GLsizei i = 0; i < n; ++i) {
+            vaoElementBuffers.erase(arrays[i]);
+            if (arrays[i] == boundVao) {
+                boundVao = 0;
+            }
+        }
+        realDeleteVertexArrays(n, arrays);
+    }
+
+    static void APIENTRY ActiveTexture(GLenum texture) {
+        activeTexture = texture;
+        realActiveTexture(texture);
+    }
+
+    static void APIENTRY BindTexture(GLenum target, GLuint texture) {
+        ++frame.numTextureBinds;
+        boundTextures[TextureKey(target)] = texture;
+        realBindTexture(target, texture);
+    }
+
+    static void APIENTRY TexImage2D(
+        GLenum target,
+        GLint level,
+        GLint internalformat,
+        GLsizei width,
+        GLsizei height,
+        GLint border,
+        GLenum format,
+        GLenum type,
+        const void* pixels
+    ) {
+        const bool cubeFace = target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
+        const auto it = boundTextures.find(TextureKey(cubeFace ? GL_TEXTURE_CUBE_MAP : target));
+        const size_t bytes = GetBytesPerPixel(internalformat) * width * height;
+        if (it != boundTextures.end() && it->second != 0 && level == 0) {
+            const auto [allocation, inserted] = textures.try_emplace(it->second);
+            if (inserted) {
+                allocation->second.category = current;
+            }
+            auto& face = allocation->second.faces[cubeFace ? target - GL_TEXTURE_CUBE_MAP_POSITIVE_X : 0];
+            memory.bytes[allocation->second.category] += bytes - face;
+            face = bytes;
+        }
+        if (pixels != nullptr) {
+            frame.textureBytesUploaded += bytes;
+        }
+        realTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+    }
+
+    static void APIENTRY DeleteTextures(GLsizei n, const GLuint* deleted) {
+        for (GLsizei i = 0; i < n; ++i) {
+            const auto it = textures.find(deleted[i]);
+            if (it == textures.end()) {
+                continue;
+            }
+            for (auto bytes : it->second.faces) {
+                memory.bytes[it->second.category] -= bytes;
+            }
+            textures.erase(it);
+        }
+        realDeleteTextures(n, deleted);
+    }
+
+    static void APIENTRY Uniform1i(GLint location, GLint v0) {
+        ++frame.numUniformUploads;
+        realUniform1i(location, v0);
+    }
+
+    static void APIENTRY Uniform1f(GLint location, GLfloat v0) {
+        ++frame.numUniformUploads;
+        realUniform1f(location, v0);
+    }
+
+    static void APIENTRY Uniform2fv(GLint location, GLsizei count, const GLfloat* value) {
+        ++frame.numUniformUploads;
+        realUniform2fv(location, count, value);
+    }
+
+    static void APIENTRY Uniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+        ++frame.numUniformUploads;
+        realUniform3fv(location, count, value);
+    }
+
+    static void APIENTRY Uniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+        ++frame.numUniformUploads;
+        realUniform4fv(location, count, value);
+    }
+
+    static void APIENTRY UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+        ++frame.numUniformUploads;
+        realUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    static void APIENTRY BindBuffer(GLenum target, GLuint buffer) {
+        if (target == GL_ELEMENT_ARRAY_BUFFER) {
+            vaoElementBuffers[boundVao] = buffer;
+        }
+        else {
+            boundBuffers[target] = buffer;
+        }
+        realBindBuffer(target, buffer);
+    }
+
+    static void APIENTRY BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+        // Binds the generic target too
+        boundBuffers[target] = buffer;
+        realBindBufferRange(target, index, buffer, offset, size);
+    }
+
+    static void APIENTRY BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+        if (const auto buffer = GetBoundBuffer(target)) {
+            SetSize(GetAllocation(buffers, buffer), size);
+        }
+        if (data != nullptr) {
+            frame.bufferBytesUploaded += size;
+        }
+        realBufferData(target, size, data, usage);
+    }
+
+    static void APIENTRY BufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags) {
+        if (const auto buffer = GetBoundBuffer(target)) {
+            SetSize(GetAllocation(buffers, buffer), size);
+        }
+        if (data != nullptr) {
+            frame.bufferBytesUploaded += size;
+        }
+        realBufferStorage(target, size, data, flags);
+    }
+
+    static void APIENTRY BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+        frame.bufferBytesUploaded += size;
+        realBufferSubData(target, offset, size, data);
+    }
+
+    static void* APIENTRY MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+        if ((access & GL_MAP_WRITE_BIT) != 0 && (access & GL_MAP_PERSISTENT_BIT) == 0) {
+            frame.bufferBytesUploaded += length;
+        }
+        return realMapBufferRange(target, offset, length, access);
+    }
+
+    static void APIENTRY DeleteBuffers(GLsizei n, const GLuint* deleted) {
+        for (GLsizei i = 0; i < n; ++i) {
+            const auto it = buffers.find(deleted[i]);
+            if (it != buffers.end()) {
+                memory.bytes[it->second.category] -= it->second.bytes;
+                buffers.erase(it);
+            }
+            for (auto& [target, buffer] : boundBuffers) {
+                if (buffer == deleted[i]) {
+                    buffer = 0;
+                }
+            }
+        }
+        realDeleteBuffers(n, deleted);
+    }
+
+    static void APIENTRY BindRenderbuffer(GLenum target, GLuint renderbuffer) {
+        boundRenderbuffer = renderbuffer;
+        realBindRenderbuffer(target, renderbuffer);
+    }
+
+    static void APIENTRY RenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) {
+        if (boundRenderbuffer != 0) {
+            SetSize(GetAllocation(renderbuffers, boundRenderbuffer), GetBytesPerPixel(internalformat) * width * height);
+        }
+        realRenderbufferStorage(target, internalformat, width, height);
+    }
+
+    static void APIENTRY DeleteRenderbuffers(GLsizei n, const GLuint* deleted) {
+        for (GLsizei i = 0; i < n; ++i) {
+            const auto it = renderbuffers.find(deleted[i]);
+            if (it != renderbuffers.end()) {
+                memory.bytes[it->second.category] -= it->second.bytes;
+                renderbuffers.erase(it);
+            }
+            if (deleted[i] == boundRenderbuffer) {
+                boundRenderbuffer = 0;
+            }
+        }
+        realDeleteRenderbuffers(n, deleted);
+    }
+
+    static void APIENTRY BindFramebuffer(GLenum target, GLuint framebuffer) {
+        ++frame.numFramebufferBinds;
+        realBindFramebuffer(target, framebuffer);
+    }
+};
+
+// Entry points the context doesn't have stay null, so checks for them still work
+#define HOOK(name)                             \
+    if (glad_gl##name != nullptr) {            \
+        real##name = glad_gl##name;            \
+        glad_gl##name = GlStats::Hooks::name;  \
+    }
+#endif
+
+void GlStats::Install() {
+#ifdef GLITTER_PROFILING
+    static bool installed = false;
+    if (installed) {
+        return;
+    }
+    installed = true;
+
+    HOOK(DrawArrays);
+    HOOK(DrawElements);
+    HOOK(MultiDrawElementsIndirect);
+    HOOK(UseProgram);
+    HOOK(BindVertexArray);
+    HOOK(DeleteVertexArrays);
+    HOOK(ActiveTexture);
+    HOOK(BindTexture);
+    HOOK(TexImage2D);
+    HOOK(DeleteTextures);
+    HOOK(Uniform1i);
+    HOOK(Uniform1f);
+    HOOK(Uniform2fv);
+    HOOK(Uniform3fv);
+    HOOK(Uniform4fv);
+    HOOK(UniformMatrix4fv);
+    HOOK(BindBuffer);
+    HOOK(BindBufferRange);
+    HOOK(BufferData);
+    HOOK(BufferStorage);
+    HOOK(BufferSubData);
+    HOOK(MapBufferRange);
+    HOOK(DeleteBuffers);
+    HOOK(BindRenderbuffer);
+    HOOK(RenderbufferStorage);
+    HOOK(DeleteRenderbuffers);
+    HOOK(BindFramebuffer);
+#endif
+}
+
+GlStats::Frame GlStats::EndFrame() {
+    const auto ended = frame;
+    frame = Frame();
+    return ended;
+}
+
+GlStats::Memory GlStats::GetMemory() {
+    return memory;
+}
+
+const char* GlStats::GetCategoryName(Category category) {
+    switch (category) {
+    case Textures:
+        return "Textures";
+    case Meshes:
+        return "Meshes";
+    case Framebuffers:
+        return "Framebuffers";
+    case Other:
+        return "Other";
+    default:
+        break;
+    }
+    return "";
+}
+
+size_t GlStats::GetBytesPerPixel(GLenum internalFormat) {
+    switch (internalFormat) {
+    case GL_RED:
+    case GL_R8:
+        return 1;
+    case GL_RG:
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+        return 2;
+    case GL_RG32F:
+    case GL_RGBA16F:
+    case GL_RGB16F:
+    case GL_DEPTH32F_STENCIL8:
+        return 8;
+    case GL_RGB32F:
+    case GL_RGBA32F:
+        return 16;
+    }
+    // Drivers pad RGB8 to four bytes too
+    return 4;
+}
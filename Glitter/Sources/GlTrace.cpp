@@ -0,0 +1,680 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <glad/glad.h>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "GlTrace.hpp"
+
+namespace {
+    struct Blob {
+        const void* data;
+        size_t size;
+    };
+
+    struct Mapping {
+        void* pointer = nullptr;
+        int64_t length = 0;
+        GLbitfield access = 0;
+        // What the engine writes to instead of a write-only mapping, which
+        // can't be read back
+        std::vector<uint8_t> shadow;
+    };
+}
+
+static std::ofstream file;
+static int numFramesToRecord = 0;
+static bool opened = false;
+static bool recording = false;
+static GlTrace::Header header;
+static std::vector<uint8_t> trace;
+
+// State the recorder needs to know how much data a call passes
+static std::unordered_map<GLenum, Mapping> mappings;
+static GLuint packBuffer = 0;
+static GLint unpackAlignment = 4;
+
+#define FOR_EACH_HOOK(X) \
+    X(GenBuffers) X(DeleteBuffers) X(GenTextures) X(DeleteTextures) X(GenVertexArrays) X(DeleteVertexArrays) \
+    X(GenFramebuffers) X(DeleteFramebuffers) X(GenRenderbuffers) X(DeleteRenderbuffers) X(GenQueries) \
+    X(DeleteQueries) X(CreateShader) X(DeleteShader) X(CreateProgram) X(DeleteProgram) X(FenceSync) \
+    X(DeleteSync) X(ClientWaitSync) X(ShaderSource) X(CompileShader) X(AttachShader) X(LinkProgram) \
+    X(BindFragDataLocation) X(GetUniformLocation) X(GetUniformBlockIndex) X(GetAttribLocation) \
+    X(UniformBlockBinding) X(UseProgram) X(Uniform1i) X(Uniform1f) X(Uniform2fv) X(Uniform3fv) X(Uniform4fv) \
+    X(UniformMatrix4fv) X(BindBuffer) X(BindBufferRange) X(BufferData) X(BufferSubData) X(CopyBufferSubData) \
+    X(MapBufferRange) X(UnmapBuffer) X(TexBuffer) X(BindVertexArray) X(EnableVertexAttribArray) \
+    X(VertexAttribPointer) X(VertexAttribIPointer) X(VertexAttribDivisor) X(ActiveTexture) X(BindTexture) \
+    X(TexImage2D) X(TexParameteri) X(TexParameterfv) X(PixelStorei) X(BindFramebuffer) X(FramebufferTexture2D) \
+    X(FramebufferRenderbuffer) X(BindRenderbuffer) X(RenderbufferStorage) X(DrawBuffer) X(DrawBuffers) \
+    X(ReadBuffer) X(BlitFramebuffer) X(ReadPixels) X(Enable) X(Disable) X(DepthFunc) X(Viewport) X(ClearColor) \
+    X(Clear) X(DrawArrays) X(DrawElements) X(MultiDrawElementsIndirect) X(QueryCounter) X(BeginQuery) \
+    X(EndQuery) X(Finish)
+
+#define DECLARE_REAL(name) static decltype(glad_gl##name) real##name;
+FOR_EACH_HOOK(DECLARE_REAL)
+
+template<typename T>
+static void Put(const T& value) {
+    static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "Pointers need converting to offsets or blobs");
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    trace.insert(trace.end(), bytes, bytes + sizeof(T));
+}
+
+static void Put(const Blob& blob) {
+    Put(static_cast<uint32_t>(blob.size));
+    const auto* bytes = static_cast<const uint8_t*>(blob.data);
+    trace.insert(trace.end(), bytes, bytes + blob.size);
+}
+
+template<typename... Args>
+static void Record(GlTrace::Call call, const Args&... args) {
+    if (!recording) {
+        return;
+    }
+    Put(static_cast<uint16_t>(call));
+    const auto sizeOffset = trace.size();
+    Put(uint32_t(0));
+    (Put(args), ...);
+    const auto size = static_cast<uint32_t>(trace.size() - sizeOffset - sizeof(uint32_t));
+    memcpy(trace.data() + sizeOffset, &size, sizeof(size));
+}
+
+// Sizes and offsets are 64 bits whatever the platform's GLsizeiptr is
+static int64_t Offset(const void* pointer) {
+    return static_cast<int64_t>(reinterpret_cast<intptr_t>(pointer));
+}
+
+static uint64_t SyncId(GLsync sync) {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(sync));
+}
+
+static Blob Names(GLsizei n, const GLuint* names) {
+    return { names, n * sizeof(GLuint) };
+}
+
+static Blob String(const GLchar* string) {
+    return { string, strlen(string) };
+}
+
+static size_t GetPixelSize(GLenum format, GLenum type) {
+    size_t components = 1;
+    switch (format) {
+    case GL_RG:
+        components = 2;
+        break;
+    case GL_RGB:
+        components = 3;
+        break;
+    case GL_RGBA:
+        components = 4;
+        break;
+    }
+
+    switch (type) {
+    case GL_UNSIGNED_BYTE:
+        return components;
+    case GL_HALF_FLOAT:
+        return components * 2;
+    case GL_UNSIGNED_INT_24_8:
+        return 4;
+    }
+    return components * 4;
+}
+
+static void Write() {
+    recording = false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(trace.data()), trace.size());
+    file.close();
+    if (file.fail()) {
+        fprintf(stderr, "Failed to write the GL trace\n");
+    }
+    else {
+        fprintf(stderr, "Wrote a GL trace of %u frames, %.1f MiB\n", header.numFrames, trace.size() / (1024. * 1024.));
+    }
+    trace = std::vector<uint8_t>();
+}
+
+struct GlTrace::Hooks {
+    static void APIENTRY GenBuffers(GLsizei n, GLuint* buffers) {
+        realGenBuffers(n, buffers);
+        Record(GlTrace::GenBuffers, Names(n, buffers));
+    }
+
+    static void APIENTRY DeleteBuffers(GLsizei n, const GLuint* buffers) {
+        Record(GlTrace::DeleteBuffers, Names(n, buffers));
+        realDeleteBuffers(n, buffers);
+    }
+
+    static void APIENTRY GenTextures(GLsizei n, GLuint* textures) {
+        realGenTextures(n, textures);
+        Record(GlTrace::GenTextures, Names(n, textures));
+    }
+
+    static void APIENTRY DeleteTextures(GLsizei n, const GLuint* textures) {
+        Record(GlTrace::DeleteTextures, Names(n, textures));
+        realDeleteTextures(n, textures);
+    }
+
+    static void APIENTRY GenVertexArrays(GLsizei n, GLuint* arrays) {
+        realGenVertexArrays(n, arrays);
+        Record(GlTrace::GenVertexArrays, Names(n, arrays));
+    }
+
+    static void APIENTRY DeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+        Record(GlTrace::DeleteVertexArrays, Names(n, arrays));
+        realDeleteVertexArrays(n, arrays);
+    }
+
+    static void APIENTRY GenFramebuffers(GLsizei n, GLuint* framebuffers) {
+        realGenFramebuffers(n, framebuffers);
+        Record(GlTrace::GenFramebuffers, Names(n, framebuffers));
+    }
+
+    static void APIENTRY DeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+        Record(GlTrace::DeleteFramebuffers, Names(n, framebuffers));
+        realDeleteFramebuffers(n, framebuffers);
+    }
+
+    static void APIENTRY GenRenderbuffers(GLsizei n, GLuint* renderbuffers) {
+        realGenRenderbuffers(n, renderbuffers);
+        Record(GlTrace::GenRenderbuffers, Names(n, renderbuffers));
+    }
+
+    static void APIENTRY DeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) {
+        Record(GlTrace::DeleteRenderbuffers, Names(n, renderbuffers));
+        realDeleteRenderbuffers(n, renderbuffers);
+    }
+
+    static void APIENTRY GenQueries(GLsizei n, GLuint* ids) {
+        realGenQueries(n, ids);
+        Record(GlTrace::GenQueries, Names(n, ids));
+    }
+
+    static void APIENTRY DeleteQueries(GLsizei n, const GLuint* ids) {
+        Record(GlTrace::DeleteQueries, Names(n, ids));
+        realDeleteQueries(n, ids);
+    }
+
+    static GLuint APIENTRY CreateShader(GLenum type) {
+        const auto shader = realCreateShader(type);
+        Record(GlTrace::CreateShader, type, shader);
+        return shader;
+    }
+
+    static void APIENTRY DeleteShader(GLuint shader) {
+        Record(GlTrace::DeleteShader, shader);
+        realDeleteShader(shader);
+    }
+
+    static GLuint APIENTRY CreateProgram() {
+        const auto program = realCreateProgram();
+        Record(GlTrace::CreateProgram, program);
+        return program;
+    }
+
+    static void APIENTRY DeleteProgram(GLuint program) {
+        Record(GlTrace::DeleteProgram, program);
+        realDeleteProgram(program);
+    }
+
+    static GLsync APIENTRY FenceSync(GLenum condition, GLbitfield flags) {
+        const auto sync = realFenceSync(condition, flags);
+        Record(GlTrace::FenceSync, condition, flags, SyncId(sync));
+        return sync;
+    }
+
+    static void APIENTRY DeleteSync(GLsync sync) {
+        Record(GlTrace::DeleteSync, SyncId(sync));
+        realDeleteSync(sync);
+    }
+
+    static GLenum APIENTRY ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+        Record(GlTrace::ClientWaitSync, SyncId(sync), flags, timeout);
+        return realClientWaitSync(sync, flags, timeout);
+    }
+
+    static void APIENTRY ShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) {
+        // GL joins the strings anyway
+        std::string source;
+        for (GLsizei i = 0; i < count; ++i) {
+            if (length != nullptr && length[i] >= 0) {
+                source.append(string[i], length[i]);
+            }
+            else {
+                source.append(string[i]);
+            }
+        }
+        Record(GlTrace::ShaderSource, shader, Blob { source.data(), source.size() });
+        realShaderSource(shader, count, string, length);
+    }
+
+    static void APIENTRY CompileShader(GLuint shader) {
+        Record(GlTrace::CompileShader, shader);
+        realCompileShader(shader);
+    }
+
+    static void APIENTRY AttachShader(GLuint program, GLuint shader) {
+        Record(GlTrace::AttachShader, program, shader);
+        realAttachShader(program, shader);
+    }
+
+    static void APIENTRY LinkProgram(GLuint program) {
+        Record(GlTrace::LinkProgram, program);
+        realLinkProgram(program);
+    }
+
+    static void APIENTRY BindFragDataLocation(GLuint program, GLuint color, const GLchar* name) {
+        Record(GlTrace::BindFragDataLocation, program, color, String(name));
+        realBindFragDataLocation(program, color, name);
+    }
+
+    // Locations and indices can differ between drivers, so the replay looks
+    // them up again and translates the recorded ones
+    static GLint APIENTRY GetUniformLocation(GLuint program, const GLchar* name) {
+        const auto location = realGetUniformLocation(program, name);
+        Record(GlTrace::GetUniformLocation, program, location, String(name));
+        return location;
+    }
+
+    static GLuint APIENTRY GetUniformBlockIndex(GLuint program, const GLchar* name) {
+        const auto index = realGetUniformBlockIndex(program, name);
+        Record(GlTrace::GetUniformBlockIndex, program, index, String(name));
+        return index;
+    }
+
+    static GLint APIENTRY GetAttribLocation(GLuint program, const GLchar* name) {
+        const auto location = realGetAttribLocation(program, name);
+        Record(GlTrace::GetAttribLocation, program, location, String(name));
+        return location;
+    }
+
+    static void APIENTRY UniformBlockBinding(GLuint program, GLuint index, GLuint binding) {
+        Record(GlTrace::UniformBlockBinding, program, index, binding);
+        realUniformBlockBinding(program, index, binding);
+    }
+
+    static void APIENTRY UseProgram(GLuint program) {
+        Record(GlTrace::UseProgram, program);
+        realUseProgram(program);
+    }
+
+    static void APIENTRY Uniform1i(GLint location, GLint v0) {
+        Record(GlTrace::Uniform1i, location, v0);
+        realUniform1i(location, v0);
+    }
+
+    static void APIENTRY Uniform1f(GLint location, GLfloat v0) {
+        Record(GlTrace::Uniform1f, location, v0);
+        realUniform1f(location, v0);
+    }
+
+    static void APIENTRY Uniform2fv(GLint location, GLsizei count, const GLfloat* value) {
+        Record(GlTrace::Uniform2fv, location, Blob { value, count * 2 * sizeof(GLfloat) });
+        realUniform2fv(location, count, value);
+    }
+
+    static void APIENTRY Uniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+        Record(GlTrace::Uniform3fv, location, Blob { value, count * 3 * sizeof(GLfloat) });
+        realUniform3fv(location, count, value);
+    }
+
+    static void APIENTRY Uniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+        Record(GlTrace::Uniform4fv, location, Blob { value, count * 4 * sizeof(GLfloat) });
+        realUniform4fv(location, count, value);
+    }
+
+    static void APIENTRY UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+        Record(GlTrace::UniformMatrix4fv, location, transpose, Blob { value, count * 16 * sizeof(GLfloat) });
+        realUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    static void APIENTRY BindBuffer(GLenum target, GLuint buffer) {
+        if (target == GL_PIXEL_PACK_BUFFER) {
+            packBuffer = buffer;
+        }
+        Record(GlTrace::BindBuffer, target, buffer);
+        realBindBuffer(target, buffer);
+    }
+
+    static void APIENTRY BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+        Record(GlTrace::BindBufferRange, target, index, buffer, int64_t(offset), int64_t(size));
+        realBindBufferRange(target, index, buffer, offset, size);
+    }
+
+    static void APIENTRY BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+        Record(GlTrace::BufferData, target, int64_t(size), usage, uint8_t(data != nullptr), Blob { data, data != nullptr ? size_t(size) : 0 });
+        realBufferData(target, size, data, usage);
+    }
+
+    static void APIENTRY BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+        Record(GlTrace::BufferSubData, target, int64_t(offset), Blob { data, size_t(size) });
+        realBufferSubData(target, offset, size, data);
+    }
+
+    static void APIENTRY CopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) {
+        Record(GlTrace::CopyBufferSubData, readTarget, writeTarget, int64_t(readOffset), int64_t(writeOffset), int64_t(size));
+        realCopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size);
+    }
+
+    // What was written through a mapping is recorded when it's unmapped.
+    // Write-only mappings are shadowed, the engine writing to memory of ours
+    // that is copied to the mapping at unmap, so the trace holds exactly what
+    // ended up in the buffer. Whatever wasn't written is zero if the range was
+    // invalidated, where GL leaves it undefined anyway, and otherwise what the
+    // buffer held before.
+    static void* APIENTRY MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+        Record(GlTrace::MapBufferRange, target, int64_t(offset), int64_t(length), access);
+        auto& mapping = mappings[target];
+        mapping = { nullptr, length, access, {} };
+        const bool shadowed = (access & GL_MAP_WRITE_BIT) != 0 && (access & GL_MAP_READ_BIT) == 0;
+        if (shadowed) {
+            mapping.shadow.resize(size_t(length));
+            if ((access & (GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)) == 0) {
+                // Before mapping, as mapped buffers can't be read. Not recorded,
+                // as glGetBufferSubData isn't hooked.
+                glGetBufferSubData(target, offset, length, mapping.shadow.data());
+            }
+        }
+        mapping.pointer = realMapBufferRange(target, offset, length, access);
+        if (mapping.pointer == nullptr || !shadowed) {
+            mapping.shadow.clear();
+            return mapping.pointer;
+        }
+        return mapping.shadow.data();
+    }
+
+    static GLboolean APIENTRY UnmapBuffer(GLenum target) {
+        const auto it = mappings.find(target);
+        if (it != mappings.end() && !it->second.shadow.empty()) {
+            const auto& mapping = it->second;
+            memcpy(mapping.pointer, mapping.shadow.data(), mapping.shadow.size());
+            if ((mapping.access & GL_MAP_FLUSH_EXPLICIT_BIT) != 0) {
+                glFlushMappedBufferRange(target, 0, mapping.length);
+            }
+            Record(GlTrace::UnmapBuffer, target, Blob { mapping.shadow.data(), mapping.shadow.size() });
+        }
+        else if (it != mappings.end() && it->second.pointer != nullptr && (it->second.access & GL_MAP_WRITE_BIT) != 0) {
+            Record(GlTrace::UnmapBuffer, target, Blob { it->second.pointer, size_t(it->second.length) });
+        }
+        else {
+            Record(GlTrace::UnmapBuffer, target, Blob { nullptr, 0 });
+        }
+        if (it != mappings.end()) {
+            mappings.erase(it);
+        }
+        return realUnmapBuffer(target);
+    }
+
+    static void APIENTRY TexBuffer(GLenum target, GLenum internalformat, GLuint buffer) {
+        Record(GlTrace::TexBuffer, target, internalformat, buffer);
+        realTexBuffer(target, internalformat, buffer);
+    }
+
+    static void APIENTRY BindVertexArray(GLuint array) {
+        Record(GlTrace::BindVertexArray, array);
+        realBindVertexArray(array);
+    }
+
+    static void APIENTRY EnableVertexAttribArray(GLuint index) {
+        Record(GlTrace::EnableVertexAttribArray, index);
+        realEnableVertexAttribArray(index);
+    }
+
+    static void APIENTRY VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) {
+        Record(GlTrace::VertexAttribPointer, index, size, type, normalized, stride, Offset(pointer));
+        realVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    }
+
+    static void APIENTRY VertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer) {
+        Record(GlTrace::VertexAttribIPointer, index, size, type, stride, Offset(pointer));
+        realVertexAttribIPointer(index, size, type, stride, pointer);
+    }
+
+    static void APIENTRY VertexAttribDivisor(GLuint index, GLuint divisor) {
+        Record(GlTrace::VertexAttribDivisor, index, divisor);
+        realVertexAttribDivisor(index, divisor);
+    }
+
+    static void APIENTRY ActiveTexture(GLenum texture) {
+        Record(GlTrace::ActiveTexture, texture);
+        realActiveTexture(texture);
+    }
+
+    static void APIENTRY BindTexture(GLenum target, GLuint texture) {
+        Record(GlTrace::BindTexture, target, texture);
+        realBindTexture(target, texture);
+    }
+
+    static void APIENTRY TexImage2D(
+        GLenum target,
+        GLint level,
+        GLint internalformat,
+        GLsizei width,
+        GLsizei height,
+        GLint border,
+        GLenum format,
+        GLenum type,
+        const void* pixels
+    ) {
+        size_t size = 0;
+        if (pixels != nullptr) {
+            const auto alignment = static_cast<size_t>(unpackAlignment);
+            const auto rowSize = (width * GetPixelSize(format, type) + alignment - 1) / alignment * alignment;
+            size = rowSize * height;
+        }
+        Record(
+            GlTrace::TexImage2D,
+            target,
+            level,
+            internalformat,
+            width,
+            height,
+            border,
+            format,
+            type,
+            uint8_t(pixels != nullptr),
+            Blob { pixels, size }
+        );
+        realTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+    }
+
+    static void APIENTRY TexParameteri(GLenum target, GLenum pname, GLint param) {
+        Record(GlTrace::TexParameteri, target, pname, param);
+        realTexParameteri(target, pname, param);
+    }
+
+    static void APIENTRY TexParameterfv(GLenum target, GLenum pname, const GLfloat* params) {
+        const size_t count = pname == GL_TEXTURE_BORDER_COLOR ? 4 : 1;
+        Record(GlTrace::TexParameterfv, target, pname, Blob { params, count * sizeof(GLfloat) });
+        realTexParameterfv(target, pname, params);
+    }
+
+    static void APIENTRY PixelStorei(GLenum pname, GLint param) {
+        if (pname == GL_UNPACK_ALIGNMENT) {
+            unpackAlignment = param;
+        }
+        Record(GlTrace::PixelStorei, pname, param);
+        realPixelStorei(pname, param);
+    }
+
+    static void APIENTRY BindFramebuffer(GLenum target, GLuint framebuffer) {
+        Record(GlTrace::BindFramebuffer, target, framebuffer);
+        realBindFramebuffer(target, framebuffer);
+    }
+
+    static void APIENTRY FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) {
+        Record(GlTrace::FramebufferTexture2D, target, attachment, textarget, texture, level);
+        realFramebufferTexture2D(target, attachment, textarget, texture, level);
+    }
+
+    static void APIENTRY FramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) {
+        Record(GlTrace::FramebufferRenderbuffer, target, attachment, renderbuffertarget, renderbuffer);
+        realFramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer);
+    }
+
+    static void APIENTRY BindRenderbuffer(GLenum target, GLuint renderbuffer) {
+        Record(GlTrace::BindRenderbuffer, target, renderbuffer);
+        realBindRenderbuffer(target, renderbuffer);
+    }
+
+    static void APIENTRY RenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) {
+        Record(GlTrace::RenderbufferStorage, target, internalformat, width, height);
+        realRenderbufferStorage(target, internalformat, width, height);
+    }
+
+    static void APIENTRY DrawBuffer(GLenum buf) {
+        Record(GlTrace::DrawBuffer, buf);
+        realDrawBuffer(buf);
+    }
+
+    static void APIENTRY DrawBuffers(GLsizei n, const GLenum* bufs) {
+        Record(GlTrace::DrawBuffers, Blob { bufs, n * sizeof(GLenum) });
+        realDrawBuffers(n, bufs);
+    }
+
+    static void APIENTRY ReadBuffer(GLenum src) {
+        Record(GlTrace::ReadBuffer, src);
+        realReadBuffer(src);
+    }
+
+    static void APIENTRY BlitFramebuffer(
+        GLint srcX0,
+        GLint srcY0,
+        GLint srcX1,
+        GLint srcY1,
+        GLint dstX0,
+        GLint dstY0,
+        GLint dstX1,
+        GLint dstY1,
+        GLbitfield mask,
+        GLenum filter
+    ) {
+        Record(GlTrace::BlitFramebuffer, srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+        realBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    }
+
+    // Reads into client memory are replayed into memory of the replay's own
+    static void APIENTRY ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) {
+        Record(GlTrace::ReadPixels, x, y, width, height, format, type, uint8_t(packBuffer != 0), packBuffer != 0 ? Offset(pixels) : 0);
+        realReadPixels(x, y, width, height, format, type, pixels);
+    }
+
+    static void APIENTRY Enable(GLenum cap) {
+        Record(GlTrace::Enable, cap);
+        realEnable(cap);
+    }
+
+    static void APIENTRY Disable(GLenum cap) {
+        Record(GlTrace::Disable, cap);
+        realDisable(cap);
+    }
+
+    static void APIENTRY DepthFunc(GLenum func) {
+        Record(GlTrace::DepthFunc, func);
+        realDepthFunc(func);
+    }
+
+    static void APIENTRY Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        Record(GlTrace::Viewport, x, y, width, height);
+        realViewport(x, y, width, height);
+    }
+
+    static void APIENTRY ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) {
+        Record(GlTrace::ClearColor, red, green, blue, alpha);
+        realClearColor(red, green, blue, alpha);
+    }
+
+    static void APIENTRY Clear(GLbitfield mask) {
+        Record(GlTrace::Clear, mask);
+        realClear(mask);
+    }
+
+    static void APIENTRY DrawArrays(GLenum mode, GLint first, GLsizei count) {
+        Record(GlTrace::DrawArrays, mode, first, count);
+        realDrawArrays(mode, first, count);
+    }
+
+    static void APIENTRY DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+        Record(GlTrace::DrawElements, mode, count, type, Offset(indices));
+        realDrawElements(mode, count, type, indices);
+    }
+
+    static void APIENTRY MultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride) {
+        Record(GlTrace::MultiDrawElementsIndirect, mode, type, Offset(indirect), drawcount, stride);
+        realMultiDrawElementsIndirect(mode, type, indirect, drawcount, stride);
+    }
+
+    static void APIENTRY QueryCounter(GLuint id, GLenum target) {
+        Record(GlTrace::QueryCounter, id, target);
+        realQueryCounter(id, target);
+    }
+
+    static void APIENTRY BeginQuery(GLenum target, GLuint id) {
+        Record(GlTrace::BeginQuery, target, id);
+        realBeginQuery(target, id);
+    }
+
+    static void APIENTRY EndQuery(GLenum target) {
+        Record(GlTrace::EndQuery, target);
+        realEndQuery(target);
+    }
+
+    static void APIENTRY Finish() {
+        Record(GlTrace::Finish);
+        realFinish();
+    }
+};
+
+void GlTrace::Open(const std::filesystem::path& path, int numFrames) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not write GL trace \"" + path.string() + "\"");
+    }
+    numFramesToRecord = numFrames;
+    opened = true;
+}
+
+// Entry points the context doesn't have stay null
+#define HOOK(name)                             \
+    if (glad_gl##name != nullptr) {            \
+        real##name = glad_gl##name;            \
+        glad_gl##name = GlTrace::Hooks::name;  \
+    }
+
+void GlTrace::Install(const glm::uvec2& framebufferSize) {
+    if (!opened || recording) {
+        return;
+    }
+    header.width = framebufferSize.x;
+    header.height = framebufferSize.y;
+
+    FOR_EACH_HOOK(HOOK)
+    glad_glBufferStorage = nullptr;
+    recording = true;
+}
+
+void GlTrace::MarkEndOfFrame() {
+    if (!recording) {
+        return;
+    }
+    Record(EndFrame);
+    ++header.numFrames;
+    if (header.numFrames >= static_cast<uint32_t>(numFramesToRecord)) {
+        Write();
+    }
+}
+
+void GlTrace::Close() {
+    if (recording) {
+        Write();
+    }
+}
+
+bool GlTrace::IsRecording() {
+    return recording;
+}
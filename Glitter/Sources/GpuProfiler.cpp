@@ -0,0 +1,74 @@
+#include <algorithm>
+
+#include "GpuProfiler.hpp"
+#include "GpuTimer.hpp"
+
+GpuProfiler::GpuProfiler() {
+}
+
+GpuProfiler::~GpuProfiler() {
+}
+
+void GpuProfiler::BeginFrame() {
+    for (auto& [label, scope] : scopes) {
+        const auto numResults = scope.timer->GetNumResults();
+        if (numResults == scope.numResults) {
+            continue;
+        }
+        scope.numResults = numResults;
+
+        const auto sample = scope.timer->GetLastMilliseconds();
+        if (scope.history.size() < kHistorySize) {
+            scope.history.push_back(sample);
+        }
+        else {
+            scope.history[scope.next] = sample;
+            scope.next = (scope.next + 1) % kHistorySize;
+        }
+    }
+
+    lastOrder.swap(order);
+    order.clear();
+    stack.clear();
+}
+
+void GpuProfiler::Begin(const std::string& label) {
+    auto& scope = scopes[label];
+    if (scope.timer == nullptr) {
+        scope.timer = std::make_unique<GpuTimer>(GpuTimer::Timestamps);
+    }
+    scope.depth = static_cast<int>(stack.size());
+    stack.push_back(&scope);
+    order.push_back(label);
+    scope.timer->Begin();
+}
+
+void GpuProfiler::End() {
+    stack.back()->timer->End();
+    stack.pop_back();
+}
+
+std::vector<GpuProfiler::Timing> GpuProfiler::GetTimings() const {
+    std::vector<Timing> timings;
+    for (const auto& label : lastOrder) {
+        const auto& scope = scopes.at(label);
+
+        Timing timing;
+        timing.label = label;
+        timing.depth = scope.depth;
+        timing.history.reserve(scope.history.size());
+        for (size_t i = 0; i < scope.history.size(); ++i) {
+            timing.history.push_back(scope.history[(scope.next + i) % scope.history.size()]);
+        }
+        if (!timing.history.empty()) {
+            float sum = 0.f;
+            for (auto sample : timing.history) {
+                sum += sample;
+            }
+            timing.averageMilliseconds = sum / timing.history.size();
+            timing.maxMilliseconds = *std::max_element(timing.history.begin(), timing.history.end());
+        }
+        timings.push_back(std::move(timing));
+    }
+    return timings;
+}
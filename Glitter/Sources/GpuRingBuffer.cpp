@@ -0,0 +1,177 @@
+#include <algorithm>
+
+#include "GpuRingBuffer.hpp"
+
+static const GLuint64 kFenceTimeout = 1000000000; // 1s in nanoseconds
+
+GpuRingBuffer::GpuRingBuffer(GLenum target, GLsizeiptr regionSize, GLenum alignment)
+    : target(target), regionSize(regionSize) {
+    glGetIntegerv(alignment, &this->alignment);
+    if (this->alignment < 1) {
+        this->alignment = 1;
+    }
+
+    if (GLAD_GL_VERSION_4_4 && glBufferStorage != nullptr) {
+        mode = Persistent;
+    }
+    else {
+        mode = Unsynchronized;
+    }
+
+    CreateBuffer();
+}
+
+GpuRingBuffer::~GpuRingBuffer() {
+    DeleteBuffer();
+}
+
+void GpuRingBuffer::CreateBuffer() {
+    const auto bufferSize = mode == Orphaning ? regionSize : regionSize * kNumRegions;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+
+    if (mode == Persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, bufferSize, nullptr, flags);
+        persistentData = (uint8_t*)glMapBufferRange(target, 0, bufferSize, flags);
+        if (persistentData == nullptr) {
+            DeleteBuffer();
+            mode = Unsynchronized;
+            CreateBuffer();
+        }
+        return;
+    }
+
+    glBufferData(target, bufferSize, nullptr, GL_STREAM_DRAW);
+}
+
+void GpuRingBuffer::DeleteBuffer() {
+    for (auto& fence : fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    if (buffer == 0) {
+        return;
+    }
+    if (persistentData != nullptr || regionData != nullptr) {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        persistentData = nullptr;
+        regionData = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void GpuRingBuffer::WaitForRegion(unsigned int index) {
+    auto& fence = fences[index];
+    if (fence == nullptr) {
+        return;
+    }
+
+    // With three regions the fence has normally long since signalled
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        ++numStalls;
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeout) == GL_TIMEOUT_EXPIRED) {
+        }
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void GpuRingBuffer::BeginFrame() {
+    if (overflowed) {
+        // Didn't fit, start again with a buffer big enough for what was asked
+        for (unsigned int i = 0; i < kNumRegions; ++i) {
+            WaitForRegion(i);
+        }
+        DeleteBuffer();
+        regionSize = std::max(regionSize * 2, used.load());
+        CreateBuffer();
+        region = 0;
+        overflowed = false;
+    }
+    else if (mode != Orphaning) {
+        region = (region + 1) % kNumRegions;
+    }
+
+    WaitForRegion(region);
+    used = 0;
+
+    glBindBuffer(target, buffer);
+    switch (mode) {
+    case Persistent:
+        regionData = persistentData + region * regionSize;
+        break;
+    case Unsynchronized:
+        regionData = (uint8_t*)glMapBufferRange(
+            target,
+            region * regionSize,
+            regionSize,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+        );
+        if (regionData != nullptr) {
+            break;
+        }
+        DeleteBuffer();
+        mode = Orphaning;
+        region = 0;
+        CreateBuffer();
+        [[fallthrough]];
+    case Orphaning:
+        glBufferData(target, regionSize, nullptr, GL_STREAM_DRAW);
+        regionData = (uint8_t*)glMapBufferRange(
+            target,
+            0,
+            regionSize,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+        );
+        break;
+    }
+}
+
+GpuRingBuffer::Allocation GpuRingBuffer::Allocate(GLsizeiptr size, GLsizeiptr minAlignment) {
+    const auto align = std::max<GLsizeiptr>(alignment, minAlignment);
+    auto end = used.load();
+    GLsizeiptr offset;
+    do {
+        offset = (end + align - 1) / align * align;
+    } while (!used.compare_exchange_weak(end, offset + size));
+
+    if (offset + size > regionSize) {
+        overflowed = true;
+        return Allocation();
+    }
+    if (regionData == nullptr) {
+        // Mapping failed, growing wouldn't help
+        return Allocation();
+    }
+
+    Allocation allocation;
+    allocation.data = regionData + offset;
+    allocation.offset = region * regionSize + offset;
+    allocation.size = size;
+    return allocation;
+}
+
+bool GpuRingBuffer::Flush() {
+    if (regionData != nullptr) {
+        if (mode != Persistent) {
+            glBindBuffer(target, buffer);
+            glUnmapBuffer(target);
+        }
+        regionData = nullptr;
+    }
+    return !overflowed;
+}
+
+void GpuRingBuffer::EndFrame() {
+    if (mode == Orphaning) {
+        return;
+    }
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,83 @@
+#include "GpuTimer.hpp"
+
+static const float kSmoothing = 0.1f;
+
+GpuTimer::GpuTimer(Mode mode) : mode(mode) {
+    if (GLAD_GL_VERSION_3_3) {
+        glGenQueries(kNumQueries, queries.data());
+        if (mode == Timestamps) {
+            glGenQueries(kNumQueries, endQueries.data());
+        }
+    }
+}
+
+GpuTimer::~GpuTimer() {
+    if (queries[0] != 0) {
+        glDeleteQueries(kNumQueries, queries.data());
+    }
+    if (endQueries[0] != 0) {
+        glDeleteQueries(kNumQueries, endQueries.data());
+    }
+}
+
+void GpuTimer::Begin() {
+    if (queries[0] == 0) {
+        return;
+    }
+    ReadResults();
+    if (pending[current]) {
+        // Every query is still in flight, skip this measurement
+        return;
+    }
+    if (mode == Timestamps) {
+        glQueryCounter(queries[current], GL_TIMESTAMP);
+    }
+    else {
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+}
+
+void GpuTimer::End() {
+    if (queries[0] == 0 || pending[current]) {
+        return;
+    }
+    if (mode == Timestamps) {
+        glQueryCounter(endQueries[current], GL_TIMESTAMP);
+    }
+    else {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    pending[current] = true;
+    current = (current + 1) % kNumQueries;
+}
+
+void GpuTimer::ReadResults() {
+    // Oldest first, as results become available in submission order
+    for (unsigned int i = 1; i <= kNumQueries; ++i) {
+        const auto index = (current + i) % kNumQueries;
+        if (!pending[index]) {
+            continue;
+        }
+
+        const auto last = mode == Timestamps ? endQueries[index] : queries[index];
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE) {
+            return;
+        }
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(last, GL_QUERY_RESULT, &nanoseconds);
+        if (mode == Timestamps) {
+            GLuint64 start = 0;
+            glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &start);
+            nanoseconds -= start;
+        }
+        pending[index] = false;
+
+        const auto sample = nanoseconds / 1e6f;
+        lastMilliseconds = sample;
+        ++numResults;
+        milliseconds = milliseconds == 0.f ? sample : milliseconds + (sample - milliseconds) * kSmoothing;
+    }
+}
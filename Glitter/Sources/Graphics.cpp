@@ -1,22 +1,47 @@
 #include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <ctime>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <imgui.h>
 #include <iostream>
+#include <optional>
+#include <random>
 #include <stdexcept>
 #include <stb_image.h>
 #include <iostream>
 
 #include "ArcCamera.hpp"
+#include "CommandList.hpp"
+#include "CpuProfiler.hpp"
 #include "CubePrimitiveMesh.hpp"
 #include "Drawable.hpp"
+#include "DynamicResolution.hpp"
 #include "Graphics.hpp"
 #include "FileMesh.hpp"
+#include "FrameCapture.hpp"
+#include "FrameGraph.hpp"
+#include "GlStats.hpp"
+#include "GlTrace.hpp"
+#include "GpuProfiler.hpp"
+#include "GpuRingBuffer.hpp"
+#include "GpuTimer.hpp"
+#include "IndirectRenderer.hpp"
+#include "OcclusionCuller.hpp"
+#include "LightClusters.hpp"
+#include "PostProcessStack.hpp"
 #include "PlanePrimitiveMesh.hpp"
+#include "Scene.hpp"
 #include "Shader.hpp"
+#include "ShadowMapCache.hpp"
 #include "Texture2D.hpp"
+#include "TripleBuffer.hpp"
+#include "ThreadPool.hpp"
 #include "Timer.hpp"
+#include "TransformSystem.hpp"
+#include "UniformBlocks.hpp"
 
 using namespace glm;
 
@@ -88,6 +113,19 @@ struct Light {
     float constant, linear, quadratic;
 };
 
+// Gives the shader a variant with the given vertex shader for the multi-draw
+// indirect path, when the context supports it.
+static void AddIndirectVariant(Shader& shader, const std::filesystem::path& vertexShader, const std::filesystem::path& fragmentShader) {
+    if (!IndirectRenderer::IsSupported()) {
+        return;
+    }
+    auto variant = std::make_shared<Shader>();
+    variant->AttachShader(vertexShader);
+    variant->AttachShader(fragmentShader);
+    variant->Link();
+    shader.SetIndirectVariant(variant);
+}
+
 static void SetMat(Shader& shader, const Material& mat) {
     shader.SetUniform("material.ambient", mat.ambient);
     shader.SetUniform("material.diffuse", mat.diffuse);
@@ -95,7 +133,7 @@ static void SetMat(Shader& shader, const Material& mat) {
     shader.SetUniform("material.shininess", mat.shininess);
 }
 
-static void SetLight(Shader& shader, const Light& light, const mat4& lightSpaceMatrix, float penumbraSize) {
+static void SetLight(Shader& shader, const Light& light, const mat4& lightSpaceMatrix, float penumbraSize, bool prefilteredShadows) {
     shader.SetUniform("light.position", light.position);
     shader.SetUniform("light.direction", light.direction);
     shader.SetUniform("light.cutOff", light.cutOff);
@@ -108,21 +146,145 @@ static void SetLight(Shader& shader, const Light& light, const mat4& lightSpaceM
     shader.SetUniform("light.quadratic", light.quadratic);
     shader.SetUniform("lightSpaceMatrix", lightSpaceMatrix);
     shader.SetUniform("penumbraSize", penumbraSize);
+    shader.SetUniform("prefilteredShadows", prefilteredShadows ? 1 : 0);
 }
 
 static const unsigned int SHADOW_WIDTH = 512, SHADOW_HEIGHT = 512;
 
+// Prefiltered shadow moments are blurred and sampled at this fraction of the shadow map size
+static const unsigned int kShadowBlurDownscale = 2;
+static const int kMaxShadowBlurTaps = 16; // must match maxTaps in separable-blur.frag
+
+// evsm-moments.frag output for the far plane, with the exponents used there
+static const vec4 kEvsmClearMoments = vec4(exp(40.f), exp(80.f), -exp(-5.f), exp(-10.f));
+
+// Starting size of each frame's share of the uniform ring buffer, it grows if a frame needs more
+static const GLsizeiptr kUniformRingRegionSize = 64 * 1024;
+
 static const float kCameraDistance = 2.f;
 static const float kMouseSensitivity = 0.01f;
 static const float kAmbientFactor = 0.2f;
 
+static const int kMaxClusteredLights = 1024;
+static const int kBenchmarkClusteredLights = 512;
+
 static const ImGuiColorEditFlags ColorEditFlags = ImGuiColorEditFlags_PickerHueWheel;
 
+enum PresentMode {
+    // Without post effects, the scene pass draws to the back buffer itself
+    PresentDirect,
+    PresentBlit,
+    PresentQuad
+};
+
+// What the GUI changes about how frames are drawn. Edited on the Update side
+// and copied into every frame.
+struct RenderSettings {
+    bool animateScene = true;
+    bool useIndirect = true;
+    // The shadow pass reads positions only, unless turned off for comparison
+    bool usePositionStream = true;
+    int shadowUpdateInterval = 1;
+    bool alwaysUpdateShadows = false;
+    // Bumped for changes the shadow map cache can't see
+    unsigned int shadowInvalidations = 0;
+
+    int presentMode = PresentDirect;
+    bool dynamicResolution = true;
+    float resolutionBudget = 0.f;
+    float minResolutionScale = 0.f;
+    // Only used while dynamicResolution is off
+    float resolutionScale = 1.f;
+    float upscaleSharpness = 0.25f;
+    bool useOcclusionCulling = true;
+
+    std::vector<PostProcessStack::Effect> effects;
+    // Bumped when effects are enabled, reordered or change resolution
+    unsigned int effectsVersion = 0;
+
+    bool recording = false;
+    FrameCapture::Format captureFormat = FrameCapture::Png;
+    std::filesystem::path captureDirectory;
+};
+
+// Measurements the Render side hands back for the GUI.
+struct RenderStats {
+    float shadowMilliseconds = 0.f;
+    float frameMilliseconds = 0.f;
+    GpuRingBuffer::Mode ringMode = GpuRingBuffer::Persistent;
+    GLsizeiptr ringRegionSize = 0;
+    unsigned int ringStalls = 0;
+    unsigned int shadowUpdates = 0, shadowSkips = 0;
+    FrameGraph::Stats graph;
+    std::vector<std::string> schedule;
+    uvec2 renderSize = uvec2(0);
+    float resolutionScale = 1.f;
+    unsigned int resolutionChanges = 0;
+    OcclusionCuller::Stats occlusion;
+    LightClusters::Stats clusters;
+    std::vector<PostProcessStack::Timing> postProcessTimings;
+    std::vector<GpuProfiler::Timing> passTimings;
+    FrameCapture::Stats capture;
+    GlStats::Frame api;
+    GlStats::Memory memory;
+};
+
+struct Graphics::Frame::Data {
+    float time = 0.f;
+    uvec2 framebufferSize = uvec2(0);
+    mat4 cameraView = mat4(1.f), cameraProj = mat4(1.f);
+    mat4 lightView = mat4(1.f), lightProjection = mat4(1.f), lightSpaceMatrix = mat4(1.f);
+    Light light = {};
+    float penumbraSize = 0.f;
+    bool prefilteredShadows = false;
+    TransformSystem transforms;
+    std::vector<ClusteredLight> clusteredLights;
+    RenderSettings settings;
+};
+
+Graphics::Frame::Frame() : data(std::make_unique<Data>()) {
+}
+
+Graphics::Frame::~Frame() {
+}
+
+// State is split between the two halves of a frame. The scene, camera, GUI
+// and settings belong to Update. GL objects and everything measured while
+// drawing belong to Render, which only sees the rest through the Frame it is
+// given and reports back through renderStats.
 struct Graphics::CheshireCat {
     std::unique_ptr<Timer> timer;
-    std::vector<std::shared_ptr<Drawable>> characterDrawables;
-    std::unique_ptr<Drawable> floor;
-    std::unique_ptr<Drawable> pointLightDrawable;
+    // Only advances while the scene is animating
+    float sceneTime = 0.f;
+    std::atomic<bool> redrawRequested = true;
+    std::unique_ptr<ThreadPool> threadPool;
+
+    Scene scene;
+    Scene::NodeHandle pointLightNode = 0, characterNode = 0, floorNode = 0;
+    TransformSystem::View lightViewTransforms, cameraViewTransforms;
+
+    // Everything drawn by DrawFirstPass. Recorded in parallel into one command
+    // list per thread, or into multi-draw indirect batches when the context
+    // supports them, with command lists for whatever can't be batched.
+    struct RecordedPass {
+        std::vector<CommandList> commandLists;
+        IndirectPass indirect;
+        bool useIndirect = false;
+        std::vector<Renderable> notBatched;
+    };
+
+    // Renderables hidden behind the character or under the floor are left
+    // out of the scene pass. Occludee i is the scene's renderable i.
+    OcclusionCuller occlusionCuller;
+    std::vector<Renderable> visibleRenderables;
+    RecordedPass depthPass, scenePass;
+    std::unique_ptr<GpuRingBuffer> uniformRing;
+    std::unique_ptr<IndirectRenderer> indirectRenderer;
+    std::unique_ptr<GpuTimer> shadowTimer;
+
+    // The shadow map is only redrawn when the light or a caster has moved
+    ShadowMapCache shadowMapCache;
+    unsigned int appliedShadowInvalidations = 0;
 
     std::shared_ptr<Shader> pointLightShader;
     std::vector<std::shared_ptr<Shader>> sceneShaders;
@@ -156,15 +318,46 @@ struct Graphics::CheshireCat {
     };
     mat4 lightMat = mat4(1), lightSpaceMatrix = mat4(1);
 
-    GLuint depthMapFBO = 0;
+    // Shadowless lights circling the scene, shaded through light clusters
+    struct LightOrbit {
+        float radius, angle, height, speed;
+    };
+    std::vector<ClusteredLight> clusteredLights;
+    std::vector<LightOrbit> lightOrbits;
+    std::unique_ptr<LightClusters> lightClusters;
+    int numClusteredLights = 0;
+
     std::shared_ptr<Texture2D> depthMap;
     std::shared_ptr<Shader> depthShader;
     float penumbraSize = 500.f;
 
-    GLuint fbo = 0, rbo = 0, quadVAO = 0, quadVBO = 0;
-    std::shared_ptr<Texture2D> renderTexture = 0;
+    // Prefiltered (EVSM) shadows: the depth pass also writes moments, which
+    // are blurred once per shadow update instead of filtered per fragment
+    bool prefilteredShadows = true;
+    std::shared_ptr<Texture2D> momentsBlurred;
+    std::shared_ptr<Shader> momentsShader;
+    std::unique_ptr<Shader> momentsBlurShader;
 
-    std::unique_ptr<Shader> screenShader;
+    GLuint quadVAO = 0, quadVBO = 0;
+    std::unique_ptr<Shader> presentShader;
+
+    // Rebuilt every frame. Everything but the shadow maps and the back buffer
+    // is a transient target that the graph allocates and aliases.
+    FrameGraph frameGraph;
+
+    // The scene is rendered at a fraction of the window to stay within a GPU
+    // frame budget, then upscaled by the present shader
+    DynamicResolution dynamicResolution;
+    std::unique_ptr<GpuTimer> frameTimer;
+    // Every pass of the frame graph, and whatever else is drawn after it
+    std::unique_ptr<GpuProfiler> gpuProfiler;
+    Graphics::Counters counters;
+
+    std::unique_ptr<PostProcessStack> postProcess;
+    unsigned int appliedEffectsVersion = 0;
+
+    // Records what the back buffer holds before the GUI is drawn over it
+    std::unique_ptr<FrameCapture> frameCapture;
 
     std::shared_ptr<Texture2D> skyboxTexture;
     std::unique_ptr<Shader> skyboxShader;
@@ -172,20 +365,24 @@ struct Graphics::CheshireCat {
 
     std::string error;
 
+    // Headless rendering draws no GUI and renders into a framebuffer of its own
+    bool guiEnabled = true;
+    GLuint targetFramebuffer = 0;
+
+    RenderSettings settings;
+    TripleBuffer<RenderStats> renderStats;
+    int captureFormat = FrameCapture::Png;
+
+    // The frame Render is drawing, valid during Render only
+    const Frame::Data* frame = nullptr;
+    // For Draw, which runs both halves on one thread
+    Frame drawFrame;
+
     CheshireCat() 
         : camera(cameraCentre, kCameraDistance, 0.2f, 0.2f) {
     }
 
     ~CheshireCat() {
-        if (depthMapFBO != 0) {
-            glDeleteFramebuffers(1, &depthMapFBO);
-        }
-        if (fbo != 0) {
-            glDeleteFramebuffers(1, &fbo);
-        }
-        if (rbo != 0) {
-            glDeleteRenderbuffers(1, &rbo);
-        }
         if (quadVAO != 0) {
             glDeleteBuffers(1, &quadVAO);
         }
@@ -230,9 +427,8 @@ struct Graphics::CheshireCat {
     }
 
     void InitDepthBuffer() {
+        GlStats::MemoryScope memoryScope(GlStats::Framebuffers);
         // Setup depth map
-        glGenFramebuffers(1, &depthMapFBO);
-
         depthMap = std::make_shared<Texture2D>(
             uvec2(SHADOW_WIDTH, SHADOW_HEIGHT),
             Texture2D::LinearSpace,
@@ -244,23 +440,194 @@ struct Graphics::CheshireCat {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_GREATER);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
 
-
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glFramebufferTexture2D(
-            GL_FRAMEBUFFER,
-            GL_DEPTH_ATTACHMENT,
-            GL_TEXTURE_2D,
-            depthMap->Get(),
-            0
-        );
-        glDrawBuffer(GL_NONE);
-        glReadBuffer(GL_NONE);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
         depthShader = std::make_shared<Shader>();
         depthShader->AttachShader("depth.vert");
         depthShader->AttachShader("depth.frag");
         depthShader->Link();
+        AddIndirectVariant(*depthShader, "depth-indirect.vert", "depth.frag");
+
+        InitShadowMoments();
+    }
+
+    void InitShadowMoments() {
+        // The raw moments and the first blur direction are transients in the
+        // frame graph. Only the result has to survive frames the shadow cache skips.
+        momentsBlurred = std::make_shared<Texture2D>(
+            uvec2(SHADOW_WIDTH, SHADOW_HEIGHT) / kShadowBlurDownscale,
+            Texture2D::LinearSpace,
+            Texture2D::RGBA,
+            Texture2D::Float);
+        momentsBlurred->SetFiltering(Texture2D::Linear);
+        momentsBlurred->SetWrapMode(Texture2D::ClampToBorder);
+        momentsBlurred->SetBorder(kEvsmClearMoments);
+
+        momentsShader = std::make_shared<Shader>();
+        momentsShader->AttachShader("depth.vert");
+        momentsShader->AttachShader("evsm-moments.frag");
+        momentsShader->Link();
+        AddIndirectVariant(*momentsShader, "depth-indirect.vert", "evsm-moments.frag");
+
+        momentsBlurShader = std::make_unique<Shader>();
+        momentsBlurShader->AttachShader("framebuffer-display.vert");
+        momentsBlurShader->AttachShader("separable-blur.frag");
+        momentsBlurShader->Link();
+        momentsBlurShader->SetUniform("screenTexture", 0);
+    }
+
+    // Draws the depth pass into the shadow map, and for prefiltered shadows
+    // also its moments, which then get a separable Gaussian at reduced
+    // resolution. The radius matches the spread of the PCF kernel for the
+    // same penumbraSize.
+    void AddShadowPasses(FrameGraph::Resource shadowMap, FrameGraph::Resource blurredMoments) {
+        const auto shadowSize = uvec2(SHADOW_WIDTH, SHADOW_HEIGHT);
+        if (!frame->prefilteredShadows) {
+            frameGraph.AddPass("Shadow depth",
+                [&](FrameGraph::Builder& builder) {
+                    builder.Write(shadowMap);
+                },
+                [this](const FrameGraph::Context& context) {
+                    shadowTimer->Begin();
+                    context.BindFramebuffer();
+                    glEnable(GL_DEPTH_TEST);
+                    glClear(GL_DEPTH_BUFFER_BIT);
+                    DrawFirstPass(depthPass);
+                    shadowTimer->End();
+                });
+            return;
+        }
+
+        FrameGraph::TextureDesc momentsDesc;
+        momentsDesc.size = shadowSize;
+        momentsDesc.internalFormat = GL_RGBA32F;
+        FrameGraph::Resource moments = 0;
+        frameGraph.AddPass("Shadow moments",
+            [&](FrameGraph::Builder& builder) {
+                moments = builder.Create("Shadow moments", momentsDesc);
+                builder.Write(moments);
+                builder.Write(shadowMap);
+            },
+            [this](const FrameGraph::Context& context) {
+                shadowTimer->Begin();
+                context.BindFramebuffer();
+                glEnable(GL_DEPTH_TEST);
+                glClearColor(kEvsmClearMoments.x, kEvsmClearMoments.y, kEvsmClearMoments.z, kEvsmClearMoments.w);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                DrawFirstPass(depthPass);
+            });
+
+        const auto blurSize = vec2(shadowSize / kShadowBlurDownscale);
+        const auto radius = blurSize.x / frame->penumbraSize;
+        const auto numTaps = clamp((int)ceil(radius), 1, kMaxShadowBlurTaps);
+        const auto tapTexels = radius / numTaps;
+        auto blurExecute = [this, numTaps](FrameGraph::Resource input, vec2 tapStep, bool last) {
+            return [this, numTaps, input, tapStep, last](const FrameGraph::Context& context) {
+                context.BindFramebuffer();
+                glDisable(GL_DEPTH_TEST);
+                momentsBlurShader->Activate();
+                momentsBlurShader->SetUniform("numTaps", numTaps);
+                momentsBlurShader->SetUniform("sigma", numTaps / 2.f);
+                momentsBlurShader->SetUniform("tapStep", tapStep);
+                glBindVertexArray(quadVAO);
+                glActiveTexture(GL_TEXTURE0);
+                Texture2D::BindTexture(context.GetTexture(input));
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                if (last) {
+                    shadowTimer->End();
+                }
+            };
+        };
+
+        FrameGraph::TextureDesc blurDesc;
+        blurDesc.size = uvec2(blurSize);
+        blurDesc.internalFormat = GL_RGBA32F;
+        FrameGraph::Resource blurTemp = 0;
+        frameGraph.AddPass("Shadow blur H",
+            [&](FrameGraph::Builder& builder) {
+                builder.Read(moments);
+                blurTemp = builder.Create("Shadow blur temp", blurDesc);
+                builder.Write(blurTemp);
+            },
+            blurExecute(moments, vec2(tapTexels / blurSize.x, 0.f), false));
+        frameGraph.AddPass("Shadow blur V",
+            [&](FrameGraph::Builder& builder) {
+                builder.Read(blurTemp);
+                builder.Write(blurredMoments);
+            },
+            blurExecute(blurTemp, vec2(0.f, tapTexels / blurSize.y), true));
+    }
+
+    // Draws input with the present shader into output, or into a new window
+    // sized target when there is no output. Returns what was written.
+    FrameGraph::Resource AddPresentPass(
+        const std::string& name,
+        FrameGraph::Resource input,
+        std::optional<FrameGraph::Resource> output,
+        vec2 uvScale = vec2(1.f),
+        float sharpness = 0.f
+    ) {
+        FrameGraph::Resource written = 0;
+        frameGraph.AddPass(name,
+            [&](FrameGraph::Builder& builder) {
+                builder.Read(input);
+                if (output) {
+                    written = *output;
+                }
+                else {
+                    FrameGraph::TextureDesc desc;
+                    desc.size = frame->framebufferSize;
+                    desc.internalFormat = GL_RGB8;
+                    written = builder.Create(name, desc);
+                }
+                builder.Write(written);
+            },
+            [this, input, uvScale, sharpness](const FrameGraph::Context& context) {
+                context.BindFramebuffer();
+                glDisable(GL_DEPTH_TEST);
+                presentShader->Activate();
+                presentShader->SetUniform("uvScale", uvScale);
+                presentShader->SetUniform("sharpness", sharpness);
+                glBindVertexArray(quadVAO);
+                glActiveTexture(GL_TEXTURE0);
+                Texture2D::BindTexture(context.GetTexture(input));
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            });
+        return written;
+    }
+
+    // Always generates the same lights for a given count, so runs are comparable
+    void InitClusteredLights(int count) {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        clusteredLights.resize(count);
+        lightOrbits.resize(count);
+        for (int i = 0; i < count; ++i) {
+            auto& orbit = lightOrbits[i];
+            orbit.radius = 0.5f + 4.5f * unit(random);
+            orbit.angle = radians(360.f) * unit(random);
+            orbit.height = 0.2f + 2.3f * unit(random);
+            orbit.speed = radians(-30.f + 60.f * unit(random));
+
+            auto& light = clusteredLights[i];
+            const auto hue = unit(random) * 6.f;
+            light.colour = clamp(vec3(abs(hue - 3.f) - 1.f, 2.f - abs(hue - 2.f), 2.f - abs(hue - 4.f)), 0.f, 1.f);
+            light.range = 0.8f + 1.2f * unit(random);
+            if (i % 4 == 3) {
+                // Spot lights shining down from higher up
+                light.range *= 2.f;
+                light.direction = vec3(0.f, -1.f, 0.f);
+                light.cosInner = cos(radians(25.f));
+                light.cosOuter = cos(radians(35.f));
+            }
+        }
+        numClusteredLights = count;
+    }
+
+    void UpdateClusteredLights(float time) {
+        for (size_t i = 0; i < clusteredLights.size(); ++i) {
+            const auto& orbit = lightOrbits[i];
+            const auto angle = orbit.angle + orbit.speed * time;
+            clusteredLights[i].position = vec3(orbit.radius * cos(angle), orbit.height, orbit.radius * sin(angle));
+        }
     }
 
     void InitScene() {
@@ -269,13 +636,16 @@ struct Graphics::CheshireCat {
         pointLightShader->AttachShader("drawing.vert");
         pointLightShader->AttachShader("light.frag");
         pointLightShader->Link();
+        AddIndirectVariant(*pointLightShader, "drawing-indirect.vert", "light.frag");
 
-        pointLightDrawable = std::make_unique<Drawable>(lightMesh, pointLightShader);
+        const auto pointLightDrawable = scene.AddDrawable(std::make_shared<Drawable>(lightMesh, pointLightShader));
+        pointLightNode = scene.Add(Scene::kNoParent, lightMat);
 
         auto shader = std::make_shared<Shader>();
         shader->AttachShader("drawing.vert");
         shader->AttachShader("textured.frag");
         shader->Link();
+        AddIndirectVariant(*shader, "drawing-indirect.vert", "textured.frag");
         shader->SetUniform("material.shininess", 32.f);
 
         auto characterDiffuse = std::make_shared<Texture2D>("TP_Guide_S0_DF.png", Texture2D::sRGB);
@@ -294,11 +664,13 @@ struct Graphics::CheshireCat {
         shader->AddTexture("material.specular", characterSpecular);
 
         shader->AddTexture("shadowMap", depthMap);
+        shader->AddTexture("shadowMoments", momentsBlurred);
 
         auto hairShader = std::make_shared<Shader>();
         hairShader->AttachShader("drawing.vert");
         hairShader->AttachShader("textured.frag");
         hairShader->Link();
+        AddIndirectVariant(*hairShader, "drawing-indirect.vert", "textured.frag");
         hairShader->SetUniform("material.shininess", 32.f);
 
         auto hairDiffuse = std::make_shared<Texture2D>("TP_Guide_S0_Hair_DF.png", Texture2D::sRGB);
@@ -313,12 +685,13 @@ struct Graphics::CheshireCat {
 
         hairShader->AddTexture("material.specular", characterSpecular);
         hairShader->AddTexture("shadowMap", depthMap);
+        hairShader->AddTexture("shadowMoments", momentsBlurred);
 
         auto meshes = LoadFileMesh("Skye.obj");
-        characterDrawables = {
-            std::make_shared<Drawable>(meshes[0], shader),
-            std::make_shared<Drawable>(meshes[1], shader),
-            std::make_shared<Drawable>(meshes[2], hairShader),
+        const Scene::DrawableHandle characterDrawables[] = {
+            scene.AddDrawable(std::make_shared<Drawable>(meshes[0], shader)),
+            scene.AddDrawable(std::make_shared<Drawable>(meshes[1], shader)),
+            scene.AddDrawable(std::make_shared<Drawable>(meshes[2], hairShader)),
         };
         sceneShaders.push_back(shader);
         sceneShaders.push_back(hairShader);
@@ -329,6 +702,7 @@ struct Graphics::CheshireCat {
         floorShader->AttachShader("drawing.vert");
         floorShader->AttachShader("textured.frag");
         floorShader->Link();
+        AddIndirectVariant(*floorShader, "drawing-indirect.vert", "textured.frag");
         floorShader->SetUniform("material.shininess", 32.f);
 
         auto floorDiffuse = std::make_shared<Texture2D>("brickwall.jpg", Texture2D::sRGB);
@@ -342,40 +716,40 @@ struct Graphics::CheshireCat {
         floorShader->AddTexture("material.normal", floorNormal);
 
         floorShader->AddTexture("shadowMap", depthMap);
+        floorShader->AddTexture("shadowMoments", momentsBlurred);
 
-        floor = std::make_unique<Drawable>(floorMesh, floorShader);
-    }
+        const auto floorDrawable = scene.AddDrawable(std::make_shared<Drawable>(floorMesh, floorShader));
 
-    void InitFramebuffer() {
-        // Setup framebuffer
-        glGenFramebuffers(1, &fbo);
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        // The character stands on the floor and moves with it
+        floorNode = scene.Add();
+        characterNode = scene.Add(floorNode, rotate(mat4(1), radians(-90.f), vec3(0.f, 1.f, 0.f)));
 
-        // create color attachment texture
-        renderTexture = std::make_shared<Texture2D>(framebufferSize, Texture2D::LinearSpace, Texture2D::RGB, Texture2D::UnsignedByte);
-        renderTexture->SetFiltering(Texture2D::Linear);
-
-        // bind texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderTexture->Get(), 0);
-
-        // Create a renderbuffer objct for depth and stencil attachment
-        glGenRenderbuffers(1, &rbo);
-        glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, framebufferSize.x, framebufferSize.y);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-        // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-            throw std::runtime_error("Framebuffer is not ready!");
+        scene.Place(pointLightDrawable, pointLightNode);
+        for (auto drawable : characterDrawables) {
+            scene.Place(drawable, characterNode);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
+        scene.Place(floorDrawable, floorNode);
 
-        screenShader = std::make_unique<Shader>();
-        screenShader->AttachShader("framebuffer-display.vert");
-        screenShader->AttachShader("framebuffer-display.frag");
-        screenShader->Link();
-        screenShader->SetUniform("screenTexture", 0);
+        occlusionCuller.AddOccludee(lightMesh, pointLightNode);
+        for (size_t i = 0; i < std::size(characterDrawables); ++i) {
+            occlusionCuller.AddOccludee(meshes[i], characterNode);
+        }
+        occlusionCuller.AddOccludee(floorMesh, floorNode);
+        occlusionCuller.AddOccluder(meshes[0], characterNode);
+        occlusionCuller.AddOccluder(meshes[1], characterNode);
+        occlusionCuller.AddOccluder(floorMesh, floorNode);
+
+        const auto& renderables = scene.GetRenderables();
+        if (IndirectRenderer::IsSupported()) {
+            indirectRenderer = std::make_unique<IndirectRenderer>(floorMesh.GetVertexAttribs());
+            for (const auto& renderable : renderables) {
+                indirectRenderer->Add(*renderable.drawable);
+            }
+            indirectRenderer->Upload(renderables.size());
+        }
+    }
 
+    void InitFramebuffer() {
         float quadVertices[] = { // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
             // positions   // texCoords
             -1.0f,  1.0f,  0.0f, 1.0f,
@@ -395,6 +769,69 @@ struct Graphics::CheshireCat {
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+
+        presentShader = std::make_unique<Shader>();
+        presentShader->AttachShader("framebuffer-display.vert");
+        presentShader->AttachShader("framebuffer-display.frag");
+        presentShader->Link();
+        presentShader->SetUniform("screenTexture", 0);
+        presentShader->SetUniform("clipPos", vec4(0.f, 0.f, 1.f, 1.f));
+
+        InitPostProcessing();
+    }
+
+    void InitPostProcessing() {
+        postProcess = std::make_unique<PostProcessStack>(quadVAO);
+
+        PostProcessStack::Effect wave;
+        wave.name = "Wave";
+        wave.file = "wave-postprocess.glsl";
+        wave.function = "Wave";
+        wave.hasWarp = true;
+        wave.animated = true;
+        wave.parameters = {
+            { "waveAmplitude", 0.01f, 0.f, 0.05f },
+            { "waveFrequency", 80.f, 1.f, 200.f },
+        };
+        wave.enabled = false;
+        postProcess->AddEffect(wave);
+
+        PostProcessStack::Effect blur;
+        blur.name = "Blur";
+        blur.kind = PostProcessStack::SeparableBlur;
+        blur.enabled = false;
+        postProcess->AddEffect(blur);
+
+        PostProcessStack::Effect edgeDetect;
+        edgeDetect.name = "Edge detect";
+        edgeDetect.kind = PostProcessStack::FullScreen;
+        edgeDetect.file = "edge-detect-postprocess.frag";
+        edgeDetect.enabled = false;
+        postProcess->AddEffect(edgeDetect);
+
+        PostProcessStack::Effect grade;
+        grade.name = "Colour grade";
+        grade.file = "colour-grade-postprocess.glsl";
+        grade.function = "ColourGrade";
+        grade.hasColour = true;
+        grade.parameters = {
+            { "gradeExposure", 1.f, 0.f, 4.f },
+            { "gradeContrast", 1.f, 0.f, 2.f },
+            { "gradeSaturation", 1.f, 0.f, 2.f },
+        };
+        grade.enabled = false;
+        postProcess->AddEffect(grade);
+
+        PostProcessStack::Effect vignette;
+        vignette.name = "Vignette";
+        vignette.file = "vignette-postprocess.glsl";
+        vignette.function = "Vignette";
+        vignette.hasColour = true;
+        vignette.parameters = {
+            { "vignetteStrength", 0.5f, 0.f, 2.f },
+        };
+        vignette.enabled = false;
+        postProcess->AddEffect(vignette);
     }
 
     void InitView() {
@@ -418,19 +855,77 @@ struct Graphics::CheshireCat {
             mat4(1.f), // lightRotation,
             lightStartPos
         );
-        pointLightShader->SetUniform("lightColor", light.specular);
+        scene.SetLocal(pointLightNode, lightMat);
         light.position = vec3(lightMat[3]);
         light.direction = normalize(vec3(0) - light.position);
         light.cutOff = cos(radians(lightInnerCutoffDegrees));
         light.outerCutOff = cos(radians(lightInnerCutoffDegrees + lightEdgeRadiusDegrees));
 
+        UpdateClusteredLights(time);
+
+        cameraView = camera.GetViewMatrix();
+    }
+
+    void SetLightUniforms() {
+        pointLightShader->SetUniform("lightColor", frame->light.specular);
         for (auto shader : sceneShaders) {
-            SetLight(*shader, light, lightSpaceMatrix, penumbraSize);
+            SetLight(*shader, frame->light, frame->lightSpaceMatrix, frame->penumbraSize, frame->prefilteredShadows);
         }
+        SetLight(*floorShader, frame->light, frame->lightSpaceMatrix, frame->penumbraSize, frame->prefilteredShadows);
+    }
 
-        SetLight(*floorShader, light, lightSpaceMatrix, penumbraSize);
+    // Brings the Render side's objects in line with what the GUI last set.
+    void ApplySettings(const RenderSettings& settings) {
+        shadowMapCache.SetUpdateInterval(settings.shadowUpdateInterval);
+        if (settings.alwaysUpdateShadows || settings.shadowInvalidations != appliedShadowInvalidations) {
+            shadowMapCache.Invalidate();
+            appliedShadowInvalidations = settings.shadowInvalidations;
+        }
 
-        cameraView = camera.GetViewMatrix();
+        dynamicResolution.SetEnabled(settings.dynamicResolution);
+        dynamicResolution.SetBudget(settings.resolutionBudget);
+        dynamicResolution.SetScaleRange(settings.minResolutionScale, 1.f);
+        if (!settings.dynamicResolution) {
+            dynamicResolution.SetScale(settings.resolutionScale);
+        }
+
+        // Same size every time, so the stack's pointers into it stay valid
+        postProcess->GetEffects() = settings.effects;
+        if (settings.effectsVersion != appliedEffectsVersion) {
+            postProcess->Invalidate();
+            appliedEffectsVersion = settings.effectsVersion;
+        }
+
+        if (settings.recording && !frameCapture->IsRecording()) {
+            frameCapture->Start(settings.captureDirectory, settings.captureFormat);
+        }
+        else if (!settings.recording && frameCapture->IsRecording()) {
+            frameCapture->Stop();
+        }
+    }
+
+    void PublishStats() {
+        auto& stats = renderStats.GetWrite();
+        stats.shadowMilliseconds = shadowTimer->GetMilliseconds();
+        stats.frameMilliseconds = frameTimer->GetMilliseconds();
+        stats.ringMode = uniformRing->GetMode();
+        stats.ringRegionSize = uniformRing->GetRegionSize();
+        stats.ringStalls = uniformRing->GetNumStalls();
+        stats.shadowUpdates = shadowMapCache.GetNumUpdates();
+        stats.shadowSkips = shadowMapCache.GetNumSkipped();
+        stats.graph = frameGraph.GetStats();
+        stats.schedule = frameGraph.GetSchedule();
+        stats.renderSize = dynamicResolution.GetRenderSize(frame->framebufferSize);
+        stats.resolutionScale = dynamicResolution.GetScale();
+        stats.resolutionChanges = dynamicResolution.GetNumChanges();
+        stats.occlusion = occlusionCuller.GetStats();
+        stats.clusters = lightClusters->GetStats();
+        stats.postProcessTimings = postProcess->GetTimings();
+        stats.passTimings = gpuProfiler->GetTimings();
+        stats.capture = frameCapture->GetStats();
+        stats.api = counters.api;
+        stats.memory = counters.memory;
+        renderStats.Publish();
     }
 
     void DrawSkybox(mat4 view, mat4 proj) {
@@ -443,15 +938,178 @@ struct Graphics::CheshireCat {
         glDepthFunc(GL_LESS);
     }
 
-    void DrawFirstPass(mat4 view, mat4 proj, float time, std::shared_ptr<Shader> overrideShader = nullptr) {
-        pointLightDrawable->Draw(lightMat, view, proj, overrideShader);
-        // Draw character
-        for (auto& d : characterDrawables) {
-            d->Draw(rotate(mat4(1), radians(-90.f), vec3(0.f, 1.f, 0.f)), view, proj, overrideShader);
+    void RecordFirstPass(
+        RecordedPass& out,
+        const TransformSystem::View& view,
+        const std::vector<Renderable>& drawn,
+        Shader* overrideShader = nullptr,
+        bool depthOnly = false
+    ) {
+        PROFILE_SCOPE("RecordFirstPass");
+        const size_t numLists = threadPool->GetNumThreads();
+        auto& commandLists = out.commandLists;
+        commandLists.resize(numLists);
+        for (auto& commandList : commandLists) {
+            commandList.Reset();
+        }
+        out.indirect.batches.clear();
+        out.useIndirect = frame->settings.useIndirect && indirectRenderer != nullptr;
+
+        PassContext pass;
+        pass.transforms = &frame->transforms;
+        pass.view = &view;
+        pass.uniforms = uniformRing.get();
+        pass.overrideShader = overrideShader;
+        pass.depthOnly = depthOnly;
+
+        // Render records the frame again if the ring is full
+        auto perView = uniformRing->Allocate(sizeof(PerViewUniforms));
+        if (perView.data == nullptr) {
+            return;
+        }
+        ((PerViewUniforms*)perView.data)->worldSpaceCameraPos = vec4(view.worldSpaceCameraPos, 1.f);
+        pass.perViewOffset = perView.offset;
+
+        const auto* listed = &drawn;
+        if (out.useIndirect) {
+            indirectRenderer->Record(out.indirect, pass, drawn, out.notBatched);
+            listed = &out.notBatched;
+        }
+        if (listed->empty()) {
+            return;
+        }
+
+        // One contiguous chunk of the scene per thread, so executing the lists
+        // in order draws everything in the same order as a single thread would
+        const auto chunkSize = (listed->size() + numLists - 1) / numLists;
+        threadPool->ParallelFor(listed->size(), chunkSize, [&](size_t begin, size_t end) {
+            PROFILE_SCOPE("Record chunk");
+            auto& commandList = commandLists[begin / chunkSize];
+            for (auto i = begin; i < end; ++i) {
+                const auto& renderable = (*listed)[i];
+                renderable.drawable->Record(commandList, pass, renderable.transform);
+            }
+        });
+    }
+
+    const std::vector<Renderable>& CullScene() {
+        const auto& renderables = scene.GetRenderables();
+        if (!frame->settings.useOcclusionCulling) {
+            return renderables;
+        }
+        PROFILE_SCOPE("CullScene");
+        occlusionCuller.Cull(cameraViewTransforms, threadPool.get());
+        visibleRenderables.clear();
+        for (size_t i = 0; i < renderables.size(); ++i) {
+            if (occlusionCuller.IsVisible(i)) {
+                visibleRenderables.push_back(renderables[i]);
+            }
+        }
+        return visibleRenderables;
+    }
+
+    static void CountDraws(const RecordedPass& recorded, Graphics::Counters& counters) {
+        if (recorded.useIndirect) {
+            for (const auto& batch : recorded.indirect.batches) {
+                ++counters.numDrawCalls;
+                counters.numObjects += batch.drawCount;
+            }
+        }
+        for (const auto& commandList : recorded.commandLists) {
+            counters.numDrawCalls += (unsigned int)commandList.GetSize();
+            counters.numObjects += (unsigned int)commandList.GetSize();
+        }
+    }
+
+    void DrawFirstPass(const RecordedPass& recorded) {
+        PROFILE_SCOPE("DrawFirstPass");
+        if (recorded.useIndirect) {
+            indirectRenderer->Execute(recorded.indirect);
+        }
+        for (const auto& commandList : recorded.commandLists) {
+            commandList.Execute();
         }
-        
-        // Draw floor
-        floor->Draw(mat4(1), view, proj, overrideShader);
+    }
+
+    void DrawPostProcessingGUI() {
+        ImGui::Begin("Post-processing");
+        auto& effects = settings.effects;
+        for (size_t i = 0; i < effects.size(); ++i) {
+            auto& effect = effects[i];
+            ImGui::PushID((int)i);
+
+            if (ImGui::Checkbox(effect.name.c_str(), &effect.enabled)) {
+                ++settings.effectsVersion;
+            }
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Up") && i > 0) {
+                std::swap(effects[i], effects[i - 1]);
+                ++settings.effectsVersion;
+            }
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Down") && i + 1 < effects.size()) {
+                std::swap(effects[i], effects[i + 1]);
+                ++settings.effectsVersion;
+            }
+
+            if (effects[i].enabled) {
+                auto& shown = effects[i];
+                for (auto& parameter : shown.parameters) {
+                    ImGui::SliderFloat(parameter.uniform.c_str(), &parameter.value, parameter.min, parameter.max);
+                }
+                if (shown.kind == PostProcessStack::SeparableBlur) {
+                    ImGui::SliderFloat("Radius (pixels)", &shown.blurRadius, 1.f, 32.f);
+                    if (ImGui::Checkbox("Half resolution", &shown.halfResolution)) {
+                        ++settings.effectsVersion;
+                    }
+                }
+            }
+            ImGui::PopID();
+        }
+
+        ImGui::Separator();
+        for (const auto& timing : renderStats.GetRead().postProcessTimings) {
+            ImGui::Text("%s: %.3f ms GPU", timing.label.c_str(), timing.milliseconds);
+        }
+        ImGui::End();
+    }
+
+    void DrawProfilerGUI() {
+        ImGui::Begin("GPU passes");
+        const auto& timings = renderStats.GetRead().passTimings;
+        float total = 0.f;
+        for (size_t i = 0; i < timings.size(); ++i) {
+            const auto& timing = timings[i];
+            ImGui::PushID((int)i);
+            ImGui::Text(
+                "%*s%s: %.3f ms (max %.3f ms)",
+                timing.depth * 2, "",
+                timing.label.c_str(),
+                timing.averageMilliseconds,
+                timing.maxMilliseconds
+            );
+            ImGui::PlotLines(
+                "##history",
+                timing.history.data(),
+                (int)timing.history.size(),
+                0,
+                nullptr,
+                0.f,
+                timing.maxMilliseconds * 1.25f + 0.01f,
+                ImVec2(0.f, 30.f)
+            );
+            ImGui::PopID();
+            if (timing.depth == 0) {
+                total += timing.averageMilliseconds;
+            }
+        }
+        if (timings.empty()) {
+            ImGui::Text("No timer results, they need GL 3.3");
+        }
+        else {
+            ImGui::Text("Total: %.3f ms", total);
+        }
+        ImGui::End();
     }
 
     void DrawGUI(float deltaTime) {
@@ -504,23 +1162,259 @@ struct Graphics::CheshireCat {
         }
 
         if (ImGui::TreeNode("Shadow")) {
-            ImGui::SliderFloat("Penumbra size", &penumbraSize, 1.f, 2000.f, "%.2f");
+            if (ImGui::SliderFloat("Penumbra size", &penumbraSize, 1.f, 2000.f, "%.2f")) {
+                ++settings.shadowInvalidations;
+            }
+            if (ImGui::Checkbox("Prefiltered (EVSM)", &prefilteredShadows)) {
+                ++settings.shadowInvalidations;
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Clustered lights")) {
+            if (ImGui::SliderInt("Count", &numClusteredLights, 0, kMaxClusteredLights)) {
+                InitClusteredLights(numClusteredLights);
+            }
+            if (ImGui::Button("Benchmark scene")) {
+                InitClusteredLights(kBenchmarkClusteredLights);
+            }
+            const auto& stats = renderStats.GetRead().clusters;
+            ImGui::Text(
+                "%u visible, %u list entries, at most %u per cluster\nAssigned in %.3f ms CPU",
+                stats.numVisible,
+                stats.numIndices,
+                stats.maxPerCluster,
+                stats.milliseconds
+            );
             ImGui::TreePop();
         }
 
         ImGui::End();
 
+        DrawPostProcessingGUI();
+        DrawProfilerGUI();
+
         ImGui::Begin("FPS");
         ImGui::Text("%.2f ms\n%.2f FPS", deltaTime * 1000.0f, 1.0f / deltaTime);
+        if (ImGui::TreeNode("Frame times")) {
+            const auto recent = timer->GetRecentStats();
+            const auto run = timer->GetRunStats();
+            ImGui::Text(
+                "Last %u: p50 %.2f, p95 %.2f, p99 %.2f, max %.2f ms\nAll %u: p50 %.2f, p95 %.2f, p99 %.2f, max %.2f ms",
+                recent.numFrames, recent.p50Milliseconds, recent.p95Milliseconds, recent.p99Milliseconds, recent.maxMilliseconds,
+                run.numFrames, run.p50Milliseconds, run.p95Milliseconds, run.p99Milliseconds, run.maxMilliseconds
+            );
+
+            float budget = timer->GetBudget();
+            if (ImGui::SliderFloat("Budget (ms)", &budget, 4.f, 50.f)) {
+                timer->SetBudget(budget);
+            }
+            ImGui::Text("%u stutters over budget", timer->GetNumStutters());
+
+            const auto& histogram = timer->GetHistogram();
+            std::array<float, Timer::kNumBins> bins;
+            std::copy(histogram.begin(), histogram.end(), bins.begin());
+            ImGui::PlotHistogram(
+                "##histogram",
+                bins.data(),
+                (int)bins.size(),
+                0,
+                "log bins, 0.25 ms to 10 s",
+                0.f,
+                FLT_MAX,
+                ImVec2(0.f, 80.f)
+            );
+            ImGui::TreePop();
+        }
+        ImGui::Checkbox("Animate scene", &settings.animateScene);
+
+        const auto& stats = renderStats.GetRead();
+        const char* ringModes[] = { "persistent", "unsynchronized", "orphaning" };
+        ImGui::Text(
+            "Uniform ring: %s, %ld KiB/frame, %u stalls",
+            ringModes[stats.ringMode],
+            (long)(stats.ringRegionSize / 1024),
+            stats.ringStalls
+        );
+
+        if (IndirectRenderer::IsSupported()) {
+            if (ImGui::Checkbox("Multi-draw indirect", &settings.useIndirect)) {
+                ++settings.shadowInvalidations;
+            }
+        }
+        else {
+            ImGui::Text("Multi-draw indirect: needs GL 4.3");
+        }
+
+        ImGui::Text("Shadow pass: %.3f ms GPU", stats.shadowMilliseconds);
+        if (ImGui::Checkbox("Position-only shadow stream", &settings.usePositionStream)) {
+            ++settings.shadowInvalidations;
+        }
+
+        ImGui::Text(
+            "Shadow map: %u updates, %u frames skipped",
+            stats.shadowUpdates,
+            stats.shadowSkips
+        );
+        ImGui::SliderInt("Update every N frames", &settings.shadowUpdateInterval, 1, 10);
+        ImGui::Checkbox("Always update shadows", &settings.alwaysUpdateShadows);
+
+        const char* presentModes[] = { "Direct", "Blit", "Quad" };
+        ImGui::Combo("Present without effects", &settings.presentMode, presentModes, 3);
+
+        const auto requestedKiB = (long)(stats.graph.requestedBytes / 1024);
+        const auto allocatedKiB = (long)(stats.graph.allocatedBytes / 1024);
+        ImGui::Text(
+            "Frame graph: %u passes, %u culled\n%u transients in %u allocations\n%ld KiB requested, %ld KiB allocated, %ld KiB saved",
+            stats.graph.numPasses,
+            stats.graph.numCulled,
+            stats.graph.numTransients,
+            stats.graph.numAllocated,
+            requestedKiB,
+            allocatedKiB,
+            requestedKiB - allocatedKiB
+        );
+        if (ImGui::TreeNode("Dynamic resolution")) {
+            ImGui::Text(
+                "GPU frame: %.3f ms\nRendering %ux%u (%.0f%%), %u changes",
+                stats.frameMilliseconds,
+                stats.renderSize.x,
+                stats.renderSize.y,
+                stats.resolutionScale * 100.f,
+                stats.resolutionChanges
+            );
+            if (ImGui::Checkbox("Automatic", &settings.dynamicResolution)) {
+                // Carry on from wherever automatic scaling left off
+                settings.resolutionScale = stats.resolutionScale;
+            }
+            ImGui::SliderFloat("Budget (ms)", &settings.resolutionBudget, 1.f, 50.f);
+            ImGui::SliderFloat("Minimum scale", &settings.minResolutionScale, 0.25f, 1.f);
+            if (!settings.dynamicResolution) {
+                ImGui::SliderFloat("Scale", &settings.resolutionScale, settings.minResolutionScale, 1.f);
+            }
+            ImGui::SliderFloat("Upscale sharpness", &settings.upscaleSharpness, 0.f, 1.f);
+            ImGui::TreePop();
+        }
+        ImGui::Checkbox("Occlusion culling", &settings.useOcclusionCulling);
+        if (settings.useOcclusionCulling) {
+            const auto& occlusion = stats.occlusion;
+            ImGui::Text(
+                "%u of %u occluded (%.0f%%), %u outside the view\n%u occluder triangles, %.3f ms raster, %.3f ms test",
+                occlusion.numOccluded,
+                occlusion.numTested,
+                occlusion.numTested > 0 ? 100.f * occlusion.numOccluded / occlusion.numTested : 0.f,
+                occlusion.numOutside,
+                occlusion.numOccluderTriangles,
+                occlusion.rasterMilliseconds,
+                occlusion.testMilliseconds
+            );
+        }
+
+        if (ImGui::TreeNode("Capture")) {
+            ImGui::RadioButton("PNG", &captureFormat, FrameCapture::Png);
+            ImGui::SameLine();
+            ImGui::RadioButton("Raw RGBA", &captureFormat, FrameCapture::Raw);
+            if (!settings.recording) {
+                if (ImGui::Button("Record")) {
+                    char directory[32];
+                    const auto now = std::time(nullptr);
+                    std::strftime(directory, sizeof(directory), "capture-%Y%m%d-%H%M%S", std::localtime(&now));
+                    settings.captureDirectory = directory;
+                    settings.captureFormat = (FrameCapture::Format)captureFormat;
+                    settings.recording = true;
+                }
+            }
+            else if (ImGui::Button("Stop")) {
+                settings.recording = false;
+            }
+            const auto& capture = stats.capture;
+            ImGui::Text(
+                "%u captured, %u written, %u in flight\n%u dropped, %u readback stalls",
+                capture.numCaptured,
+                capture.numWritten,
+                capture.numQueued,
+                capture.numDropped,
+                capture.numStalls
+            );
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("GL calls")) {
+#ifdef GLITTER_PROFILING
+            const auto& api = stats.api;
+            ImGui::Text(
+                "%u draw calls, %u indirect commands, %llu triangles\n"
+                "%u program, %u VAO, %u texture, %u framebuffer binds\n"
+                "%u uniform uploads\n"
+                "%.1f KiB buffer, %.1f KiB texture data uploaded",
+                api.numDrawCalls,
+                api.numIndirectCommands,
+                (unsigned long long)api.numTriangles,
+                api.numProgramBinds,
+                api.numVaoBinds,
+                api.numTextureBinds,
+                api.numFramebufferBinds,
+                api.numUniformUploads,
+                api.bufferBytesUploaded / 1024.,
+                api.textureBytesUploaded / 1024.
+            );
+            ImGui::Separator();
+            for (int category = 0; category < GlStats::NumCategories; ++category) {
+                ImGui::Text(
+                    "%s: %.1f MiB",
+                    GlStats::GetCategoryName(static_cast<GlStats::Category>(category)),
+                    stats.memory.bytes[category] / (1024. * 1024.)
+                );
+            }
+            ImGui::Text("GPU memory: %.1f MiB", stats.memory.GetTotal() / (1024. * 1024.));
+#else
+            ImGui::Text("Built without GLITTER_PROFILING");
+#endif
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("CPU trace")) {
+#ifdef GLITTER_PROFILING
+            if (!CpuProfiler::IsRecording()) {
+                if (ImGui::Button("Start")) {
+                    CpuProfiler::Start();
+                }
+            }
+            else if (ImGui::Button("Stop and save")) {
+                CpuProfiler::Stop();
+                char path[40];
+                const auto now = std::time(nullptr);
+                std::strftime(path, sizeof(path), "cpu-trace-%Y%m%d-%H%M%S.json", std::localtime(&now));
+                try {
+                    CpuProfiler::WriteChromeTrace(path);
+                }
+                catch (const std::runtime_error& ex) {
+                    error = ex.what();
+                }
+            }
+#else
+            ImGui::Text("Built without GLITTER_PROFILING");
+#endif
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Schedule")) {
+            for (const auto& name : stats.schedule) {
+                ImGui::TextUnformatted(name.c_str());
+            }
+            ImGui::TreePop();
+        }
         ImGui::End();
     }
 };
 
 Graphics::Graphics() : cc(std::make_unique<CheshireCat>()) {
     cc->timer = std::make_unique<Timer>();
+    cc->threadPool = std::make_unique<ThreadPool>();
 }
 
 Graphics::~Graphics() {
+    cc->timer->PrintSummary(stderr);
 }
 
 void Graphics::Init(uvec2 framebufferSize, dvec2 cursorPosition) {
@@ -530,12 +1424,29 @@ void Graphics::Init(uvec2 framebufferSize, dvec2 cursorPosition) {
 
         glEnable(GL_CULL_FACE);
 
+        cc->uniformRing = std::make_unique<GpuRingBuffer>(
+            GL_UNIFORM_BUFFER,
+            kUniformRingRegionSize,
+            GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+        );
+        cc->shadowTimer = std::make_unique<GpuTimer>();
+        cc->frameTimer = std::make_unique<GpuTimer>(GpuTimer::Timestamps);
+        cc->gpuProfiler = std::make_unique<GpuProfiler>();
+        cc->frameCapture = std::make_unique<FrameCapture>();
+
+        cc->lightClusters = std::make_unique<LightClusters>();
         cc->InitDepthBuffer();
         cc->InitSkybox();
         cc->InitScene();
         cc->InitFramebuffer();
         cc->InitView();
 
+        // The GUI starts from whatever the Render side's objects default to
+        cc->settings.effects = cc->postProcess->GetEffects();
+        cc->settings.dynamicResolution = cc->dynamicResolution.IsEnabled();
+        cc->settings.resolutionBudget = cc->dynamicResolution.GetBudget();
+        cc->settings.minResolutionScale = cc->dynamicResolution.GetMinScale();
+
         // Done!
         cc->timer->Start();
     }
@@ -553,14 +1464,6 @@ void Graphics::OnResize(uvec2 framebufferSize) {
         0.1f, 
         100.f
     );
-
-    // resize renderbuffer color attachment
-    cc->renderTexture->Resize(framebufferSize);
-
-    // resize depth attachment
-    glBindRenderbuffer(GL_RENDERBUFFER, cc->rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, framebufferSize.x, framebufferSize.y);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
 }
 
 void Graphics::OnCursorMoved(dvec2 cursorPos) {
@@ -586,16 +1489,78 @@ void Graphics::OnMouseButton(int button, int action) {
     }
 }
 
+void Graphics::SetGUIEnabled(bool enabled) {
+    cc->guiEnabled = enabled;
+}
+
+void Graphics::SetTargetFramebuffer(unsigned int framebuffer) {
+    cc->targetFramebuffer = framebuffer;
+}
+
+bool Graphics::WantsRedraw() {
+    // Scene time only moves the clustered lights, the rest of the scene stands still
+    const auto sceneMoving = cc->settings.animateScene && !cc->clusteredLights.empty();
+    if (cc->redrawRequested.exchange(false) || sceneMoving || cc->settings.recording) {
+        return true;
+    }
+    for (const auto& effect : cc->settings.effects) {
+        if (effect.enabled && effect.animated) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Graphics::RequestRedraw() {
+    cc->redrawRequested = true;
+}
+
+void Graphics::ResumeAfterIdle() {
+    cc->timer->Resume();
+}
+
+void Graphics::SetDeterministic(float timeStep) {
+    cc->timer->SetFixedStep(timeStep);
+    cc->settings.dynamicResolution = false;
+    cc->settings.resolutionScale = 1.f;
+}
+
+void Graphics::SetCameraAngles(float yaw, float pitch) {
+    cc->camera.SetAngles(yaw, pitch);
+}
+
+Graphics::Counters Graphics::GetCounters() const {
+    return cc->counters;
+}
+
+GpuProfiler& Graphics::GetGpuProfiler() {
+    return *cc->gpuProfiler;
+}
+
 void Graphics::Draw() {
-    if (!cc->error.empty()) {
-        ImGui::Begin("Error");
-        ImGui::Text("%s", cc->error.c_str());
-        ImGui::End();
+    Update(cc->drawFrame);
+    Render(cc->drawFrame);
+}
+
+void Graphics::Update(Frame& out) {
+    PROFILE_SCOPE("Graphics::Update");
+    // Stats from the latest frame Render has finished, if there is a new one
+    cc->renderStats.Acquire();
+    if (cc->guiEnabled) {
+        if (!cc->error.empty()) {
+            ImGui::Begin("Error");
+            ImGui::Text("%s", cc->error.c_str());
+            ImGui::End();
+        }
+        cc->DrawGUI(cc->timer->GetDelta());
     }
 
     cc->timer->Update();
     auto deltaTime = cc->timer->GetDelta();
     auto time = cc->timer->GetTime();
+    if (cc->settings.animateScene) {
+        cc->sceneTime += deltaTime;
+    }
 
     auto lightView = lookAt(cc->light.position, cc->light.direction, vec3(0.f, 1.f, 0.f));
     auto lightProjection = perspective(
@@ -607,39 +1572,191 @@ void Graphics::Draw() {
     //auto lightProjection = ortho(-8.f, 8.f, -8.f, 8.f, 0.5f, 10.f);
     cc->lightSpaceMatrix = lightProjection * lightView;
 
-    cc->UpdateScene(time, deltaTime);
-
-    glEnable(GL_DEPTH_TEST);
-    // depth pass
-    glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-    glBindFramebuffer(GL_FRAMEBUFFER, cc->depthMapFBO);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    cc->DrawFirstPass(lightView, lightProjection, time, cc->depthShader);
-
-    // first pass
-    glViewport(0, 0, cc->framebufferSize.x, cc->framebufferSize.y);
-    glBindFramebuffer(GL_FRAMEBUFFER, cc->fbo);
-    glClearColor(0.25f, 0.25f, 0.25f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    cc->DrawFirstPass(cc->cameraView, cc->cameraProj, time);
-    cc->DrawSkybox(cc->cameraView, cc->cameraProj);
-
-    // second pass
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDisable(GL_DEPTH_TEST);
+    cc->UpdateScene(cc->sceneTime, deltaTime);
+    {
+        PROFILE_SCOPE("Scene::Update");
+        // Serially, the thread pool belongs to Render
+        cc->scene.Update();
+    }
+
+    auto& frame = *out.data;
+    frame.time = time;
+    frame.framebufferSize = cc->framebufferSize;
+    frame.cameraView = cc->cameraView;
+    frame.cameraProj = cc->cameraProj;
+    frame.lightView = lightView;
+    frame.lightProjection = lightProjection;
+    frame.lightSpaceMatrix = cc->lightSpaceMatrix;
+    frame.light = cc->light;
+    frame.penumbraSize = cc->penumbraSize;
+    frame.prefilteredShadows = cc->prefilteredShadows;
+    frame.transforms = cc->scene.GetTransforms();
+    frame.clusteredLights = cc->clusteredLights;
+    frame.settings = cc->settings;
+}
+
+void Graphics::Render(const Frame& in) {
+    PROFILE_SCOPE("Graphics::Render");
+    const auto& frame = *in.data;
+    const auto& settings = frame.settings;
+    cc->frame = &frame;
+    cc->gpuProfiler->BeginFrame();
+    const auto time = frame.time;
+
+    cc->ApplySettings(settings);
+    cc->SetLightUniforms();
+
+    const auto updateShadows = cc->shadowMapCache.NeedsUpdate(
+        frame.lightSpaceMatrix,
+        frame.transforms,
+        cc->scene.GetRenderables()
+    );
+
+    // All of the matrix maths for the frame happens here, once per view
+    {
+        PROFILE_SCOPE("ComputeView");
+        if (updateShadows) {
+            frame.transforms.ComputeView(cc->lightViewTransforms, frame.lightView, frame.lightProjection, cc->threadPool.get());
+        }
+        frame.transforms.ComputeView(cc->cameraViewTransforms, frame.cameraView, frame.cameraProj, cc->threadPool.get());
+    }
+    {
+        PROFILE_SCOPE("LightClusters::Update");
+        cc->lightClusters->Update(frame.clusteredLights, frame.cameraView, frame.cameraProj, cc->threadPool.get());
+    }
+
+    // Until every draw's uniforms fit in the ring. Each miss grows it to at
+    // least what was asked for, so this only loops when the scene grows.
+    const auto& visible = cc->CullScene();
+    do {
+        cc->uniformRing->BeginFrame();
+        if (updateShadows) {
+            auto* shadowShader = frame.prefilteredShadows ? cc->momentsShader.get() : cc->depthShader.get();
+            cc->RecordFirstPass(cc->depthPass, cc->lightViewTransforms, cc->scene.GetRenderables(), shadowShader, settings.usePositionStream);
+        }
+        cc->RecordFirstPass(cc->scenePass, cc->cameraViewTransforms, visible);
+    } while (!cc->uniformRing->Flush());
+
+    cc->counters.numDrawCalls = cc->counters.numObjects = 0;
+    if (updateShadows) {
+        cc->CountDraws(cc->depthPass, cc->counters);
+    }
+    cc->CountDraws(cc->scenePass, cc->counters);
+
+    auto& graph = cc->frameGraph;
+    graph.Reset();
+    const auto shadowMap = graph.Import("Shadow map", cc->depthMap->Get(), uvec2(SHADOW_WIDTH, SHADOW_HEIGHT), GL_DEPTH_COMPONENT);
+    const auto blurredMoments = graph.Import(
+        "Blurred shadow moments",
+        cc->momentsBlurred->Get(),
+        uvec2(SHADOW_WIDTH, SHADOW_HEIGHT) / kShadowBlurDownscale,
+        GL_RGBA32F
+    );
+    const auto backbuffer = graph.ImportBackbuffer(frame.framebufferSize, cc->targetFramebuffer);
+
+    if (updateShadows) {
+        cc->AddShadowPasses(shadowMap, blurredMoments);
+    }
+
+    // Without post effects there is nothing to read the scene colour back,
+    // so it can be drawn to the back buffer directly
+    // Scaled frames always need the upscale pass, and render into a corner
+    // of targets that stay at the window size
+    const auto renderSize = cc->dynamicResolution.GetRenderSize(frame.framebufferSize);
+    const bool scaled = renderSize != uvec2(frame.framebufferSize);
+    const bool postProcessing = cc->postProcess->HasEnabledEffects();
+    const bool direct = !postProcessing && !scaled && settings.presentMode == PresentDirect;
+    for (auto& shader : cc->sceneShaders) {
+        cc->lightClusters->SetUniforms(*shader, renderSize);
+    }
+    cc->lightClusters->SetUniforms(*cc->floorShader, renderSize);
+    FrameGraph::Resource sceneColour = backbuffer;
+    graph.AddPass("Scene",
+        [&](FrameGraph::Builder& builder) {
+            builder.Read(frame.prefilteredShadows ? blurredMoments : shadowMap);
+            if (!direct) {
+                FrameGraph::TextureDesc colourDesc;
+                colourDesc.size = frame.framebufferSize;
+                colourDesc.internalFormat = GL_RGB8;
+                sceneColour = builder.Create("Scene colour", colourDesc);
+
+                FrameGraph::TextureDesc depthDesc;
+                depthDesc.size = frame.framebufferSize;
+                depthDesc.internalFormat = GL_DEPTH24_STENCIL8;
+                depthDesc.renderbuffer = true;
+                builder.Write(builder.Create("Scene depth", depthDesc));
+            }
+            builder.Write(sceneColour);
+        },
+        [this, renderSize](const FrameGraph::Context& context) {
+            context.BindFramebuffer();
+            glViewport(0, 0, renderSize.x, renderSize.y);
+            glEnable(GL_DEPTH_TEST);
+            glClearColor(0.25f, 0.25f, 0.25f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            cc->lightClusters->Bind();
+            cc->DrawFirstPass(cc->scenePass);
+            cc->gpuProfiler->Begin("Skybox");
+            cc->DrawSkybox(cc->frame->cameraView, cc->frame->cameraProj);
+            cc->gpuProfiler->End();
+        });
+
+    if (scaled) {
+        // Post effects run on the upscaled image, so they look the same at any
+        // scale. Without any, this writes straight to the back buffer and
+        // nothing else needs to present the frame.
+        sceneColour = cc->AddPresentPass(
+            "Upscale",
+            sceneColour,
+            postProcessing ? std::nullopt : std::optional<FrameGraph::Resource>(backbuffer),
+            vec2(renderSize) / vec2(frame.framebufferSize),
+            settings.upscaleSharpness
+        );
+    }
+
+    if (postProcessing) {
+        cc->postProcess->AddPasses(graph, sceneColour, backbuffer, frame.framebufferSize, time);
+    }
+    else if (!scaled && settings.presentMode == PresentBlit) {
+        // Like a draw, the blit encodes to sRGB on write while
+        // GL_FRAMEBUFFER_SRGB is enabled (guaranteed from GL 4.4)
+        graph.AddPass("Blit",
+            [&](FrameGraph::Builder& builder) {
+                builder.Read(sceneColour);
+                builder.Write(backbuffer);
+            },
+            [sceneColour, backbuffer](const FrameGraph::Context& context) {
+                const auto size = context.GetSize(sceneColour);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, context.GetFramebuffer(sceneColour));
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, context.GetFramebuffer(backbuffer));
+                glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            });
+    }
+    else if (!scaled && settings.presentMode == PresentQuad) {
+        cc->AddPresentPass("Present", sceneColour, backbuffer);
+    }
+
+    // Only affects writes to the back buffer, the intermediate targets are linear
     glEnable(GL_FRAMEBUFFER_SRGB);
-    glClearColor(1.f, 1.f, 1.f, 1.f);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    cc->screenShader->Activate();
-    cc->screenShader->SetUniform("time", time);
-    cc->screenShader->SetUniform("clipPos", vec4(0.f, 0.f, 1.f, 1.f));
-    glBindVertexArray(cc->quadVAO);
-    glActiveTexture(GL_TEXTURE0);
-    cc->renderTexture->Bind();
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    graph.Compile();
+    cc->frameTimer->Begin();
+    graph.Execute(cc->gpuProfiler.get());
+    cc->frameTimer->End();
+    cc->counters.gpuMilliseconds = cc->frameTimer->GetLastMilliseconds();
+    cc->counters.numGpuResults = cc->frameTimer->GetNumResults();
+    cc->counters.numPasses = graph.GetStats().numPasses - graph.GetStats().numCulled;
     glDisable(GL_FRAMEBUFFER_SRGB);
+    cc->frameCapture->Capture(cc->targetFramebuffer, frame.framebufferSize);
+    cc->dynamicResolution.Update(cc->frameTimer->GetMilliseconds());
+    cc->uniformRing->EndFrame();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, cc->targetFramebuffer);
+    glViewport(0, 0, frame.framebufferSize.x, frame.framebufferSize.y);
+    glDisable(GL_DEPTH_TEST);
 
-    // GUI
-    cc->DrawGUI(deltaTime);
+    cc->counters.api = GlStats::EndFrame();
+    cc->counters.memory = GlStats::GetMemory();
+    GlTrace::MarkEndOfFrame();
+    cc->PublishStats();
+    cc->frame = nullptr;
 }
@@ -0,0 +1,151 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <stdexcept>
+#include <thread>
+
+#include "GlStats.hpp"
+#include "GlTrace.hpp"
+#include "HeadlessRenderer.hpp"
+#include "RedrawScheduler.hpp"
+
+using namespace glm;
+
+static const int kMaxSettleFrames = 10;
+
+static GLFWwindow* CreateHiddenWindow(int width, int height, int contextApi) {
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, contextApi);
+    return glfwCreateWindow(width, height, "Headless", nullptr, nullptr);
+}
+
+GLFWwindow* HeadlessRenderer::CreateContext(int width, int height, bool softwareRendering) {
+#ifndef _WIN32
+    if (softwareRendering) {
+        // Makes Mesa pick llvmpipe even when there is a GPU
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+        setenv("GALLIUM_DRIVER", "llvmpipe", 0);
+    }
+#endif
+
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (!glfwInit()) {
+        throw std::runtime_error("Failed to initialise GLFW's null platform");
+    }
+
+    auto* window = CreateHiddenWindow(width, height, GLFW_EGL_CONTEXT_API);
+    if (window == nullptr) {
+        window = CreateHiddenWindow(width, height, GLFW_OSMESA_CONTEXT_API);
+    }
+    if (window == nullptr) {
+        glfwTerminate();
+        throw std::runtime_error("Failed to create a headless OpenGL context with EGL or OSMesa");
+    }
+
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    GlStats::Install();
+    fprintf(stderr, "OpenGL %s (%s)\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+    return window;
+}
+
+HeadlessRenderer::HeadlessRenderer(std::shared_ptr<Graphics> graphics, int width, int height, bool softwareRendering)
+    : graphics(graphics), size(width, height) {
+    window = CreateContext(width, height, softwareRendering);
+    GlTrace::Install(uvec2(size));
+    GlStats::MemoryScope memoryScope(GlStats::Framebuffers);
+
+    // sRGB like the window's back buffer, so GL_FRAMEBUFFER_SRGB encodes the same way
+    glGenRenderbuffers(1, &colourBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, width, height);
+    // Direct presentation draws the scene here, depth testing included
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Headless framebuffer is incomplete");
+    }
+    glViewport(0, 0, width, height);
+
+    capture = std::make_unique<FrameCapture>();
+    graphics->SetGUIEnabled(false);
+    graphics->SetTargetFramebuffer(framebuffer);
+}
+
+HeadlessRenderer::~HeadlessRenderer() {
+    // GL objects go before the context does
+    graphics.reset();
+    capture.reset();
+    if (framebuffer != 0) {
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+    if (colourBuffer != 0) {
+        glDeleteRenderbuffers(1, &colourBuffer);
+    }
+    if (depthBuffer != 0) {
+        glDeleteRenderbuffers(1, &depthBuffer);
+    }
+    glfwTerminate();
+}
+
+void HeadlessRenderer::RenderFrames(int numFrames, const std::filesystem::path& outputDirectory) {
+    if (!outputDirectory.empty()) {
+        // Every frame matters here, so wait for the encoders rather than skip any
+        capture->Start(outputDirectory, FrameCapture::Png, false);
+    }
+
+    for (int frame = 0; frame < numFrames; ++frame) {
+        graphics->Draw();
+        capture->Capture(framebuffer, uvec2(size));
+        if (!capture->IsRecording()) {
+            // Keep software rendering from queueing up frames nobody waits for
+            glFinish();
+        }
+    }
+
+    capture->Stop();
+}
+
+HeadlessRenderer::IdleStats HeadlessRenderer::RunOnDemand(double seconds) {
+    // There is no input, so waits just sleep
+    RedrawScheduler redraw;
+    redraw.SetOnDemand(true);
+    auto processEvents = [](double timeout) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(timeout));
+    };
+    auto drawFrame = [this]() {
+        graphics->Draw();
+        glFinish();
+    };
+
+    // What the start leaves pending, up to the point where it first idles
+    for (int frame = 0; frame < kMaxSettleFrames && redraw.ShouldDraw(*graphics, processEvents); ++frame) {
+        drawFrame();
+    }
+
+    IdleStats stats;
+    const auto cpuStart = std::clock();
+    const auto wallStart = std::chrono::steady_clock::now();
+    while (stats.wallSeconds < seconds) {
+        if (redraw.ShouldDraw(*graphics, processEvents)) {
+            drawFrame();
+            ++stats.numFrames;
+        }
+        stats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    }
+    stats.cpuSeconds = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    return stats;
+}
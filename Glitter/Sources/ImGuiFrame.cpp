@@ -0,0 +1,30 @@
+#include "ImGuiFrame.hpp"
+
+ImGuiFrame::~ImGuiFrame() {
+    Clear();
+}
+
+void ImGuiFrame::Clear() {
+    for (int i = 0; i < data.CmdLists.Size; ++i) {
+        IM_DELETE(data.CmdLists[i]);
+    }
+    data.CmdLists.resize(0);
+}
+
+void ImGuiFrame::CopyFrom(const ImDrawData* source) {
+    Clear();
+    if (source == nullptr) {
+        data.Valid = false;
+        return;
+    }
+
+    // The lists themselves are reused by ImGui every frame, so they are
+    // cloned, everything else is plain values
+    ImVector<ImDrawList*> lists;
+    lists.swap(data.CmdLists);
+    data = *source;
+    data.CmdLists.swap(lists);
+    for (int i = 0; i < source->CmdLists.Size; ++i) {
+        data.CmdLists.push_back(source->CmdLists[i]->CloneOutput());
+    }
+}
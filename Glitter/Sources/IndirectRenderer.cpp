@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "GlStats.hpp"
+#include "GpuRingBuffer.hpp"
+#include "IndirectRenderer.hpp"
+#include "Shader.hpp"
+#include "UniformBlocks.hpp"
+
+using namespace glm;
+
+bool IndirectRenderer::IsSupported() {
+    return GLAD_GL_VERSION_4_3 && glMultiDrawElementsIndirect != nullptr;
+}
+
+IndirectRenderer::IndirectRenderer(const VertexAttribInfoList& vertexAttribs)
+    : vertexAttribs(vertexAttribs) {
+    for (const auto& attrib : vertexAttribs) {
+        if (attrib.type != GL_FLOAT) {
+            throw std::out_of_range("Unknown type");
+        }
+        vertexStride += attrib.size * sizeof(float);
+    }
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+}
+
+IndirectRenderer::~IndirectRenderer() {
+    if (vao != 0) {
+        glDeleteVertexArrays(1, &vao);
+    }
+    if (depthVao != 0) {
+        glDeleteVertexArrays(1, &depthVao);
+    }
+    GLuint buffers[] = { vbo, positionVbo, ebo, drawIdBuffer };
+    for (auto buffer : buffers) {
+        if (buffer != 0) {
+            glDeleteBuffers(1, &buffer);
+        }
+    }
+}
+
+void IndirectRenderer::Add(const Drawable& drawable) {
+    if (std::find(drawables.begin(), drawables.end(), &drawable) == drawables.end()) {
+        drawables.push_back(&drawable);
+    }
+}
+
+void IndirectRenderer::Upload(size_t maxDrawsPerBatch) {
+    this->maxDrawsPerBatch = std::max<size_t>(maxDrawsPerBatch, 1);
+    GlStats::MemoryScope memoryScope(GlStats::Meshes);
+
+    GLsizeiptr vertexDataSize = 0, positionDataSize = 0, indexDataSize = 0;
+    for (auto* drawable : drawables) {
+        vertexDataSize += drawable->GetVertexDataSize();
+        positionDataSize += drawable->GetPositionDataSize();
+        indexDataSize += drawable->GetNumElements() * sizeof(GLuint);
+    }
+
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexDataSize, nullptr, GL_STATIC_DRAW);
+    GLintptr vertexOffset = 0;
+    for (auto* drawable : drawables) {
+        glBindBuffer(GL_COPY_READ_BUFFER, drawable->GetVertexBuffer());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, vertexOffset, drawable->GetVertexDataSize());
+        meshes[drawable].baseVertex = (GLint)(vertexOffset / vertexStride);
+        vertexOffset += drawable->GetVertexDataSize();
+    }
+
+    // Same base vertices as the interleaved buffer, as both hold every vertex
+    glGenBuffers(1, &positionVbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, positionVbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, positionDataSize, nullptr, GL_STATIC_DRAW);
+    GLintptr positionOffset = 0;
+    for (auto* drawable : drawables) {
+        glBindBuffer(GL_COPY_READ_BUFFER, drawable->GetPositionBuffer());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, positionOffset, drawable->GetPositionDataSize());
+        positionOffset += drawable->GetPositionDataSize();
+    }
+
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexDataSize, nullptr, GL_STATIC_DRAW);
+    GLintptr indexOffset = 0;
+    for (auto* drawable : drawables) {
+        const auto size = drawable->GetNumElements() * sizeof(GLuint);
+        glBindBuffer(GL_COPY_READ_BUFFER, drawable->GetIndexBuffer());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, indexOffset, size);
+        meshes[drawable].count = drawable->GetNumElements();
+        meshes[drawable].firstIndex = (GLuint)(indexOffset / sizeof(GLuint));
+        indexOffset += size;
+    }
+
+    // Instance i of any draw reads draw id i, so a command's baseInstance
+    // picks which element of the per-draw storage buffer it uses
+    std::vector<GLuint> drawIds(this->maxDrawsPerBatch);
+    std::iota(drawIds.begin(), drawIds.end(), 0);
+    glGenBuffers(1, &drawIdBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(GLuint), drawIds.data(), GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    size_t offset = 0;
+    for (GLuint i = 0; i < vertexAttribs.size(); ++i) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribPointer(i, vertexAttribs[i].size, vertexAttribs[i].type, GL_FALSE, vertexStride, (void*)offset);
+        offset += vertexAttribs[i].size * sizeof(float);
+    }
+
+    const auto drawIdLocation = (GLuint)vertexAttribs.size();
+    glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+    glEnableVertexAttribArray(drawIdLocation);
+    glVertexAttribIPointer(drawIdLocation, 1, GL_UNSIGNED_INT, 0, (void*)0);
+    glVertexAttribDivisor(drawIdLocation, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+    glGenVertexArrays(1, &depthVao);
+    glBindVertexArray(depthVao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, positionVbo);
+    glEnableVertexAttribArray(Drawable::DepthPositionLocation);
+    glVertexAttribPointer(Drawable::DepthPositionLocation, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+    glEnableVertexAttribArray(drawIdLocation);
+    glVertexAttribIPointer(drawIdLocation, 1, GL_UNSIGNED_INT, 0, (void*)0);
+    glVertexAttribDivisor(drawIdLocation, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBindVertexArray(0);
+}
+
+void IndirectRenderer::Record(
+    IndirectPass& out,
+    const PassContext& pass,
+    const std::vector<Renderable>& renderables,
+    std::vector<Renderable>& notBatched
+) {
+    for (auto& group : groups) {
+        group.second.clear();
+    }
+    notBatched.clear();
+    for (size_t i = 0; i < renderables.size(); ++i) {
+        auto* shader = pass.overrideShader != nullptr ? pass.overrideShader : renderables[i].drawable->GetShader();
+        auto* variant = shader->GetIndirectVariant();
+        if (variant == nullptr || meshes.find(renderables[i].drawable) == meshes.end()) {
+            notBatched.push_back(renderables[i]);
+            continue;
+        }
+        auto group = std::find_if(groups.begin(), groups.end(), [&](const auto& g) { return g.first == variant; });
+        if (group == groups.end()) {
+            groups.emplace_back(variant, std::vector<size_t>());
+            group = groups.end() - 1;
+        }
+        group->second.push_back(i);
+    }
+
+    out.batches.clear();
+    out.buffer = pass.uniforms->Get();
+    out.perViewOffset = pass.perViewOffset;
+    out.depthOnly = pass.depthOnly;
+
+    for (const auto& [shader, indices] : groups) {
+        // The draw id buffer only counts up to maxDrawsPerBatch
+        for (size_t first = 0; first < indices.size(); first += maxDrawsPerBatch) {
+            const auto drawCount = std::min(indices.size() - first, maxDrawsPerBatch);
+
+            // The frame is recorded again if the ring is full
+            auto perDraw = pass.uniforms->Allocate(drawCount * sizeof(PerDrawUniforms), storageAlignment);
+            auto commands = pass.uniforms->Allocate(drawCount * sizeof(DrawElementsIndirectCommand), sizeof(GLuint));
+            if (perDraw.data == nullptr || commands.data == nullptr) {
+                return;
+            }
+
+            auto* perDrawData = (PerDrawUniforms*)perDraw.data;
+            auto* commandData = (DrawElementsIndirectCommand*)commands.data;
+            for (size_t i = 0; i < drawCount; ++i) {
+                const auto& renderable = renderables[indices[first + i]];
+                const auto& mesh = meshes.find(renderable.drawable)->second;
+
+                Drawable::WritePerDrawUniforms(perDrawData[i], pass, renderable.transform);
+                commandData[i] = { mesh.count, 1, mesh.firstIndex, mesh.baseVertex, (GLuint)i };
+            }
+
+            IndirectBatch batch;
+            batch.shader = shader;
+            batch.drawCount = (GLsizei)drawCount;
+            batch.commandsOffset = commands.offset;
+            batch.perDrawOffset = perDraw.offset;
+            batch.perDrawSize = perDraw.size;
+            out.batches.push_back(batch);
+        }
+    }
+}
+
+void IndirectRenderer::Execute(const IndirectPass& pass) const {
+    glBindVertexArray(pass.depthOnly ? depthVao : vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, pass.buffer);
+    glBindBufferRange(GL_UNIFORM_BUFFER, PerViewBlockBinding, pass.buffer, pass.perViewOffset, sizeof(PerViewUniforms));
+
+    for (const auto& batch : pass.batches) {
+        batch.shader->Activate();
+        if (!pass.depthOnly) {
+            batch.shader->BindTextures();
+        }
+
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, PerDrawStorageBinding, pass.buffer, batch.perDrawOffset, batch.perDrawSize);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)batch.commandsOffset, batch.drawCount, 0);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
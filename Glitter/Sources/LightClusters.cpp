@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GLITTER_CLUSTER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include "LightClusters.hpp"
+#include "Shader.hpp"
+#include "ThreadPool.hpp"
+
+using namespace glm;
+
+enum BufferIndex {
+    GridBuffer,
+    IndexBuffer,
+    LightBuffer
+};
+
+enum Bound {
+    MinX, MinY, MinZ, MaxX, MaxY, MaxZ
+};
+
+static const unsigned int kClustersPerSlice = LightClusters::kGridX * LightClusters::kGridY;
+static_assert(kClustersPerSlice % 4 == 0, "Slices are tested four clusters at a time");
+
+// Lights are referenced by 16 bit indices
+static const size_t kMaxLights = 65535;
+
+// Bounding sphere of a cone, tighter than the sphere around the apex for
+// narrow spot lights
+static void GetSpotSphere(const ClusteredLight& light, vec3& centre, float& radius) {
+    const auto cosAngle = light.cosOuter;
+    if (cosAngle <= 0.70710678f) {
+        const auto sinAngle = std::sqrt(1.f - cosAngle * cosAngle);
+        centre = light.position + light.direction * (light.range * std::max(cosAngle, 0.f));
+        radius = cosAngle > 0.f ? light.range * sinAngle : light.range;
+    }
+    else {
+        radius = light.range / (2.f * cosAngle);
+        centre = light.position + light.direction * radius;
+    }
+}
+
+LightClusters::LightClusters() {
+    for (auto& bound : bounds) {
+        bound.resize(kNumClusters);
+    }
+    clusterLights.resize(kNumClusters);
+    grid.resize(kNumClusters);
+
+    glGenBuffers(3, buffers.data());
+    glGenTextures(3, textures.data());
+    const std::array<GLenum, 3> formats = { GL_RG32UI, GL_R16UI, GL_RGBA32F };
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(vec4), nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightClusters::~LightClusters() {
+    glDeleteTextures(3, textures.data());
+    glDeleteBuffers(3, buffers.data());
+}
+
+unsigned int LightClusters::GetSlice(float depth) const {
+    if (depth <= nearPlane) {
+        return 0;
+    }
+    return std::min((unsigned int)(std::log(depth / nearPlane) * sliceScale), kGridZ - 1);
+}
+
+void LightClusters::BuildClusterBounds(const mat4& newProjection) {
+    projection = newProjection;
+    nearPlane = projection[3][2] / (projection[2][2] - 1.f);
+    farPlane = projection[3][2] / (projection[2][2] + 1.f);
+    sliceScale = kGridZ / std::log(farPlane / nearPlane);
+
+    for (unsigned int z = 0; z < kGridZ; ++z) {
+        const auto sliceNear = nearPlane * std::pow(farPlane / nearPlane, (float)z / kGridZ);
+        const auto sliceFar = nearPlane * std::pow(farPlane / nearPlane, (float)(z + 1) / kGridZ);
+        for (unsigned int y = 0; y < kGridY; ++y) {
+            for (unsigned int x = 0; x < kGridX; ++x) {
+                const auto ndcMin = vec2(x, y) / vec2(kGridX, kGridY) * 2.f - 1.f;
+                const auto ndcMax = vec2(x + 1, y + 1) / vec2(kGridX, kGridY) * 2.f - 1.f;
+                // The tile's corners at both ends of the slice
+                auto lower = vec2(INFINITY), upper = vec2(-INFINITY);
+                for (auto depth : { sliceNear, sliceFar }) {
+                    for (auto ndc : { ndcMin, ndcMax }) {
+                        const auto corner = vec2(ndc.x / projection[0][0], ndc.y / projection[1][1]) * depth;
+                        lower = min(lower, corner);
+                        upper = max(upper, corner);
+                    }
+                }
+                const auto cluster = (z * kGridY + y) * kGridX + x;
+                bounds[MinX][cluster] = lower.x;
+                bounds[MinY][cluster] = lower.y;
+                bounds[MinZ][cluster] = sliceNear;
+                bounds[MaxX][cluster] = upper.x;
+                bounds[MaxY][cluster] = upper.y;
+                bounds[MaxZ][cluster] = sliceFar;
+            }
+        }
+    }
+}
+
+#ifdef GLITTER_CLUSTER_SSE
+
+void LightClusters::AssignSlice(unsigned int slice) {
+    const auto first = slice * kClustersPerSlice;
+    for (size_t light = 0; light < spheres.size(); ++light) {
+        const auto& sphere = spheres[light];
+        if (slice < sphere.firstSlice || slice > sphere.lastSlice) {
+            continue;
+        }
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 centre[3] = { _mm_set1_ps(sphere.centre.x), _mm_set1_ps(sphere.centre.y), _mm_set1_ps(sphere.centre.z) };
+        const __m128 radiusSquared = _mm_set1_ps(sphere.radius * sphere.radius);
+
+        for (auto cluster = first; cluster < first + kClustersPerSlice; cluster += 4) {
+            // Squared distance from the centre to the nearest point of each box
+            __m128 distanceSquared = zero;
+            for (int axis = 0; axis < 3; ++axis) {
+                const __m128 lower = _mm_loadu_ps(&bounds[MinX + axis][cluster]);
+                const __m128 upper = _mm_loadu_ps(&bounds[MaxX + axis][cluster]);
+                const __m128 outside = _mm_max_ps(
+                    _mm_max_ps(_mm_sub_ps(lower, centre[axis]), _mm_sub_ps(centre[axis], upper)),
+                    zero);
+                distanceSquared = _mm_add_ps(distanceSquared, _mm_mul_ps(outside, outside));
+            }
+            const auto mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radiusSquared));
+            if (mask == 0) {
+                continue;
+            }
+            for (int lane = 0; lane < 4; ++lane) {
+                if (mask & (1 << lane)) {
+                    clusterLights[cluster + lane].push_back((uint16_t)light);
+                }
+            }
+        }
+    }
+}
+
+#else
+
+void LightClusters::AssignSlice(unsigned int slice) {
+    const auto first = slice * kClustersPerSlice;
+    for (size_t light = 0; light < spheres.size(); ++light) {
+        const auto& sphere = spheres[light];
+        if (slice < sphere.firstSlice || slice > sphere.lastSlice) {
+            continue;
+        }
+        for (auto cluster = first; cluster < first + kClustersPerSlice; ++cluster) {
+            float distanceSquared = 0.f;
+            for (int axis = 0; axis < 3; ++axis) {
+                const auto outside = std::max(
+                    std::max(bounds[MinX + axis][cluster] - sphere.centre[axis], sphere.centre[axis] - bounds[MaxX + axis][cluster]),
+                    0.f);
+                distanceSquared += outside * outside;
+            }
+            if (distanceSquared <= sphere.radius * sphere.radius) {
+                clusterLights[cluster].push_back((uint16_t)light);
+            }
+        }
+    }
+}
+
+#endif
+
+void LightClusters::Update(
+    const std::vector<ClusteredLight>& lights,
+    const mat4& view,
+    const mat4& newProjection,
+    ThreadPool* threadPool
+) {
+    const auto start = std::chrono::steady_clock::now();
+    if (newProjection != projection) {
+        BuildClusterBounds(newProjection);
+    }
+
+    // Spheres in view space, with depth flipped to be positive in front of
+    // the camera. Lights entirely outside the depth range are dropped here.
+    spheres.clear();
+    lightData.clear();
+    const auto numLights = std::min(lights.size(), kMaxLights);
+    for (size_t i = 0; i < numLights; ++i) {
+        const auto& light = lights[i];
+        auto centre = light.position;
+        auto radius = light.range;
+        if (light.cosOuter > -1.f) {
+            GetSpotSphere(light, centre, radius);
+        }
+        auto viewCentre = vec3(view * vec4(centre, 1.f));
+        viewCentre.z = -viewCentre.z;
+        if (viewCentre.z + radius < nearPlane || viewCentre.z - radius > farPlane) {
+            continue;
+        }
+
+        Sphere sphere;
+        sphere.centre = viewCentre;
+        sphere.radius = radius;
+        sphere.firstSlice = GetSlice(viewCentre.z - radius);
+        sphere.lastSlice = GetSlice(viewCentre.z + radius);
+        spheres.push_back(sphere);
+
+        // Three texels per light, as read by ClusteredLighting in the shaders
+        lightData.push_back(vec4(light.position, light.range));
+        lightData.push_back(vec4(light.colour, light.cosOuter));
+        lightData.push_back(vec4(light.direction, light.cosInner));
+    }
+
+    for (auto& list : clusterLights) {
+        list.clear();
+    }
+    auto assignRange = [this](size_t begin, size_t end) {
+        for (auto slice = begin; slice < end; ++slice) {
+            AssignSlice((unsigned int)slice);
+        }
+    };
+    if (threadPool != nullptr) {
+        threadPool->ParallelFor(kGridZ, 1, assignRange);
+    }
+    else {
+        assignRange(0, kGridZ);
+    }
+
+    // Lists are filled in light order within each slice, so compacting them
+    // in cluster order gives the same result however the slices were split up
+    indices.clear();
+    stats.maxPerCluster = 0;
+    for (unsigned int cluster = 0; cluster < kNumClusters; ++cluster) {
+        const auto& list = clusterLights[cluster];
+        grid[cluster] = uvec2((unsigned int)indices.size(), (unsigned int)list.size());
+        indices.insert(indices.end(), list.begin(), list.end());
+        stats.maxPerCluster = std::max(stats.maxPerCluster, (unsigned int)list.size());
+    }
+    stats.numVisible = (unsigned int)spheres.size();
+    stats.numIndices = (unsigned int)indices.size();
+
+    // Orphaned every frame, so the driver never waits for the previous frame's draws
+    auto upload = [this](BufferIndex index, const void* data, size_t size) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[index]);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, sizeof(vec4)), nullptr, GL_STREAM_DRAW);
+        if (size > 0) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        }
+    };
+    upload(GridBuffer, grid.data(), grid.size() * sizeof(uvec2));
+    upload(IndexBuffer, indices.data(), indices.size() * sizeof(uint16_t));
+    upload(LightBuffer, lightData.data(), lightData.size() * sizeof(vec4));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    stats.milliseconds = elapsed.count();
+}
+
+void LightClusters::Bind() const {
+    const std::array<GLint, 3> units = { kGridTextureUnit, kIndexTextureUnit, kLightTextureUnit };
+    for (size_t i = 0; i < textures.size(); ++i) {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void LightClusters::SetUniforms(Shader& shader, const uvec2& screenSize) const {
+    shader.SetUniform("clusterGrid", kGridTextureUnit);
+    shader.SetUniform("clusterLightIndices", kIndexTextureUnit);
+    shader.SetUniform("clusterLights", kLightTextureUnit);
+    shader.SetUniform("clusterDims", vec3(kGridX, kGridY, kGridZ));
+    shader.SetUniform("clusterScreenSize", vec2(screenSize));
+    shader.SetUniform("clusterDepthRange", vec2(nearPlane, farPlane));
+    shader.SetUniform("clusterSliceScale", sliceScale);
+}
@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GLITTER_OCCLUSION_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include "Mesh.hpp"
+#include "OcclusionCuller.hpp"
+#include "ThreadPool.hpp"
+
+using namespace glm;
+
+// Anything closer to the camera plane than this can't be projected safely.
+// Occluders are clipped to the near plane first, so only occludees reach it,
+// and those are kept.
+static const float kMinW = 1e-4f;
+
+static_assert(OcclusionCuller::kWidth % OcclusionCuller::kTileWidth == 0, "Tiles must cover the buffer");
+static_assert(OcclusionCuller::kHeight % OcclusionCuller::kTileHeight == 0, "Tiles must cover the buffer");
+static_assert(OcclusionCuller::kTileWidth % 4 == 0, "Tiles are filled four pixels at a time");
+
+static float ElapsedMilliseconds(std::chrono::steady_clock::time_point start) {
+    const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Coefficients of a * x + b * y + c, which is positive to the left of the edge
+// from p to q, ie. inside a counter-clockwise triangle.
+static vec3 EdgeFunction(const vec3& p, const vec3& q) {
+    return vec3(p.y - q.y, q.x - p.x, (q.y - p.y) * p.x - (q.x - p.x) * p.y);
+}
+
+// Of two triangles sharing an edge, the one where this is true also covers the
+// pixels exactly on it, so there are no gaps along the edge.
+static bool OwnsEdge(const vec3& edge) {
+    return edge.x > 0.f || (edge.x == 0.f && edge.y > 0.f);
+}
+
+void OcclusionCuller::AddOccluder(const Mesh& mesh, TransformSystem::Handle transform) {
+    Occluder occluder;
+    const auto* positions = (const vec3*)mesh.GetPositionData();
+    occluder.positions.assign(positions, positions + mesh.GetPositionDataSize() / sizeof(vec3));
+    const auto* indices = (const uint32_t*)mesh.GetIndices();
+    occluder.indices.assign(indices, indices + mesh.GetIndicesSize() / sizeof(uint32_t));
+    occluder.transform = transform;
+    occluders.push_back(std::move(occluder));
+}
+
+size_t OcclusionCuller::AddOccludee(const Mesh& mesh, TransformSystem::Handle transform) {
+    Occludee occludee;
+    occludee.lower = vec3(INFINITY);
+    occludee.upper = vec3(-INFINITY);
+    const auto* positions = (const vec3*)mesh.GetPositionData();
+    const auto numPositions = mesh.GetPositionDataSize() / sizeof(vec3);
+    for (size_t i = 0; i < numPositions; ++i) {
+        occludee.lower = min(occludee.lower, positions[i]);
+        occludee.upper = max(occludee.upper, positions[i]);
+    }
+    occludee.transform = transform;
+    occludees.push_back(occludee);
+    visible.push_back(1);
+    return occludees.size() - 1;
+}
+
+void OcclusionCuller::Cull(const TransformSystem::View& view, ThreadPool* threadPool) {
+    stats = Stats();
+
+    auto start = std::chrono::steady_clock::now();
+    Rasterize(view, threadPool);
+    BuildHiZ();
+    stats.rasterMilliseconds = ElapsedMilliseconds(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> outside(occludees.size(), 0);
+    auto testRange = [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            bool isOutside = false;
+            visible[i] = TestOccludee(occludees[i], view, isOutside) ? 1 : 0;
+            outside[i] = isOutside ? 1 : 0;
+        }
+    };
+    if (threadPool != nullptr) {
+        threadPool->ParallelFor(occludees.size(), 64, testRange);
+    }
+    else {
+        testRange(0, occludees.size());
+    }
+
+    stats.numTested = (unsigned int)occludees.size();
+    for (size_t i = 0; i < occludees.size(); ++i) {
+        if (outside[i]) {
+            ++stats.numOutside;
+        }
+        else if (!visible[i]) {
+            ++stats.numOccluded;
+        }
+    }
+    stats.testMilliseconds = ElapsedMilliseconds(start);
+}
+
+void OcclusionCuller::Rasterize(const TransformSystem::View& view, ThreadPool* threadPool) {
+    // Triangles are set up and binned in order on one thread, so every tile
+    // sees the same triangles in the same order whatever the thread count
+    triangles.clear();
+    for (auto& bin : bins) {
+        bin.clear();
+    }
+
+    std::vector<vec4> clip;
+    for (const auto& occluder : occluders) {
+        const auto& modelViewProjection = view.modelViewProjection[occluder.transform];
+        clip.resize(occluder.positions.size());
+        for (size_t i = 0; i < occluder.positions.size(); ++i) {
+            clip[i] = modelViewProjection * vec4(occluder.positions[i], 1.f);
+        }
+
+        for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+            const std::array<vec4, 3> corners = {
+                clip[occluder.indices[i]], clip[occluder.indices[i + 1]], clip[occluder.indices[i + 2]] };
+
+            // Signed distances to the near plane, z = -w, which is in front
+            // of the camera plane for any perspective projection
+            std::array<float, 3> distances;
+            int numInside = 0;
+            for (int v = 0; v < 3; ++v) {
+                distances[v] = corners[v].z + corners[v].w;
+                numInside += distances[v] >= 0.f ? 1 : 0;
+            }
+            if (numInside == 3) {
+                AddTriangle(corners[0], corners[1], corners[2]);
+                continue;
+            }
+            if (numInside == 0) {
+                continue;
+            }
+
+            // Clipping a triangle by one plane leaves a triangle or a quad,
+            // in the same winding order
+            std::array<vec4, 4> polygon;
+            int numVertices = 0;
+            for (int v = 0; v < 3; ++v) {
+                const auto next = (v + 1) % 3;
+                if (distances[v] >= 0.f) {
+                    polygon[numVertices++] = corners[v];
+                }
+                if ((distances[v] >= 0.f) != (distances[next] >= 0.f)) {
+                    const auto t = distances[v] / (distances[v] - distances[next]);
+                    polygon[numVertices++] = mix(corners[v], corners[next], t);
+                }
+            }
+            for (int v = 2; v < numVertices; ++v) {
+                AddTriangle(polygon[0], polygon[v - 1], polygon[v]);
+            }
+        }
+    }
+    stats.numOccluderTriangles = (unsigned int)triangles.size();
+
+    hiZ[0].resize(kWidth * kHeight);
+    auto rasterizeRange = [this](size_t begin, size_t end) {
+        for (auto tile = begin; tile < end; ++tile) {
+            RasterizeTile((int)tile);
+        }
+    };
+    if (threadPool != nullptr) {
+        threadPool->ParallelFor(bins.size(), 1, rasterizeRange);
+    }
+    else {
+        rasterizeRange(0, bins.size());
+    }
+}
+
+void OcclusionCuller::AddTriangle(const vec4& clip0, const vec4& clip1, const vec4& clip2) {
+    Triangle triangle;
+    const std::array<const vec4*, 3> clip = { &clip0, &clip1, &clip2 };
+    for (int v = 0; v < 3; ++v) {
+        const auto& c = *clip[v];
+        if (c.w < kMinW) {
+            return;
+        }
+        const auto ndc = vec3(c) / c.w;
+        triangle.vertices[v] = vec3(
+            (ndc.x * 0.5f + 0.5f) * kWidth,
+            (ndc.y * 0.5f + 0.5f) * kHeight,
+            ndc.z * 0.5f + 0.5f);
+    }
+
+    const auto& a = triangle.vertices[0];
+    const auto& b = triangle.vertices[1];
+    const auto& c = triangle.vertices[2];
+    const auto area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+    if (area <= 0.f) {
+        return;
+    }
+
+    const auto lower = min(min(vec2(a), vec2(b)), vec2(c));
+    const auto upper = max(max(vec2(a), vec2(b)), vec2(c));
+    triangle.lower = max(ivec2(floor(lower)), ivec2(0));
+    triangle.upper = min(ivec2(ceil(upper)), ivec2(kWidth, kHeight) - 1);
+    if (triangle.lower.x > triangle.upper.x || triangle.lower.y > triangle.upper.y) {
+        return;
+    }
+
+    const auto index = (uint32_t)triangles.size();
+    triangles.push_back(triangle);
+    for (int ty = triangle.lower.y / kTileHeight; ty <= triangle.upper.y / kTileHeight; ++ty) {
+        for (int tx = triangle.lower.x / kTileWidth; tx <= triangle.upper.x / kTileWidth; ++tx) {
+            bins[ty * kTilesX + tx].push_back(index);
+        }
+    }
+}
+
+#ifdef GLITTER_OCCLUSION_SSE
+
+void OcclusionCuller::RasterizeTile(int tile) {
+    const auto tileLower = ivec2(tile % kTilesX * kTileWidth, tile / kTilesX * kTileHeight);
+    const auto tileUpper = tileLower + ivec2(kTileWidth, kTileHeight) - 1;
+    auto& depth = hiZ[0];
+    for (int y = tileLower.y; y <= tileUpper.y; ++y) {
+        std::fill_n(&depth[y * kWidth + tileLower.x], kTileWidth, 1.f);
+    }
+
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    for (auto index : bins[tile]) {
+        const auto& triangle = triangles[index];
+        const auto& v = triangle.vertices;
+        const std::array<vec3, 3> edges = { EdgeFunction(v[1], v[2]), EdgeFunction(v[2], v[0]), EdgeFunction(v[0], v[1]) };
+
+        // Depth as a plane over the screen, from the barycentric weights
+        const auto area = edges[0].x * v[0].x + edges[0].y * v[0].y + edges[0].z;
+        const auto plane = (edges[0] * v[0].z + edges[1] * v[1].z + edges[2] * v[2].z) / area;
+
+        const auto lower = max(triangle.lower, tileLower);
+        const auto upper = min(triangle.upper, tileUpper);
+        const int firstX = lower.x & ~3;
+
+        __m128 edgeA[3], edgeB[3], edgeC[3];
+        bool owned[3];
+        for (int e = 0; e < 3; ++e) {
+            edgeA[e] = _mm_set1_ps(edges[e].x);
+            edgeB[e] = _mm_set1_ps(edges[e].y);
+            edgeC[e] = _mm_set1_ps(edges[e].z);
+            owned[e] = OwnsEdge(edges[e]);
+        }
+        const __m128 planeA = _mm_set1_ps(plane.x);
+        const __m128 planeB = _mm_set1_ps(plane.y);
+        const __m128 planeC = _mm_set1_ps(plane.z);
+
+        for (int y = lower.y; y <= upper.y; ++y) {
+            const __m128 py = _mm_set1_ps(y + 0.5f);
+            for (int x = firstX; x <= upper.x; x += 4) {
+                const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+                __m128 inside = _mm_cmpeq_ps(zero, zero);
+                for (int e = 0; e < 3; ++e) {
+                    const __m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[e], px), _mm_mul_ps(edgeB[e], py)), edgeC[e]);
+                    inside = _mm_and_ps(inside, owned[e] ? _mm_cmpge_ps(value, zero) : _mm_cmpgt_ps(value, zero));
+                }
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+                const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeA, px), _mm_mul_ps(planeB, py)), planeC);
+                float* row = &depth[y * kWidth + x];
+                const __m128 old = _mm_loadu_ps(row);
+                _mm_storeu_ps(row, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, z)), _mm_andnot_ps(inside, old)));
+            }
+        }
+    }
+}
+
+#else
+
+void OcclusionCuller::RasterizeTile(int tile) {
+    const auto tileLower = ivec2(tile % kTilesX * kTileWidth, tile / kTilesX * kTileHeight);
+    const auto tileUpper = tileLower + ivec2(kTileWidth, kTileHeight) - 1;
+    auto& depth = hiZ[0];
+    for (int y = tileLower.y; y <= tileUpper.y; ++y) {
+        std::fill_n(&depth[y * kWidth + tileLower.x], kTileWidth, 1.f);
+    }
+
+    for (auto index : bins[tile]) {
+        const auto& triangle = triangles[index];
+        const auto& v = triangle.vertices;
+        const std::array<vec3, 3> edges = { EdgeFunction(v[1], v[2]), EdgeFunction(v[2], v[0]), EdgeFunction(v[0], v[1]) };
+        const auto area = edges[0].x * v[0].x + edges[0].y * v[0].y + edges[0].z;
+        const auto plane = (edges[0] * v[0].z + edges[1] * v[1].z + edges[2] * v[2].z) / area;
+        const std::array<bool, 3> owned = { OwnsEdge(edges[0]), OwnsEdge(edges[1]), OwnsEdge(edges[2]) };
+        auto isInside = [&](int e, const vec3& p) {
+            const auto value = dot(edges[e], p);
+            return value > 0.f || (owned[e] && value == 0.f);
+        };
+
+        const auto lower = max(triangle.lower, tileLower);
+        const auto upper = min(triangle.upper, tileUpper);
+        for (int y = lower.y; y <= upper.y; ++y) {
+            for (int x = lower.x; x <= upper.x; ++x) {
+                const auto p = vec3(x + 0.5f, y + 0.5f, 1.f);
+                if (isInside(0, p) && isInside(1, p) && isInside(2, p)) {
+                    auto& stored = depth[y * kWidth + x];
+                    stored = std::min(stored, dot(plane, p));
+                }
+            }
+        }
+    }
+}
+
+#endif
+
+void OcclusionCuller::BuildHiZ() {
+    // Each texel keeps the furthest depth of the four below it
+    for (int level = 1; level < kNumLevels; ++level) {
+        const auto width = std::max(kWidth >> level, 1), height = std::max(kHeight >> level, 1);
+        const auto sourceWidth = std::max(kWidth >> (level - 1), 1), sourceHeight = std::max(kHeight >> (level - 1), 1);
+        const auto& source = hiZ[level - 1];
+        auto& target = hiZ[level];
+        target.resize(width * height);
+        for (int y = 0; y < height; ++y) {
+            const auto y0 = std::min(y * 2, sourceHeight - 1), y1 = std::min(y * 2 + 1, sourceHeight - 1);
+            for (int x = 0; x < width; ++x) {
+                const auto x0 = std::min(x * 2, sourceWidth - 1), x1 = std::min(x * 2 + 1, sourceWidth - 1);
+                target[y * width + x] = std::max(
+                    std::max(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+                    std::max(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::TestOccludee(const Occludee& occludee, const TransformSystem::View& view, bool& outside) const {
+    outside = false;
+    const auto& modelViewProjection = view.modelViewProjection[occludee.transform];
+
+    auto lower = vec3(INFINITY), upper = vec3(-INFINITY);
+    for (int corner = 0; corner < 8; ++corner) {
+        const auto position = vec3(
+            corner & 1 ? occludee.upper.x : occludee.lower.x,
+            corner & 2 ? occludee.upper.y : occludee.lower.y,
+            corner & 4 ? occludee.upper.z : occludee.lower.z);
+        const auto clip = modelViewProjection * vec4(position, 1.f);
+        if (clip.w < kMinW) {
+            // Crosses the camera plane, can't be tested
+            return true;
+        }
+        const auto ndc = vec3(clip) / clip.w;
+        lower = min(lower, ndc);
+        upper = max(upper, ndc);
+    }
+
+    if (upper.x < -1.f || lower.x > 1.f || upper.y < -1.f || lower.y > 1.f || lower.z > 1.f) {
+        outside = true;
+        return false;
+    }
+
+    // Covering pixels, then the level where they are at most 2x2 texels
+    auto pixelLower = ivec2(floor((vec2(lower) * 0.5f + 0.5f) * vec2(kWidth, kHeight)));
+    auto pixelUpper = ivec2(floor((vec2(upper) * 0.5f + 0.5f) * vec2(kWidth, kHeight)));
+    pixelLower = clamp(pixelLower, ivec2(0), ivec2(kWidth, kHeight) - 1);
+    pixelUpper = clamp(pixelUpper, ivec2(0), ivec2(kWidth, kHeight) - 1);
+
+    int level = 0;
+    while (level < kNumLevels - 1 &&
+        std::max((pixelUpper.x >> level) - (pixelLower.x >> level), (pixelUpper.y >> level) - (pixelLower.y >> level)) > 1) {
+        ++level;
+    }
+
+    const auto width = std::max(kWidth >> level, 1);
+    const auto& depth = hiZ[level];
+    float furthest = 0.f;
+    for (int y = pixelLower.y >> level; y <= pixelUpper.y >> level; ++y) {
+        for (int x = pixelLower.x >> level; x <= pixelUpper.x >> level; ++x) {
+            furthest = std::max(furthest, depth[y * width + x]);
+        }
+    }
+
+    const auto nearest = lower.z * 0.5f + 0.5f;
+    return nearest <= furthest;
+}
@@ -9,4 +9,6 @@ PlanePrimitiveMesh::PlanePrimitiveMesh(float size) {
     };
 
     indices = { 0, 1, 2, 2, 3, 0 };
+
+    CopyPositions();
 }
@@ -0,0 +1,268 @@
+#include <fstream>
+#include <sstream>
+
+#include "GpuTimer.hpp"
+#include "PostProcessStack.hpp"
+#include "Shader.hpp"
+#include "Texture2D.hpp"
+
+using namespace glm;
+
+static const int kMaxBlurTaps = 16; // must match maxTaps in separable-blur.frag
+
+static std::string ReadSnippet(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not read file \"" + path.string() + "\"");
+    }
+    std::stringstream sstr;
+    sstr << file.rdbuf();
+    return sstr.str();
+}
+
+PostProcessStack::PostProcessStack(GLuint quadVao) : quadVao(quadVao) {
+}
+
+PostProcessStack::~PostProcessStack() {
+}
+
+void PostProcessStack::AddEffect(const Effect& effect) {
+    effects.push_back(effect);
+    dirty = true;
+}
+
+bool PostProcessStack::HasEnabledEffects() const {
+    for (const auto& effect : effects) {
+        if (effect.enabled) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PostProcessStack::Build() {
+    stages.clear();
+
+    std::vector<const Effect*> group;
+    auto flushGroup = [&]() {
+        if (group.empty()) {
+            return;
+        }
+        Stage stage;
+        for (auto* effect : group) {
+            stage.label += (stage.label.empty() ? "" : " + ") + effect->name;
+        }
+        Pass pass;
+        pass.shader = GetFusedShader(group);
+        pass.effects = group;
+        stage.passes.push_back(pass);
+        stage.timer = GetTimer(stage.label);
+        stages.push_back(stage);
+        group.clear();
+    };
+
+    for (const auto& effect : effects) {
+        if (!effect.enabled) {
+            continue;
+        }
+        if (effect.kind == PerPixel) {
+            group.push_back(&effect);
+            continue;
+        }
+        flushGroup();
+
+        Stage stage;
+        stage.label = effect.name;
+        if (effect.kind == SeparableBlur) {
+            Pass horizontal;
+            horizontal.shader = GetFileShader("separable-blur.frag");
+            horizontal.halfResolution = effect.halfResolution;
+            horizontal.tapDirection = vec2(1.f, 0.f);
+            horizontal.blur = &effect;
+            stage.passes.push_back(horizontal);
+
+            Pass vertical = horizontal;
+            vertical.tapDirection = vec2(0.f, 1.f);
+            stage.passes.push_back(vertical);
+        }
+        else {
+            Pass pass;
+            pass.shader = GetFileShader(effect.file);
+            pass.effects = { &effect };
+            stage.passes.push_back(pass);
+        }
+        stage.timer = GetTimer(stage.label);
+        stages.push_back(stage);
+    }
+    flushGroup();
+
+    // The last effect writes straight to the output unless it would have to
+    // do so at half resolution
+    if (stages.empty() || stages.back().passes.back().halfResolution) {
+        Stage stage;
+        stage.label = "Present";
+        Pass pass;
+        pass.shader = GetFileShader("framebuffer-display.frag");
+        stage.passes.push_back(pass);
+        stage.timer = GetTimer(stage.label);
+        stages.push_back(stage);
+    }
+
+    dirty = false;
+}
+
+Shader* PostProcessStack::GetFusedShader(const std::vector<const Effect*>& group) {
+    std::string key = "fused";
+    for (auto* effect : group) {
+        key += ":" + effect->function;
+    }
+    auto found = shaders.find(key);
+    if (found != shaders.end()) {
+        return found->second.get();
+    }
+
+    std::ostringstream source;
+    source << "#version 330 core\n"
+           << "out vec4 FragColor;\n"
+           << "in VS_OUT {\n    vec2 TexCoords;\n} fs_in;\n"
+           << "uniform sampler2D screenTexture;\n"
+           << "uniform float time;\n\n";
+    for (auto* effect : group) {
+        source << ReadSnippet(effect->file) << "\n";
+    }
+
+    // Running the effects as separate passes, effect i would read its input
+    // at uv<i> after being asked for uv<i + 1>. Warps therefore apply last to
+    // first, and colour changes first to last at their own output position.
+    const auto n = group.size();
+    source << "void main() {\n"
+           << "    vec2 uv" << n << " = fs_in.TexCoords;\n";
+    for (size_t i = n; i-- > 0;) {
+        source << "    vec2 uv" << i << " = ";
+        if (group[i]->hasWarp) {
+            source << group[i]->function << "Warp(uv" << i + 1 << ");\n";
+        }
+        else {
+            source << "uv" << i + 1 << ";\n";
+        }
+    }
+    source << "    vec3 colour = texture(screenTexture, uv0).rgb;\n";
+    for (size_t i = 0; i < n; ++i) {
+        if (group[i]->hasColour) {
+            source << "    colour = " << group[i]->function << "Colour(colour, uv" << i + 1 << ");\n";
+        }
+    }
+    source << "    FragColor = vec4(colour, 1.0);\n"
+           << "}\n";
+
+    auto shader = std::make_unique<Shader>();
+    shader->AttachShader("framebuffer-display.vert");
+    shader->AttachShaderSource(GL_FRAGMENT_SHADER, source.str());
+    shader->Link();
+    shader->SetUniform("screenTexture", 0);
+
+    auto* result = shader.get();
+    shaders[key] = std::move(shader);
+    return result;
+}
+
+Shader* PostProcessStack::GetFileShader(const std::filesystem::path& fragmentShader) {
+    const auto key = fragmentShader.string();
+    auto found = shaders.find(key);
+    if (found != shaders.end()) {
+        return found->second.get();
+    }
+
+    auto shader = std::make_unique<Shader>();
+    shader->AttachShader("framebuffer-display.vert");
+    shader->AttachShader(fragmentShader);
+    shader->Link();
+    shader->SetUniform("screenTexture", 0);
+
+    auto* result = shader.get();
+    shaders[key] = std::move(shader);
+    return result;
+}
+
+GpuTimer* PostProcessStack::GetTimer(const std::string& label) {
+    auto& timer = timers[label];
+    if (timer == nullptr) {
+        timer = std::make_unique<GpuTimer>();
+    }
+    return timer.get();
+}
+
+void PostProcessStack::AddPasses(FrameGraph& graph, FrameGraph::Resource input, FrameGraph::Resource output, const uvec2& size, float time) {
+    if (dirty) {
+        Build();
+    }
+
+    const auto halfSize = max(size / 2u, uvec2(1));
+    auto current = input;
+    for (size_t s = 0; s < stages.size(); ++s) {
+        const auto& stage = stages[s];
+        for (size_t p = 0; p < stage.passes.size(); ++p) {
+            const auto& pass = stage.passes[p];
+            const bool last = s + 1 == stages.size() && p + 1 == stage.passes.size();
+            const auto name = stage.passes.size() > 1 ? stage.label + " " + std::to_string(p + 1) : stage.label;
+
+            const auto read = current;
+            FrameGraph::Resource write = output;
+            graph.AddPass(name,
+                [&](FrameGraph::Builder& builder) {
+                    builder.Read(read);
+                    if (!last) {
+                        FrameGraph::TextureDesc desc;
+                        desc.size = pass.halfResolution ? halfSize : size;
+                        desc.internalFormat = GL_RGB8;
+                        write = builder.Create(name, desc);
+                    }
+                    builder.Write(write);
+                },
+                [this, pass, read, size, time, timer = stage.timer, begin = p == 0, end = p + 1 == stage.passes.size()](const FrameGraph::Context& context) {
+                    if (begin) {
+                        timer->Begin();
+                    }
+                    context.BindFramebuffer();
+                    glBindVertexArray(quadVao);
+                    glActiveTexture(GL_TEXTURE0);
+                    Texture2D::BindTexture(context.GetTexture(read));
+                    Draw(pass, size, time);
+                    if (end) {
+                        timer->End();
+                    }
+                });
+            current = write;
+        }
+    }
+}
+
+void PostProcessStack::Draw(const Pass& pass, const uvec2& size, float time) const {
+    pass.shader->Activate();
+    pass.shader->SetUniform("time", time);
+    pass.shader->SetUniform("clipPos", vec4(0.f, 0.f, 1.f, 1.f));
+    for (auto* effect : pass.effects) {
+        for (const auto& parameter : effect->parameters) {
+            pass.shader->SetUniform(parameter.uniform, parameter.value);
+        }
+    }
+
+    if (pass.blur != nullptr) {
+        // Fewer taps cover the same radius when blurring at half resolution
+        const auto scale = pass.blur->halfResolution ? 2.f : 1.f;
+        const auto numTaps = clamp((int)ceil(pass.blur->blurRadius / scale), 1, kMaxBlurTaps);
+        const auto tapPixels = pass.blur->blurRadius / numTaps;
+        pass.shader->SetUniform("tapStep", pass.tapDirection * tapPixels / vec2(size));
+        pass.shader->SetUniform("numTaps", numTaps);
+        pass.shader->SetUniform("sigma", numTaps / 2.f);
+    }
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+std::vector<PostProcessStack::Timing> PostProcessStack::GetTimings() const {
+    std::vector<Timing> timings;
+    for (const auto& stage : stages) {
+        timings.push_back({ stage.label, stage.timer->GetMilliseconds() });
+    }
+    return timings;
+}
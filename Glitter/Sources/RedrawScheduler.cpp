@@ -0,0 +1,38 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+#include "Graphics.hpp"
+#include "RedrawScheduler.hpp"
+
+void RedrawScheduler::SetOnDemand(bool enabled) {
+    onDemand = enabled;
+    pendingFrames = kSettleFrames;
+}
+
+bool RedrawScheduler::ShouldDraw(Graphics& graphics, const ProcessEvents& processEvents) {
+    bool draw = !onDemand || pendingFrames > 0 || graphics.WantsRedraw();
+    if (draw) {
+        processEvents(0.);
+    }
+    else {
+        // Input ends the wait early, and sets pendingFrames through OnInput
+        const auto cpuStart = std::clock();
+        const auto wallStart = std::chrono::steady_clock::now();
+        processEvents(kIdleTimeoutSeconds);
+        idleCpuSeconds += static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        idleWallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        graphics.ResumeAfterIdle();
+
+        draw = pendingFrames > 0 || graphics.WantsRedraw();
+    }
+
+    if (draw) {
+        pendingFrames = std::max(pendingFrames - 1, 0);
+        ++numDrawnFrames;
+    }
+    else {
+        ++numIdleWakeups;
+    }
+    return draw;
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "Scene.hpp"
+#include "ThreadPool.hpp"
+
+using namespace glm;
+
+Scene::NodeHandle Scene::Add(NodeHandle parent, const mat4& local) {
+    if (parent != kNoParent && parent >= handles.size()) {
+        throw std::runtime_error("Unknown parent node " + std::to_string(parent));
+    }
+
+    const auto handle = transforms.Add(local);
+    const auto index = (uint32_t)handles.size();
+    indices.push_back(index);
+    handles.push_back(handle);
+    parents.push_back(parent == kNoParent ? kNoParent : indices[parent]);
+    locals.push_back(local);
+    worlds.push_back(local);
+    dirty.push_back(0);
+    MarkDirty(index);
+    sorted = false;
+    return handle;
+}
+
+void Scene::SetParent(NodeHandle node, NodeHandle parent) {
+    for (auto ancestor = parent; ancestor != kNoParent; ancestor = GetParent(ancestor)) {
+        if (ancestor == node) {
+            throw std::runtime_error("Node " + std::to_string(node) + " can't be parented to its own descendant");
+        }
+    }
+
+    const auto index = indices[node];
+    parents[index] = parent == kNoParent ? kNoParent : indices[parent];
+    MarkDirty(index);
+    sorted = false;
+}
+
+void Scene::SetLocal(NodeHandle node, const mat4& local) {
+    const auto index = indices[node];
+    if (local == locals[index]) {
+        return;
+    }
+    locals[index] = local;
+    MarkDirty(index);
+}
+
+Scene::NodeHandle Scene::GetParent(NodeHandle node) const {
+    const auto parent = parents[indices[node]];
+    return parent == kNoParent ? kNoParent : handles[parent];
+}
+
+Scene::DrawableHandle Scene::AddDrawable(std::shared_ptr<Drawable> drawable) {
+    drawables.push_back(drawable);
+    return (DrawableHandle)(drawables.size() - 1);
+}
+
+size_t Scene::Place(DrawableHandle drawable, NodeHandle node) {
+    renderables.push_back({ drawables[drawable].get(), node });
+    return renderables.size() - 1;
+}
+
+void Scene::MarkDirty(size_t index) {
+    if (dirty[index]) {
+        return;
+    }
+    dirty[index] = 1;
+    firstDirty = numDirty == 0 ? index : std::min(firstDirty, index);
+    ++numDirty;
+}
+
+void Scene::Sort() {
+    const auto count = handles.size();
+
+    // Children of every node as ranges of one array, in the order they are now
+    std::vector<uint32_t> firstChild(count + 1, 0), children(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (parents[i] != kNoParent) {
+            ++firstChild[parents[i] + 1];
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        firstChild[i + 1] += firstChild[i];
+    }
+    auto nextChild = firstChild;
+    for (size_t i = 0; i < count; ++i) {
+        if (parents[i] != kNoParent) {
+            children[nextChild[parents[i]]++] = (uint32_t)i;
+        }
+    }
+
+    // Breadth first from the roots, one level at a time
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (parents[i] == kNoParent) {
+            order.push_back((uint32_t)i);
+        }
+    }
+    levels.assign(1, 0);
+    for (size_t begin = 0; begin < order.size();) {
+        const auto end = order.size();
+        levels.push_back(end);
+        for (auto i = begin; i < end; ++i) {
+            const auto node = order[i];
+            order.insert(order.end(), children.begin() + firstChild[node], children.begin() + firstChild[node + 1]);
+        }
+        begin = end;
+    }
+
+    std::vector<uint32_t> newIndices(count);
+    for (size_t i = 0; i < count; ++i) {
+        newIndices[order[i]] = (uint32_t)i;
+    }
+    auto permute = [&order](auto& values) {
+        std::remove_reference_t<decltype(values)> permuted(values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            permuted[i] = values[order[i]];
+        }
+        values.swap(permuted);
+    };
+    permute(handles);
+    permute(parents);
+    permute(locals);
+    permute(worlds);
+    permute(dirty);
+    for (size_t i = 0; i < count; ++i) {
+        if (parents[i] != kNoParent) {
+            parents[i] = newIndices[parents[i]];
+        }
+        indices[handles[i]] = (uint32_t)i;
+    }
+
+    firstDirty = std::find(dirty.begin(), dirty.end(), 1) - dirty.begin();
+    sorted = true;
+}
+
+void Scene::Update(ThreadPool* threadPool) {
+    if (!sorted) {
+        Sort();
+    }
+
+    if (numDirty > 0) {
+        // Every level only reads the one before, so each can be split up
+        for (size_t level = 0; level + 1 < levels.size(); ++level) {
+            const auto begin = std::max(levels[level], firstDirty);
+            const auto end = levels[level + 1];
+            if (begin >= end) {
+                continue;
+            }
+            if (threadPool != nullptr && end - begin > kNodesPerChunk) {
+                threadPool->ParallelFor(end - begin, kNodesPerChunk, [this, begin](size_t first, size_t last) {
+                    UpdateRange(begin + first, begin + last);
+                });
+            }
+            else {
+                UpdateRange(begin, end);
+            }
+        }
+
+        for (auto i = firstDirty; i < handles.size(); ++i) {
+            if (dirty[i]) {
+                transforms.SetModel(handles[i], worlds[i]);
+                dirty[i] = 0;
+            }
+        }
+        numDirty = 0;
+    }
+
+    transforms.Update(threadPool);
+}
+
+void Scene::UpdateRange(size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i) {
+        const auto parent = parents[i];
+        if (parent == kNoParent) {
+            if (dirty[i]) {
+                worlds[i] = locals[i];
+            }
+        }
+        else if (dirty[i] || dirty[parent]) {
+            dirty[i] = 1;
+            worlds[i] = worlds[parent] * locals[i];
+        }
+    }
+}
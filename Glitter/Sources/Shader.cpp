@@ -1,8 +1,10 @@
 #include <fstream>
 #include <sstream>
 
+#include "CpuProfiler.hpp"
 #include "Mesh.hpp"
 #include "Shader.hpp"
+#include "UniformBlocks.hpp"
 
 using namespace glm;
 
@@ -34,7 +36,17 @@ void Shader::AttachShader(const std::filesystem::path& path) {
     glDeleteShader(shader);
 }
 
+void Shader::AttachShaderSource(GLenum type, const std::string& source) {
+    GLuint shader = glCreateShader(type);
+    const char* shaderSource = source.c_str();
+    glShaderSource(shader, 1, &shaderSource, NULL);
+    CompileShader(shader);
+    glAttachShader(program, shader);
+    glDeleteShader(shader);
+}
+
 void Shader::Link() {
+    PROFILE_SCOPE("Shader::Link");
     glLinkProgram(program);
     GLint status;
     glGetProgramiv(program, GL_LINK_STATUS, &status);
@@ -49,6 +61,7 @@ void Shader::Link() {
     }
 
     FindUniforms();
+    BindUniformBlocks();
 }
 
 void Shader::FindUniforms() {
@@ -65,6 +78,19 @@ void Shader::FindUniforms() {
     delete[] name;
 }
 
+void Shader::BindUniformBlocks() {
+    const std::pair<const char*, GLuint> blocks[] = {
+        { "PerDraw", PerDrawBlockBinding },
+        { "PerView", PerViewBlockBinding },
+    };
+    for (const auto& [name, binding] : blocks) {
+        auto index = glGetUniformBlockIndex(program, name);
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, index, binding);
+        }
+    }
+}
+
 void Shader::Activate() {
     if (activeProgram == program) {
         return;
@@ -115,6 +141,11 @@ void Shader::SetUniform(const std::string& name, int value) {
     if (uniformLocation != uniforms.end()) {
         glUniform1i(uniformLocation->second, value);
     }
+
+    // After our own upload, as this makes the variant the active program
+    if (indirectVariant != nullptr) {
+        indirectVariant->SetUniform(name, value);
+    }
 }
 
 void Shader::SetUniform(const std::string& name, float value) {
@@ -124,6 +155,23 @@ void Shader::SetUniform(const std::string& name, float value) {
     if (uniformLocation != uniforms.end()) {
         glUniform1f(uniformLocation->second, value);
     }
+
+    if (indirectVariant != nullptr) {
+        indirectVariant->SetUniform(name, value);
+    }
+}
+
+void Shader::SetUniform(const std::string& name, const vec2& value) {
+    Activate();
+
+    auto uniformLocation = uniforms.find(name);
+    if (uniformLocation != uniforms.end()) {
+        glUniform2fv(uniformLocation->second, 1, value_ptr(value));
+    }
+
+    if (indirectVariant != nullptr) {
+        indirectVariant->SetUniform(name, value);
+    }
 }
 
 void Shader::SetUniform(const std::string& name, const vec3& value) {
@@ -133,6 +181,10 @@ void Shader::SetUniform(const std::string& name, const vec3& value) {
     if (uniformLocation != uniforms.end()) {
         glUniform3fv(uniformLocation->second, 1, value_ptr(value));
     }
+
+    if (indirectVariant != nullptr) {
+        indirectVariant->SetUniform(name, value);
+    }
 }
 
 void Shader::SetUniform(const std::string& name, const vec4& value) {
@@ -142,6 +194,10 @@ void Shader::SetUniform(const std::string& name, const vec4& value) {
     if (uniformLocation != uniforms.end()) {
         glUniform4fv(uniformLocation->second, 1, value_ptr(value));
     }
+
+    if (indirectVariant != nullptr) {
+        indirectVariant->SetUniform(name, value);
+    }
 }
 
 void Shader::SetUniform(const std::string& name, const mat4& value) {
@@ -151,11 +207,18 @@ void Shader::SetUniform(const std::string& name, const mat4& value) {
     if (uniformLocation != uniforms.end()) {
         glUniformMatrix4fv(uniformLocation->second, 1, GL_FALSE, value_ptr(value));
     }
+
+    if (indirectVariant != nullptr) {
+        indirectVariant->SetUniform(name, value);
+    }
 }
 
 void Shader::AddTexture(const std::string& uniformName, std::shared_ptr<Texture2D> texture) {
     int textureUnit = (int)textures.size();
     textures.push_back(texture);
+    if (indirectVariant != nullptr) {
+        indirectVariant->textures.push_back(texture);
+    }
     
     SetUniform(uniformName, textureUnit);
 }
@@ -0,0 +1,41 @@
+#include "ShadowMapCache.hpp"
+
+using namespace glm;
+
+bool ShadowMapCache::NeedsUpdate(
+    const mat4& lightSpaceMatrix,
+    const TransformSystem& transforms,
+    const std::vector<Renderable>& casters
+) {
+    if (lightSpaceMatrix != this->lightSpaceMatrix) {
+        this->lightSpaceMatrix = lightSpaceMatrix;
+        dirty = true;
+    }
+
+    if (casters.size() != casterTransforms.size()) {
+        casterTransforms.resize(casters.size());
+        casterVersions.resize(casters.size());
+        dirty = true;
+    }
+    for (size_t i = 0; i < casters.size(); ++i) {
+        const auto handle = casters[i].transform;
+        const auto version = transforms.GetVersion(handle);
+        if (handle != casterTransforms[i] || version != casterVersions[i]) {
+            casterTransforms[i] = handle;
+            casterVersions[i] = version;
+            dirty = true;
+        }
+    }
+
+    ++framesSinceUpdate;
+    if (valid && (!dirty || framesSinceUpdate < updateInterval)) {
+        ++numSkipped;
+        return false;
+    }
+
+    valid = true;
+    dirty = false;
+    framesSinceUpdate = 0;
+    ++numUpdates;
+    return true;
+}
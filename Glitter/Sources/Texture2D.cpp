@@ -3,6 +3,8 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "CpuProfiler.hpp"
+#include "GlStats.hpp"
 #include "Texture2D.hpp"
 
 using namespace glm;
@@ -10,6 +12,7 @@ using namespace glm;
 GLuint Texture2D::boundTexture = 0;
 
 ImagePtr LoadTexture(const std::filesystem::path& path, bool flipVertically) {
+    PROFILE_SCOPE("LoadTexture");
     auto pathStr = path.string();
     auto* img = new Image();
     stbi_set_flip_vertically_on_load(flipVertically);
@@ -65,6 +68,7 @@ Texture2D::Texture2D(const std::array<std::filesystem::path, 6>& cubemapFaces, C
     glGenTextures(1, &texture);
     hasTexture = true;
 
+    GlStats::MemoryScope memoryScope(GlStats::Textures);
     Bind();
     for (size_t i = 0; i < cubemapFaces.size(); ++i) {
         auto img = LoadTexture(cubemapFaces[i], false);
@@ -126,6 +130,7 @@ void Texture2D::SetBorder(const vec4& color) {
 }
 
 void Texture2D::InitTexture(const uvec2& size, const void* data) {
+    GlStats::MemoryScope memoryScope(GlStats::Textures);
     glTexImage2D(
         target, 
         0, 
@@ -0,0 +1,87 @@
+#include <algorithm>
+
+#include "CpuProfiler.hpp"
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned int numWorkers) {
+    workers.reserve(numWorkers);
+    for (unsigned int i = 0; i < numWorkers; ++i) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wakeWorkers.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned int ThreadPool::DefaultNumWorkers() {
+    auto hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    if (workers.empty() || count <= chunkSize) {
+        fn(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        jobChunkSize = chunkSize;
+        nextChunk = 0;
+        busyWorkers = (unsigned int)workers.size();
+        ++generation;
+    }
+    wakeWorkers.notify_all();
+
+    RunChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this] { return busyWorkers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::WorkerLoop() {
+    CpuProfiler::SetThreadName("Worker");
+    unsigned int seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&] { return quit || generation != seenGeneration; });
+            if (quit) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        RunChunks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0) {
+            jobDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunChunks() {
+    while (true) {
+        auto begin = nextChunk.fetch_add(1) * jobChunkSize;
+        if (begin >= jobCount) {
+            return;
+        }
+        (*job)(begin, std::min(begin + jobChunkSize, jobCount));
+    }
+}
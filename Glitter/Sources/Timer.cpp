@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Timer.hpp"
+
+static const double kBinGrowth = std::pow(
+    static_cast<double>(Timer::kLastBinMilliseconds) / Timer::kFirstBinMilliseconds,
+    1. / (Timer::kNumBins - 2)
+);
+
+float Timer::GetBinStart(size_t bin) {
+    if (bin == 0) {
+        return 0.f;
+    }
+    return static_cast<float>(kFirstBinMilliseconds * std::pow(kBinGrowth, static_cast<double>(bin - 1)));
+}
+
+size_t Timer::GetBin(float milliseconds) {
+    if (milliseconds < kFirstBinMilliseconds) {
+        return 0;
+    }
+    const auto bin = 1 + static_cast<size_t>(std::log(milliseconds / kFirstBinMilliseconds) / std::log(kBinGrowth));
+    return std::min(bin, kNumBins - 1);
+}
+
+void Timer::Update() {
+    lastFrameTime = now;
+    if (fixedStep > 0.f) {
+        now += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(fixedStep));
+    }
+    else {
+        now = std::chrono::steady_clock::now();
+    }
+    if (resumed) {
+        resumed = false;
+        return;
+    }
+
+    const auto milliseconds = std::chrono::duration<float, std::milli>(now - lastFrameTime).count();
+    history[nextHistory] = milliseconds;
+    nextHistory = (nextHistory + 1) % kHistorySize;
+    numHistory = std::min(numHistory + 1, kHistorySize);
+
+    ++histogram[GetBin(milliseconds)];
+    ++numFrames;
+    totalMilliseconds += milliseconds;
+    maxMilliseconds = std::max(maxMilliseconds, milliseconds);
+    if (milliseconds > budgetMilliseconds) {
+        ++numStutters;
+    }
+}
+
+void Timer::Resume() {
+    if (fixedStep > 0.f) {
+        return;
+    }
+    lastFrameTime = now = std::chrono::steady_clock::now();
+    resumed = true;
+}
+
+Timer::Stats Timer::GetRecentStats() const {
+    Stats stats;
+    if (numHistory == 0) {
+        return stats;
+    }
+
+    std::vector<float> sorted(history.begin(), history.begin() + numHistory);
+    std::sort(sorted.begin(), sorted.end());
+    const auto percentile = [&](float p) {
+        return sorted[std::min(static_cast<size_t>(p * sorted.size()), sorted.size() - 1)];
+    };
+
+    float sum = 0.f;
+    for (auto milliseconds : sorted) {
+        sum += milliseconds;
+    }
+    stats.numFrames = static_cast<unsigned int>(numHistory);
+    stats.meanMilliseconds = sum / numHistory;
+    stats.p50Milliseconds = percentile(0.5f);
+    stats.p95Milliseconds = percentile(0.95f);
+    stats.p99Milliseconds = percentile(0.99f);
+    stats.maxMilliseconds = sorted.back();
+    return stats;
+}
+
+Timer::Stats Timer::GetRunStats() const {
+    Stats stats;
+    if (numFrames == 0) {
+        return stats;
+    }
+
+    // Assumes frames are spread evenly within their bin, the last ending at
+    // the longest frame
+    const auto percentile = [&](double p) {
+        const auto rank = p * numFrames;
+        uint64_t below = 0;
+        for (size_t bin = 0; bin < kNumBins; ++bin) {
+            if (below + histogram[bin] >= rank && histogram[bin] > 0) {
+                const auto start = GetBinStart(bin);
+                const auto end = bin + 1 < kNumBins ? std::min(GetBinStart(bin + 1), maxMilliseconds) : maxMilliseconds;
+                const auto fraction = (rank - below) / histogram[bin];
+                return static_cast<float>(start + fraction * (end - start));
+            }
+            below += histogram[bin];
+        }
+        return maxMilliseconds;
+    };
+
+    stats.numFrames = static_cast<unsigned int>(numFrames);
+    stats.meanMilliseconds = static_cast<float>(totalMilliseconds / numFrames);
+    stats.p50Milliseconds = percentile(0.5);
+    stats.p95Milliseconds = percentile(0.95);
+    stats.p99Milliseconds = percentile(0.99);
+    stats.maxMilliseconds = maxMilliseconds;
+    return stats;
+}
+
+void Timer::PrintSummary(FILE* file) const {
+    const auto stats = GetRunStats();
+    if (stats.numFrames == 0) {
+        return;
+    }
+    fprintf(
+        file,
+        "Frame times over %u frames: mean %.2f ms, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n"
+        "%u stutters over %.2f ms (%.2f%%)\n",
+        stats.numFrames,
+        stats.meanMilliseconds,
+        stats.p50Milliseconds,
+        stats.p95Milliseconds,
+        stats.p99Milliseconds,
+        stats.maxMilliseconds,
+        numStutters,
+        budgetMilliseconds,
+        100.f * numStutters / stats.numFrames
+    );
+}
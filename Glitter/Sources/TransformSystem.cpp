@@ -0,0 +1,187 @@
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GLITTER_TRANSFORM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include "ThreadPool.hpp"
+#include "TransformSystem.hpp"
+
+using namespace glm;
+
+#ifdef GLITTER_TRANSFORM_SSE
+
+// mvp = viewProjection * model for four models starting at lane.
+static void MultiplyBlock(const mat4& viewProjection, const std::array<std::vector<float>, 16>& soa, size_t lane, mat4* out) {
+    for (int c = 0; c < 4; ++c) {
+        __m128 m0 = _mm_loadu_ps(&soa[c * 4 + 0][lane]);
+        __m128 m1 = _mm_loadu_ps(&soa[c * 4 + 1][lane]);
+        __m128 m2 = _mm_loadu_ps(&soa[c * 4 + 2][lane]);
+        __m128 m3 = _mm_loadu_ps(&soa[c * 4 + 3][lane]);
+
+        __m128 rows[4];
+        for (int r = 0; r < 4; ++r) {
+            rows[r] = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(viewProjection[0][r]), m0),
+                    _mm_mul_ps(_mm_set1_ps(viewProjection[1][r]), m1)),
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(viewProjection[2][r]), m2),
+                    _mm_mul_ps(_mm_set1_ps(viewProjection[3][r]), m3)));
+        }
+
+        // Each register holds one row for four objects, transposing gives one
+        // column per object which can be stored straight into the output.
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+        for (int j = 0; j < 4; ++j) {
+            _mm_storeu_ps(value_ptr(out[j][c]), rows[j]);
+        }
+    }
+}
+
+// transpose(inverse(mat3(model))) for four models starting at lane, using the
+// cross products of the columns rather than a general inverse.
+static void InverseTransposeBlock(const std::array<std::vector<float>, 16>& soa, size_t lane, mat3* out) {
+    __m128 a[3], b[3], c[3];
+    for (int r = 0; r < 3; ++r) {
+        a[r] = _mm_loadu_ps(&soa[0 * 4 + r][lane]);
+        b[r] = _mm_loadu_ps(&soa[1 * 4 + r][lane]);
+        c[r] = _mm_loadu_ps(&soa[2 * 4 + r][lane]);
+    }
+
+    auto cross = [](const __m128* u, const __m128* v, __m128* result) {
+        result[0] = _mm_sub_ps(_mm_mul_ps(u[1], v[2]), _mm_mul_ps(u[2], v[1]));
+        result[1] = _mm_sub_ps(_mm_mul_ps(u[2], v[0]), _mm_mul_ps(u[0], v[2]));
+        result[2] = _mm_sub_ps(_mm_mul_ps(u[0], v[1]), _mm_mul_ps(u[1], v[0]));
+    };
+
+    __m128 columns[3][3];
+    cross(b, c, columns[0]);
+    cross(c, a, columns[1]);
+    cross(a, b, columns[2]);
+
+    __m128 det = _mm_add_ps(
+        _mm_mul_ps(a[0], columns[0][0]),
+        _mm_add_ps(_mm_mul_ps(a[1], columns[0][1]), _mm_mul_ps(a[2], columns[0][2])));
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+
+    alignas(16) float lanes[3][3][4];
+    for (int col = 0; col < 3; ++col) {
+        for (int r = 0; r < 3; ++r) {
+            _mm_store_ps(lanes[col][r], _mm_mul_ps(columns[col][r], invDet));
+        }
+    }
+    for (int j = 0; j < 4; ++j) {
+        for (int col = 0; col < 3; ++col) {
+            out[j][col] = vec3(lanes[col][0][j], lanes[col][1][j], lanes[col][2][j]);
+        }
+    }
+}
+
+#else
+
+static void MultiplyBlock(const mat4& viewProjection, const std::array<std::vector<float>, 16>& soa, size_t lane, mat4* out) {
+    for (size_t j = 0; j < 4; ++j) {
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                out[j][c][r] =
+                    viewProjection[0][r] * soa[c * 4 + 0][lane + j] +
+                    viewProjection[1][r] * soa[c * 4 + 1][lane + j] +
+                    viewProjection[2][r] * soa[c * 4 + 2][lane + j] +
+                    viewProjection[3][r] * soa[c * 4 + 3][lane + j];
+            }
+        }
+    }
+}
+
+static void InverseTransposeBlock(const std::array<std::vector<float>, 16>& soa, size_t lane, mat3* out) {
+    for (size_t j = 0; j < 4; ++j) {
+        auto a = vec3(soa[0][lane + j], soa[1][lane + j], soa[2][lane + j]);
+        auto b = vec3(soa[4][lane + j], soa[5][lane + j], soa[6][lane + j]);
+        auto c = vec3(soa[8][lane + j], soa[9][lane + j], soa[10][lane + j]);
+        auto bc = cross(b, c);
+        auto invDet = 1.f / dot(a, bc);
+        out[j] = mat3(bc * invDet, cross(c, a) * invDet, cross(a, b) * invDet);
+    }
+}
+
+#endif
+
+TransformSystem::Handle TransformSystem::Add(const mat4& model) {
+    if (count % kLanes == 0) {
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                soa[c * 4 + r].resize(count + kLanes, c == r ? 1.f : 0.f);
+            }
+        }
+        models.resize(count + kLanes, mat4(1.f));
+        modelInverseTransposes.resize(count + kLanes, mat3(1.f));
+        dirtyBlocks.push_back(0);
+        versions.resize(count + kLanes, 0);
+    }
+
+    auto handle = (Handle)count++;
+    SetModel(handle, model);
+    return handle;
+}
+
+void TransformSystem::SetModel(Handle handle, const mat4& model) {
+    if (model == models[handle]) {
+        return;
+    }
+
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) {
+            soa[c * 4 + r][handle] = model[c][r];
+        }
+    }
+    models[handle] = model;
+    dirtyBlocks[handle / kLanes] = 1;
+    ++versions[handle];
+}
+
+void TransformSystem::Update(ThreadPool* threadPool) {
+    auto updateRange = [this](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+            if (dirtyBlocks[block]) {
+                UpdateBlock(block);
+            }
+        }
+    };
+
+    if (threadPool != nullptr) {
+        threadPool->ParallelFor(GetNumBlocks(), kBlocksPerChunk, updateRange);
+    }
+    else {
+        updateRange(0, GetNumBlocks());
+    }
+}
+
+void TransformSystem::UpdateBlock(size_t block) {
+    auto lane = block * kLanes;
+    InverseTransposeBlock(soa, lane, &modelInverseTransposes[lane]);
+    dirtyBlocks[block] = 0;
+}
+
+void TransformSystem::ComputeView(View& out, const mat4& view, const mat4& projection, ThreadPool* threadPool) const {
+    out.view = view;
+    out.projection = projection;
+    out.viewProjection = projection * view;
+    out.worldSpaceCameraPos = vec3(inverse(view)[3]);
+    out.modelViewProjection.resize(GetNumBlocks() * kLanes);
+
+    auto computeRange = [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+            auto lane = block * kLanes;
+            MultiplyBlock(out.viewProjection, soa, lane, &out.modelViewProjection[lane]);
+        }
+    };
+
+    if (threadPool != nullptr) {
+        threadPool->ParallelFor(GetNumBlocks(), kBlocksPerChunk, computeRange);
+    }
+    else {
+        computeRange(0, GetNumBlocks());
+    }
+}
@@ -6,4 +6,11 @@ const VertexAttribInfoList VectorMesh::VertexAttribs = {
     {"tangent", 3, GL_FLOAT},
     {"bitangent", 3, GL_FLOAT},
     {"texcoord", 2, GL_FLOAT},
-};
\ No newline at end of file
+};
+
+void VectorMesh::CopyPositions() {
+    positions.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        positions[i] = { vertices[i][0], vertices[i][1], vertices[i][2] };
+    }
+}
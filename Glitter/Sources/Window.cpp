@@ -1,17 +1,33 @@
+#include <algorithm>
 #include <cstdio>
 #include <glad/glad.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include "CpuProfiler.hpp"
+#include "GlStats.hpp"
+#include "GlTrace.hpp"
+#include "GpuProfiler.hpp"
 #include "Window.hpp"
 
 GLFWwindow* Window::window;
 
 std::shared_ptr<Graphics> Window::graphics = nullptr;
 
-Window::Window(std::shared_ptr<Graphics> graphics, int width, int height, const char* title) {
+FramePacer Window::pacer;
+Window::SwapMode Window::swapMode = Window::VsyncOn;
+bool Window::adaptiveSupported = false;
+
+bool Window::threaded = true;
+TripleBuffer<Window::Snapshot> Window::snapshots;
+std::thread Window::renderThread;
+
+RedrawScheduler Window::redraw;
+
+Window::Window(std::shared_ptr<Graphics> graphics, int width, int height, const char* title, bool threaded) {
     Window::graphics = graphics;
+    Window::threaded = threaded;
 
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -23,6 +39,11 @@ Window::Window(std::shared_ptr<Graphics> graphics, int width, int height, const
     glfwSetFramebufferSizeCallback(window, Window::OnResize);
     glfwSetCursorPosCallback(window, Window::OnCursorMoved);
     glfwSetMouseButtonCallback(window, Window::OnMouseButton);
+    // Only to wake up redrawing on demand, ImGui's callbacks chain to these
+    glfwSetKeyCallback(window, [](GLFWwindow*, int, int, int, int) { OnInput(); });
+    glfwSetCharCallback(window, [](GLFWwindow*, unsigned int) { OnInput(); });
+    glfwSetScrollCallback(window, [](GLFWwindow*, double, double) { OnInput(); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { OnInput(); });
 
     // TODO
     // Check for Valid Context
@@ -33,7 +54,15 @@ Window::Window(std::shared_ptr<Graphics> graphics, int width, int height, const
 
     glfwMakeContextCurrent(window);
     gladLoadGL();
+    GlStats::Install();
     fprintf(stderr, "OpenGL %s\n", glGetString(GL_VERSION));
+    GlTrace::Install(glm::uvec2(GetFramebufferSize()));
+
+    adaptiveSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+    if (const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor())) {
+        pacer.SetRefreshRate(static_cast<float>(mode->refreshRate));
+    }
+    ApplySwapMode(swapMode);
 
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
@@ -48,16 +77,45 @@ Window::Window(std::shared_ptr<Graphics> graphics, int width, int height, const
     // Setup Platform/Renderer backends
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 150 core"); // TODO: should probably check the available version?
+    // Creates the backend's GL objects now, while the context is current here
+    ImGui_ImplOpenGL3_NewFrame();
 }
 
 void Window::LoopUntilDone() {
-    while (!glfwWindowShouldClose(window)) {
-        Draw();
+    if (threaded) {
+        // The render thread has the context for as long as the loop runs
+        glfwMakeContextCurrent(nullptr);
+        renderThread = std::thread(RenderLoop, swapMode);
+        while (!glfwWindowShouldClose(window)) {
+            Update();
+        }
+        snapshots.Close();
+        renderThread.join();
+        glfwMakeContextCurrent(window);
+    }
+    else {
+        while (!glfwWindowShouldClose(window)) {
+            Draw();
+        }
+    }
+
+    if (redraw.GetIdleSeconds() > 0.) {
+        fprintf(
+            stderr,
+            "Drew %llu frames, %llu idle wakeups, %.1f%% CPU while idle\n",
+            redraw.GetNumDrawnFrames(),
+            redraw.GetNumIdleWakeups(),
+            100. * redraw.GetIdleCpuFraction()
+        );
     }
 
     glfwTerminate();
 }
 
+void Window::SetRedrawOnDemand(bool enabled) {
+    redraw.SetOnDemand(enabled);
+}
+
 glm::ivec2 Window::GetFramebufferSize() const {
     glm::ivec2 size;
     glfwGetFramebufferSize(window, &size.x, &size.y);
@@ -71,25 +129,58 @@ glm::dvec2 Window::GetCursorPosition() const {
 }
 
 void Window::OnResize(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
+    OnInput();
     graphics->OnResize(glm::uvec2(width, height));
-    Draw();
+    if (!threaded) {
+        glViewport(0, 0, width, height);
+        RenderFrame();
+    }
 }
 
 void Window::OnCursorMoved(GLFWwindow* window, double xpos, double ypos) {
+    OnInput();
     graphics->OnCursorMoved(glm::dvec2(xpos, ypos));
 }
 
 void Window::OnMouseButton(GLFWwindow* window, int button, int action, int mods) {
+    OnInput();
     graphics->OnMouseButton(button, action);
 }
 
+void Window::OnInput() {
+    redraw.OnInput();
+}
+
+void Window::ApplySwapMode(SwapMode mode) {
+    glfwSwapInterval(mode == VsyncOff ? 0 : mode == VsyncOn ? 1 : -1);
+}
+
+bool Window::PollEvents() {
+    return redraw.ShouldDraw(*graphics, [](double timeout) {
+        if (timeout > 0.) {
+            glfwWaitEventsTimeout(timeout);
+        }
+        else {
+            glfwPollEvents();
+        }
+    });
+}
+
 void Window::Draw() {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    glfwPollEvents();
+    pacer.WaitForFrameStart();
+    if (!PollEvents()) {
+        return;
+    }
+    const auto inputTime = pacer.OnInputSampled();
 
+    RenderFrame();
+    pacer.OnPresented(inputTime);
+}
+
+void Window::RenderFrame() {
     // Render GUI
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -98,11 +189,119 @@ void Window::Draw() {
     graphics->Draw();
 
     // Add UI stuff here
+    DrawPacingGUI();
 
     ImGui::Render();
 
+    auto& profiler = graphics->GetGpuProfiler();
+    profiler.Begin("ImGui");
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    profiler.End();
 
     // Flip Buffers and Draw
     glfwSwapBuffers(window);
 }
+
+void Window::Update() {
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    pacer.WaitForFrameStart();
+    if (!PollEvents()) {
+        return;
+    }
+    auto& snapshot = snapshots.GetWrite();
+    snapshot.inputTime = pacer.OnInputSampled();
+
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+
+    graphics->Update(snapshot.frame);
+    DrawPacingGUI();
+
+    ImGui::Render();
+    snapshot.gui.CopyFrom(ImGui::GetDrawData());
+    snapshot.swapMode = swapMode;
+
+    snapshots.Publish();
+    // Stay at most one frame ahead of the render thread
+    snapshots.WaitUntilAcquired();
+}
+
+void Window::RenderLoop(SwapMode appliedSwapMode) {
+    CpuProfiler::SetThreadName("Render");
+    glfwMakeContextCurrent(window);
+
+    while (snapshots.WaitForPublish()) {
+        snapshots.Acquire();
+        auto& snapshot = snapshots.GetRead();
+        if (snapshot.swapMode != appliedSwapMode) {
+            ApplySwapMode(snapshot.swapMode);
+            appliedSwapMode = snapshot.swapMode;
+        }
+
+        graphics->Render(snapshot.frame);
+
+        ImGui_ImplOpenGL3_NewFrame();
+        if (auto* drawData = snapshot.gui.Get()) {
+            auto& profiler = graphics->GetGpuProfiler();
+            profiler.Begin("ImGui");
+            ImGui_ImplOpenGL3_RenderDrawData(drawData);
+            profiler.End();
+        }
+
+        {
+            PROFILE_SCOPE("SwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        pacer.OnPresented(snapshot.inputTime);
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+void Window::DrawPacingGUI() {
+    ImGui::Begin("Frame pacing", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    static const char* swapModes[] = { "Vsync off", "Vsync on", "Adaptive vsync" };
+    int mode = swapMode;
+    if (ImGui::Combo("Swap", &mode, swapModes, adaptiveSupported ? 3 : 2)) {
+        swapMode = static_cast<SwapMode>(mode);
+        if (!threaded) {
+            ApplySwapMode(swapMode);
+        }
+    }
+
+    float cap = pacer.GetFrameCap();
+    if (ImGui::SliderFloat("Frame cap", &cap, 0.f, 240.f, cap > 0.f ? "%.0f fps" : "Off")) {
+        pacer.SetFrameCap(cap < 1.f ? 0.f : cap);
+    }
+
+    bool lowLatency = pacer.IsLowLatency();
+    if (ImGui::Checkbox("Low latency", &lowLatency)) {
+        pacer.SetLowLatency(lowLatency);
+    }
+
+    bool onDemand = redraw.IsOnDemand();
+    if (ImGui::Checkbox("Redraw on demand", &onDemand)) {
+        redraw.SetOnDemand(onDemand);
+    }
+    if (onDemand) {
+        ImGui::Text(
+            "%llu frames drawn, %llu idle wakeups\n%.1f%% CPU while idle",
+            redraw.GetNumDrawnFrames(),
+            redraw.GetNumIdleWakeups(),
+            100. * redraw.GetIdleCpuFraction()
+        );
+    }
+
+    const auto stats = pacer.GetStats();
+    ImGui::Text("Interval %.2f ms, jitter %.2f ms", stats.intervalMilliseconds, stats.jitterMilliseconds);
+    ImGui::Text("Input to present %.2f ms (max %.2f ms)", stats.latencyMilliseconds, stats.maxLatencyMilliseconds);
+    ImGui::Text("Missed %u of the last %u", stats.numMissed, stats.numSamples);
+
+    const auto history = pacer.GetIntervalHistory();
+    ImGui::PlotLines("##intervals", history.data(), static_cast<int>(history.size()), 0, nullptr, 0.f, 2.f * stats.intervalMilliseconds + 1.f, ImVec2(0.f, 60.f));
+
+    ImGui::End();
+}
@@ -1,19 +1,180 @@
 // System Headers
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <glm/glm.hpp>
+#include <iostream>
 #include <memory>
+#include <stdexcept>
+#include <utility>
 
+#include "Benchmark.hpp"
+#include "CpuProfiler.hpp"
+#include "GlTrace.hpp"
 #include "Graphics.hpp"
+#include "HeadlessRenderer.hpp"
 #include "Window.hpp"
 
+// Usage: Glitter [--single-threaded] [--on-demand] [--headless] [--frames N] [--size WIDTHxHEIGHT] [--output DIR] [--hardware] [--trace FILE]
+//                [--benchmark CSV] [--warmup N] [--camera-path FILE] [--gl-trace FILE] [--gl-trace-frames N]
+//                [--idle-check SECONDS]
+//
+// --single-threaded updates and renders on the main thread in turn.
+// --on-demand only draws when something changes and sleeps otherwise.
+// --idle-check runs headless on demand for SECONDS and fails if the process
+// used more than kMaxIdleCpu of a core while nothing changed.
+// --headless renders N frames offscreen without a display, on Mesa's
+// llvmpipe unless --hardware is given, and writes them to DIR if given.
+// --benchmark renders headless with a fixed time step, the camera following
+// FILE's path or a default orbit, and writes per-frame timings to CSV. It
+// draws 300 frames after 30 warm-up frames unless told otherwise.
+// --trace records CPU profiler scopes from start to exit into a Chrome trace.
+// --gl-trace records every GL call from startup to the end of frame N, 3 by
+// default and at least 2, for GlReplay to play back.
+//
+// Headless runs exit with kExitNoContext when there is no headless context to
+// be had, which ctest counts as skipped rather than failed.
+static const double kMaxIdleCpu = 0.02;
+static const int kExitNoContext = 77;
+
 int main(int argc, char * argv[]) {
     auto graphics = std::make_shared<Graphics>();
 
-    const auto width = 1280;
-    const auto height = 800;
+    auto width = 1280;
+    auto height = 800;
+
+    bool threaded = true;
+    bool onDemand = false;
+    bool headless = false;
+    bool softwareRendering = true;
+    int numFrames = -1;
+    int numWarmupFrames = 30;
+    std::filesystem::path outputDirectory;
+    std::filesystem::path benchmarkPath, cameraPath;
+    std::filesystem::path tracePath;
+    std::filesystem::path glTracePath;
+    int numGlTraceFrames = 3;
+    double idleCheckSeconds = 0.;
+    int exitCode = EXIT_SUCCESS;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--single-threaded") == 0) {
+            threaded = false;
+        }
+        else if (strcmp(argv[i], "--on-demand") == 0) {
+            onDemand = true;
+        }
+        else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        }
+        else if (strcmp(argv[i], "--hardware") == 0) {
+            softwareRendering = false;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            numFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                std::cerr << "Bad size " << argv[i] << ", expected eg. 1280x800" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            benchmarkPath = argv[++i];
+            headless = true;
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            numWarmupFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc) {
+            cameraPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--gl-trace") == 0 && i + 1 < argc) {
+            glTracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--gl-trace-frames") == 0 && i + 1 < argc) {
+            numGlTraceFrames = std::max(atoi(argv[++i]), 2);
+        }
+        else if (strcmp(argv[i], "--idle-check") == 0 && i + 1 < argc) {
+            idleCheckSeconds = atof(argv[++i]);
+            headless = true;
+        }
+        else {
+            std::cerr << "Unknown argument " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    CpuProfiler::SetThreadName("Main");
+    if (!tracePath.empty()) {
+        CpuProfiler::Start();
+    }
+    if (!glTracePath.empty()) {
+        try {
+            GlTrace::Open(glTracePath, numGlTraceFrames);
+        }
+        catch (std::runtime_error& ex) {
+            std::cerr << ex.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (headless) {
+        bool haveContext = false;
+        try {
+            HeadlessRenderer renderer(graphics, width, height, softwareRendering);
+            haveContext = true;
+            // Destroyed before the renderer, so the renderer holds the last
+            // reference and Graphics goes before the context on every path
+            const auto headlessGraphics = std::move(graphics);
+            headlessGraphics->Init(renderer.GetFramebufferSize(), renderer.GetCursorPosition());
+            if (idleCheckSeconds > 0.) {
+                const auto stats = renderer.RunOnDemand(idleCheckSeconds);
+                const auto cpu = stats.cpuSeconds / stats.wallSeconds;
+                printf("Idle for %.1f s: %u frames drawn, %.2f%% CPU\n", stats.wallSeconds, stats.numFrames, 100. * cpu);
+                if (cpu > kMaxIdleCpu) {
+                    std::cerr << "Used more than " << 100. * kMaxIdleCpu << "% CPU while idle" << std::endl;
+                    exitCode = EXIT_FAILURE;
+                }
+            }
+            else if (!benchmarkPath.empty()) {
+                Benchmark benchmark(headlessGraphics, cameraPath.empty() ? Benchmark::DefaultCameraPath() : Benchmark::LoadCameraPath(cameraPath));
+                benchmark.Run(numWarmupFrames, numFrames < 0 ? 300 : numFrames, 1.f / 60.f, benchmarkPath);
+            }
+            else {
+                renderer.RenderFrames(numFrames < 0 ? 60 : numFrames, outputDirectory);
+            }
+        }
+        catch (std::runtime_error& ex) {
+            std::cerr << ex.what() << std::endl;
+            return haveContext ? EXIT_FAILURE : kExitNoContext;
+        }
+    }
+    else {
+        Window window(graphics, width, height, "OpenGL", threaded);
+        window.SetRedrawOnDemand(onDemand);
+        graphics->Init(window.GetFramebufferSize(), window.GetCursorPosition());
+        window.LoopUntilDone();
+    }
+    GlTrace::Close();
 
-    Window window(graphics, width, height, "OpenGL");
-    graphics->Init(window.GetFramebufferSize(), window.GetCursorPosition());
-    window.LoopUntilDone();
+    if (!tracePath.empty()) {
+        CpuProfiler::Stop();
+        try {
+            CpuProfiler::WriteChromeTrace(tracePath);
+        }
+        catch (std::runtime_error& ex) {
+            std::cerr << ex.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    return EXIT_SUCCESS;
+    return exitCode;
 }
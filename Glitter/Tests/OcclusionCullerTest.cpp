@@ -0,0 +1,95 @@
+// Checks OcclusionCuller against scenes where the answer is known, without a
+// GL context. Exits with a failure if any check fails.
+
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+
+#include "CubePrimitiveMesh.hpp"
+#include "OcclusionCuller.hpp"
+#include "PlanePrimitiveMesh.hpp"
+#include "TransformSystem.hpp"
+
+using namespace glm;
+
+static int numFailures = 0;
+
+static void Check(bool condition, const char* what) {
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        ++numFailures;
+    }
+}
+
+static mat4 Projection() {
+    return perspective(radians(60.f), 2.f, 0.1f, 100.f);
+}
+
+// A quad facing the camera hides a box straight behind it but not one beside
+// it, and a third box is outside the view.
+static void TestQuadHidesBox() {
+    TransformSystem transforms;
+    const auto quad = transforms.Add(rotate(translate(mat4(1.f), vec3(0.f, 0.f, -5.f)), radians(90.f), vec3(1.f, 0.f, 0.f)));
+    const auto behind = transforms.Add(translate(mat4(1.f), vec3(0.f, 0.f, -10.f)));
+    const auto beside = transforms.Add(translate(mat4(1.f), vec3(6.f, 0.f, -10.f)));
+    const auto outside = transforms.Add(translate(mat4(1.f), vec3(100.f, 0.f, -10.f)));
+
+    OcclusionCuller culler;
+    culler.AddOccluder(PlanePrimitiveMesh(4.f), quad);
+    const CubePrimitiveMesh box(1.f);
+    const auto behindIndex = culler.AddOccludee(box, behind);
+    const auto besideIndex = culler.AddOccludee(box, beside);
+    const auto outsideIndex = culler.AddOccludee(box, outside);
+
+    TransformSystem::View view;
+    transforms.ComputeView(view, mat4(1.f), Projection());
+    culler.Cull(view);
+
+    const auto& stats = culler.GetStats();
+    Check(stats.numOccluderTriangles == 2, "quad: both occluder triangles rasterised");
+    Check(!culler.IsVisible(behindIndex), "quad: box behind the quad is hidden");
+    Check(culler.IsVisible(besideIndex), "quad: box beside the quad is visible");
+    Check(!culler.IsVisible(outsideIndex), "quad: box outside the view is hidden");
+    Check(stats.numTested == 3, "quad: every occludee tested");
+    Check(stats.numOccluded == 1, "quad: one occludee occluded");
+    Check(stats.numOutside == 1, "quad: one occludee outside the view");
+}
+
+// A floor reaching behind the camera still hides what is under it, which
+// needs its triangles clipped at the near plane rather than dropped.
+static void TestFloorThroughCamera() {
+    TransformSystem transforms;
+    const auto floor = transforms.Add();
+    const auto below = transforms.Add(translate(mat4(1.f), vec3(0.f, -3.f, -10.f)));
+    const auto above = transforms.Add(translate(mat4(1.f), vec3(0.f, 2.f, -10.f)));
+
+    OcclusionCuller culler;
+    culler.AddOccluder(PlanePrimitiveMesh(100.f), floor);
+    const CubePrimitiveMesh box(1.f);
+    const auto belowIndex = culler.AddOccludee(box, below);
+    const auto aboveIndex = culler.AddOccludee(box, above);
+
+    TransformSystem::View view;
+    transforms.ComputeView(view, lookAt(vec3(0.f, 1.f, 0.f), vec3(0.f, 1.f, -1.f), vec3(0.f, 1.f, 0.f)), Projection());
+    culler.Cull(view);
+
+    const auto& stats = culler.GetStats();
+    Check(stats.numOccluderTriangles > 0, "floor: clipped triangles rasterised");
+    Check(!culler.IsVisible(belowIndex), "floor: box under the floor is hidden");
+    Check(culler.IsVisible(aboveIndex), "floor: box above the floor is visible");
+    Check(stats.numOccluded == 1, "floor: one occludee occluded");
+    Check(stats.numOutside == 0, "floor: nothing outside the view");
+}
+
+int main() {
+    TestQuadHidesBox();
+    TestFloorThroughCamera();
+    if (numFailures > 0) {
+        fprintf(stderr, "%d checks failed\n", numFailures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed\n");
+    return EXIT_SUCCESS;
+}